@@ -2,6 +2,7 @@
 #define HOSTMAN_CLI_H
 
 #include <stdbool.h>
+#include <time.h>
 
 typedef enum
 {
@@ -15,6 +16,12 @@ typedef enum
     CMD_CONFIG,
     CMD_DELETE_UPLOAD,
     CMD_DELETE_FILE,
+    CMD_WATCH,
+    CMD_QUEUE,
+    CMD_HISTORY,
+    CMD_SEARCH,
+    CMD_STATS,
+    CMD_TUI,
     CMD_HELP
 } command_type_t;
 
@@ -23,13 +30,27 @@ typedef struct
     command_type_t type;
     char *host_name;
     char *file_path;
+    char **file_paths;
+    int file_count;
     int page;
     int limit;
     bool config_get;
     char *config_key;
     char *config_value;
     char *command_name;
+    char *format;
     int upload_id;
+    int race_count;
+    int parallel;
+    int *upload_ids;
+    int upload_id_count;
+    time_t since;
+    time_t before;
+    bool assume_yes;
+    int debounce_ms;
+    int days;
+    bool rebuild;
+    bool vacuum;
 } command_args_t;
 
 command_args_t
@@ -0,0 +1,14 @@
+#ifndef HOSTMAN_TUI_H
+#define HOSTMAN_TUI_H
+
+#include <stdbool.h>
+
+/* Rows kept loaded above and below the screen, in screens. */
+#define TUI_PREFETCH_SCREENS 2
+#define TUI_SEARCH_LIMIT 1000
+#define TUI_SEARCH_DEBOUNCE_MS 150
+
+bool
+tui_run(const char *host_name);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HOSTMAN_ARENA_H
+#define HOSTMAN_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_CHUNK_SIZE 4096
+
+typedef struct arena_chunk arena_chunk_t;
+
+/*
+ * Bump allocator for data that is released all at once: a loaded config, the rows one command
+ * works on, the strings of one upload response. Nothing is freed individually. A zeroed arena is
+ * ready to use and only allocates its first chunk when something is stored in it.
+ */
+typedef struct
+{
+    arena_chunk_t *chunks;
+    size_t chunk_size;
+} arena_t;
+
+void
+arena_init(arena_t *arena, size_t chunk_size);
+void *
+arena_alloc(arena_t *arena, size_t size);
+void *
+arena_calloc(arena_t *arena, size_t count, size_t size);
+char *
+arena_strdup(arena_t *arena, const char *text);
+char *
+arena_sprintf(arena_t *arena, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void
+arena_destroy(arena_t *arena);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOSTMAN_CLIPBOARD_H
+#define HOSTMAN_CLIPBOARD_H
+
+#include <stdbool.h>
+
+/* Name of the file in the cache dir that remembers which clipboard tool was found. */
+#define CLIPBOARD_CACHE_FILE "clipboard"
+
+/*
+ * The clipboard tool is found by scanning PATH once; the result is cached across runs and
+ * rescanned when PATH changes or the cached tool disappears.
+ */
+const char *
+get_clipboard_manager_name(void);
+
+/*
+ * Hand text to the clipboard tool and return whether it took it, without waiting for the tool
+ * to exit. The text is fed to the tool directly, without a shell, so any characters are safe.
+ */
+bool
+copy_to_clipboard(const char *text);
+
+#endif
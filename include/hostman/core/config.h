@@ -1,8 +1,29 @@
 #ifndef HOSTMAN_CONFIG_H
 #define HOSTMAN_CONFIG_H
 
+#include "hostman/core/arena.h"
+#include "hostman/core/logging.h"
 #include <stdbool.h>
 
+/* Zero in any field means "use the global default". */
+typedef struct
+{
+    long connect_seconds;
+    long tls_seconds;
+    long total_seconds;
+    long total_per_mb_seconds;
+    long low_speed_limit;
+    long low_speed_seconds;
+    long stall_seconds;
+} timeout_config_t;
+
+/* Zero in any field means "no limit". Host limits apply on top of the global ones. */
+typedef struct
+{
+    long max_age_days;
+    long max_rows;
+} retention_config_t;
+
 typedef struct
 {
     char *name;
@@ -14,6 +35,13 @@ typedef struct
     char *file_form_field;
     char *response_url_json_path;
     char *response_deletion_url_json_path;
+    char *fallback_host;
+    char *http_version;
+    char *optimize_images;
+    char *compress;
+    char *compress_as;
+    timeout_config_t timeouts;
+    retention_config_t retention;
     char **static_field_names;
     char **static_field_values;
     int static_field_count;
@@ -24,9 +52,15 @@ typedef struct
     int version;
     char *default_host;
     char *log_level;
+    /* Per-subsystem overrides of log_level; NULL inherits it. */
+    char *log_levels[LOG_SUBSYSTEM_COUNT];
+    char *log_format;
     char *log_file;
+    long max_response_size;
+    retention_config_t retention;
     host_config_t **hosts;
     int host_count;
+    arena_t arena;
 } hostman_config_t;
 
 hostman_config_t *
@@ -41,7 +75,7 @@ config_get_value(const char *key);
 bool
 config_set_value(const char *key, const char *value);
 bool
-config_add_host(host_config_t *host);
+config_add_host(const host_config_t *host);
 bool
 config_remove_host(const char *host_name);
 bool
@@ -11,25 +11,81 @@ typedef enum
     LOG_LEVEL_ERROR
 } log_level_t;
 
+/* One per source directory; each can have its own level through log_levels.<name>. */
+typedef enum
+{
+    LOG_SUBSYSTEM_CORE,
+    LOG_SUBSYSTEM_CLI,
+    LOG_SUBSYSTEM_NETWORK,
+    LOG_SUBSYSTEM_STORAGE,
+    LOG_SUBSYSTEM_CRYPTO,
+    LOG_SUBSYSTEM_COUNT
+} log_subsystem_t;
+
+/* CMake defines this for each source group; anything else logs as core. */
+#ifndef LOG_SUBSYSTEM
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_CORE
+#endif
+
+typedef enum
+{
+    LOG_FORMAT_TEXT,
+    LOG_FORMAT_JSON
+} log_format_t;
+
+/* Optional fields attached to messages from one thread, such as the host being uploaded to. */
+typedef struct
+{
+    const char *host;
+    long long upload_id;
+} log_context_t;
+
+/* Read by the log macros, so a filtered message never evaluates its arguments. */
+extern log_level_t log_subsystem_levels[LOG_SUBSYSTEM_COUNT];
+
 bool
 logging_init(void);
 
+bool
+log_level_from_string(const char *text, log_level_t *level);
+bool
+log_subsystem_from_string(const char *text, log_subsystem_t *subsystem);
+const char *
+log_subsystem_to_string(log_subsystem_t subsystem);
+
 void
 log_message(log_level_t level,
+            log_subsystem_t subsystem,
             const char *file,
             int line,
             const char *function,
             const char *format,
             ...);
 
-#define log_debug(format, ...)                                                                     \
-    log_message(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
-#define log_info(format, ...)                                                                      \
-    log_message(LOG_LEVEL_INFO, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
-#define log_warn(format, ...)                                                                      \
-    log_message(LOG_LEVEL_WARN, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
-#define log_error(format, ...)                                                                     \
-    log_message(LOG_LEVEL_ERROR, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+#define log_at(level, format, ...)                                                                 \
+    do                                                                                             \
+    {                                                                                              \
+        if ((level) >= log_subsystem_levels[LOG_SUBSYSTEM])                                        \
+            log_message(                                                                           \
+              level, LOG_SUBSYSTEM, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__);      \
+    } while (0)
+
+#define log_debug(format, ...) log_at(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define log_info(format, ...) log_at(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define log_warn(format, ...) log_at(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define log_error(format, ...) log_at(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+/*
+ * Attach host and upload_id to this thread's messages until log_pop_context restores the
+ * returned context. NULL and 0 keep the current values; host must outlive the pop.
+ */
+log_context_t
+log_push_context(const char *host, long long upload_id);
+void
+log_pop_context(log_context_t previous);
+
+void
+logging_set_console_errors(bool enabled);
 
 void
 logging_cleanup(void);
@@ -0,0 +1,35 @@
+#ifndef HOSTMAN_OPTIMIZE_H
+#define HOSTMAN_OPTIMIZE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_OPTIMIZE_WORKERS 4
+#define MAX_OPTIMIZE_INPUT_BYTES (256 * 1024 * 1024)
+
+typedef struct
+{
+    /* The file to send: a rewritten temporary copy, or the original path. */
+    char *upload_path;
+    size_t original_size;
+    size_t optimized_size;
+    bool optimized;
+} optimize_result_t;
+
+typedef struct optimize_pool optimize_pool_t;
+
+bool
+optimize_enabled(const char *mode);
+bool
+optimize_file(const char *file_path, optimize_result_t *result);
+void
+optimize_result_free(optimize_result_t *result);
+
+optimize_pool_t *
+optimize_pool_start(char **file_paths, int file_count, int workers);
+const optimize_result_t *
+optimize_pool_result(optimize_pool_t *pool, int index);
+void
+optimize_pool_free(optimize_pool_t *pool);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef HOSTMAN_OUTPUT_H
+#define HOSTMAN_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define OUTPUT_RECORD_INITIAL_CAPACITY 1024
+
+/*
+ * Machine-readable output. In JSON mode every result is one JSON object per line, written to
+ * the original stdout with a single write(2) per record, and stdout itself is pointed at
+ * /dev/null so that tables, prompts and colours meant for people never reach it.
+ */
+bool
+output_set_json(void);
+bool
+output_json(void);
+FILE *
+output_stream(void);
+
+/*
+ * A record is built between output_begin and output_end, which hold a lock so records from
+ * concurrent callbacks never interleave. NULL strings are written as null.
+ */
+void
+output_begin(const char *type);
+void
+output_string(const char *key, const char *value);
+void
+output_int(const char *key, long long value);
+void
+output_real(const char *key, double value);
+void
+output_bool(const char *key, bool value);
+void
+output_null(const char *key);
+void
+output_end(void);
+
+const char *
+json_escape(unsigned char c, char escape[8]);
+
+void
+output_cleanup(void);
+
+#endif
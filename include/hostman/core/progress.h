@@ -0,0 +1,20 @@
+#ifndef HOSTMAN_PROGRESS_H
+#define HOSTMAN_PROGRESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MIN_PROGRESS_UPDATE_MS 100
+
+bool
+progress_enabled(void);
+int
+progress_add_bar(const char *label);
+void
+progress_update(int bar, int64_t current, int64_t total);
+void
+progress_remove_bar(int bar);
+void
+progress_clear(void);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef HOSTMAN_UTILS_H
 #define HOSTMAN_UTILS_H
 
+#include "hostman/core/arena.h"
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -14,17 +15,14 @@ char *
 get_filename_from_path(const char *path);
 void
 format_file_size(size_t size, char *buffer, size_t buffer_size);
-char *
+const char *
 get_config_dir(void);
-char *
+const char *
 get_cache_dir(void);
+double
+monotonic_ms(void);
 char *
-extract_json_string(const char *json, const char *path);
-
-bool
-copy_to_clipboard(const char *text);
-const char *
-get_clipboard_manager_name(void);
+extract_json_string(arena_t *arena, const char *json, const char *path);
 
 void
 print_version_info(void);
@@ -0,0 +1,24 @@
+#ifndef HOSTMAN_WATCH_H
+#define HOSTMAN_WATCH_H
+
+#include <stdbool.h>
+
+#define DEFAULT_WATCH_DEBOUNCE_MS 500
+#define DEFAULT_WATCH_IDLE_MS 30000
+
+/*
+ * Called with each settled burst of new files, and with file_count 0 after idle_ms without
+ * any; return false to stop watching.
+ */
+typedef bool (*watch_callback_t)(char **file_paths, int file_count, void *userdata);
+
+bool
+watch_supported(void);
+bool
+watch_directory(const char *dir_path,
+                int debounce_ms,
+                int idle_ms,
+                watch_callback_t callback,
+                void *userdata);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HOSTMAN_BUFFER_H
+#define HOSTMAN_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RESPONSE_BUFFER_INITIAL_CAPACITY 4096
+#define DEFAULT_MAX_RESPONSE_BYTES (1024 * 1024)
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t max_size;
+    bool overflow;
+} response_buffer_t;
+
+bool
+response_buffer_init(response_buffer_t *buffer, size_t initial_capacity, size_t max_size);
+void
+response_buffer_reset(response_buffer_t *buffer);
+bool
+response_buffer_append(response_buffer_t *buffer, const void *data, size_t len);
+size_t
+response_buffer_write_callback(void *contents, size_t size, size_t nmemb, void *userp);
+void
+response_buffer_free(response_buffer_t *buffer);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef HOSTMAN_COMPRESS_H
+#define HOSTMAN_COMPRESS_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define COMPRESS_MIN_FILE_SIZE 1024
+#define COMPRESS_CHUNK_SIZE (64 * 1024)
+#define COMPRESS_PIPE_SIZE (256 * 1024)
+#define COMPRESS_ZSTD_LEVEL 3
+
+typedef enum
+{
+    COMPRESS_NONE,
+    COMPRESS_GZIP,
+    COMPRESS_ZSTD
+} compress_codec_t;
+
+typedef struct compress_stream compress_stream_t;
+
+compress_codec_t
+compress_codec_from_name(const char *name);
+bool
+compress_codec_available(compress_codec_t codec);
+const char *
+compress_codec_name(compress_codec_t codec);
+const char *
+compress_codec_suffix(compress_codec_t codec);
+const char *
+compress_codec_mime_type(compress_codec_t codec);
+bool
+compress_worthwhile(const char *file_path);
+
+compress_stream_t *
+compress_stream_open(const char *file_path, compress_codec_t codec);
+void
+compress_stream_attach_multi(compress_stream_t *stream, CURLM *multi);
+bool
+compress_stream_resume(compress_stream_t *stream);
+size_t
+compress_stream_read(char *buffer, size_t size, size_t nitems, void *arg);
+int
+compress_stream_seek(void *arg, curl_off_t offset, int origin);
+void
+compress_stream_progress(compress_stream_t *stream, curl_off_t *done, curl_off_t *total);
+void
+compress_stream_free(void *arg);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOSTMAN_HEALTH_H
+#define HOSTMAN_HEALTH_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#define HEALTH_FAILURE_THRESHOLD 3
+#define HEALTH_OPEN_SECONDS 60
+
+typedef enum
+{
+    HEALTH_CLOSED,
+    HEALTH_OPEN,
+    HEALTH_HALF_OPEN
+} health_state_t;
+
+bool
+health_allow_request(const char *host_name);
+void
+health_record_success(const char *host_name);
+void
+health_record_failure(const char *host_name);
+health_state_t
+health_get_state(const char *host_name, int *consecutive_failures, time_t *retry_at);
+const char *
+health_state_to_string(health_state_t state);
+
+#endif
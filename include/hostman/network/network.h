@@ -1,29 +1,51 @@
 #ifndef HOSTMAN_NETWORK_H
 #define HOSTMAN_NETWORK_H
 
+#include "hostman/core/arena.h"
 #include "hostman/core/config.h"
+#include "hostman/network/buffer.h"
+#include "hostman/network/compress.h"
 #include <curl/curl.h>
 #include <stdbool.h>
 
 #define DEFAULT_TIMEOUT_SECONDS 30
+#define DEFAULT_TIMEOUT_PER_MB_SECONDS 2
+#define DEFAULT_CONNECT_TIMEOUT_SECONDS 10
+#define DEFAULT_TLS_TIMEOUT_SECONDS 10
+#define DEFAULT_LOW_SPEED_LIMIT 1024
+#define DEFAULT_LOW_SPEED_SECONDS 30
+#define DEFAULT_STALL_SECONDS 15
 #define DEFAULT_MAX_RETRIES 3
 #define DEFAULT_RETRY_DELAY_MS 1000
+#define DEFAULT_RACE_HOSTS 2
+/* How long losers that sent the whole file get to answer so their copies can be deleted. */
+#define DEFAULT_RACE_DRAIN_MS 5000
+#define DEFAULT_BATCH_CONCURRENCY 4
+#define DEFAULT_DELETE_CONCURRENCY 32
+#define DEFAULT_DELETE_HOST_CONNECTIONS 4
 
 typedef struct
 {
-    long timeout_seconds;
+    timeout_config_t timeouts;
     int max_retries;
     long retry_delay_ms;
     bool enable_http2;
     char *proxy_url;
     bool verbose;
+    size_t max_response_bytes;
 } network_config_t;
 
 typedef struct
 {
-    double last_percent;
-    curl_off_t last_bytes;
-    time_t last_time;
+    int bar;
+    CURL *curl;
+    timeout_config_t limits;
+    bool tls;
+    compress_stream_t *source;
+    double start_ms;
+    double last_activity_ms;
+    curl_off_t last_activity_bytes;
+    char abort_reason[128];
 } progress_data_t;
 
 typedef struct
@@ -35,14 +57,67 @@ typedef struct
     double request_time_ms;
     int retry_count;
     long http_code;
+    bool circuit_open;
+    /* Owns url, deletion_url and error_message. */
+    arena_t arena;
 } upload_response_t;
 
+typedef struct
+{
+    int transfers;
+    long connections;
+    long tls_handshakes;
+} upload_batch_stats_t;
+
+/*
+ * Returns the path to send for file_paths[index], or NULL while that file is still being
+ * prepared; the batch keeps its other transfers running and asks again shortly.
+ */
+typedef const char *(*upload_prepare_callback_t)(int index, void *userdata);
+
+typedef void (*upload_batch_callback_t)(int index,
+                                        const char *file_path,
+                                        const upload_response_t *response,
+                                        void *userdata);
+
+typedef void (*delete_batch_callback_t)(int index,
+                                        bool success,
+                                        long http_code,
+                                        const char *error_message,
+                                        void *userdata);
+
 bool
-network_init(void);
+network_init(size_t max_response_bytes);
 void
 network_set_config(network_config_t *config);
+void
+network_preconnect(const host_config_t *host);
 upload_response_t *
 network_upload_file(const char *file_path, host_config_t *host);
+upload_response_t *
+network_upload_race(const char *file_path,
+                    host_config_t **hosts,
+                    int host_count,
+                    int *winner_index);
+int
+network_upload_batch(char **file_paths,
+                     int file_count,
+                     host_config_t *host,
+                     int concurrency,
+                     upload_prepare_callback_t prepare,
+                     upload_batch_callback_t callback,
+                     void *userdata,
+                     upload_batch_stats_t *stats);
+bool
+network_delete_file(const char *deletion_url, long *http_code, char **error_message);
+int
+network_delete_batch(char **deletion_urls,
+                     int url_count,
+                     int max_per_host,
+                     delete_batch_callback_t callback,
+                     void *userdata);
+void
+network_delete_redundant(void);
 void
 network_free_response(upload_response_t *response);
 void
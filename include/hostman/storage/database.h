@@ -1,6 +1,7 @@
 #ifndef HOSTMAN_DATABASE_H
 #define HOSTMAN_DATABASE_H
 
+#include "hostman/core/arena.h"
 #include <sqlite3.h>
 #include <stdbool.h>
 #include <time.h>
@@ -17,6 +18,115 @@ typedef struct
     size_t size;
 } upload_record_t;
 
+/*
+ * A history row as stored, for streaming. The strings point into SQLite's buffers and are only
+ * valid until the cursor moves on; numeric fields are 0 where the column is NULL.
+ */
+typedef struct
+{
+    sqlite3_int64 id;
+    time_t timestamp;
+    const char *host_name;
+    const char *local_path;
+    const char *remote_url;
+    const char *deletion_url;
+    const char *filename;
+    sqlite3_int64 size;
+    double request_time_ms;
+    sqlite3_int64 original_size;
+} upload_row_t;
+
+/* A row's place in the newest-first order, for keyset paging. */
+typedef struct
+{
+    time_t timestamp;
+    sqlite3_int64 id;
+} db_key_t;
+
+/*
+ * Filters for db_cursor_open; zeroed fields match everything. A search ranks rows by relevance
+ * instead of by date.
+ */
+typedef struct
+{
+    const char *host_name;
+    const char *search;
+    time_t since;
+    time_t before;
+    const int *ids;
+    int id_count;
+    bool deletable_only;
+    bool newest_first;
+    /*
+     * Keyset paging for newest_first: only rows older than after, or newer than it when going
+     * backwards. Backwards rows come nearest first, so without after they start at the oldest.
+     */
+    const db_key_t *after;
+    bool backwards;
+    int limit;
+    int offset;
+} db_query_t;
+
+typedef struct db_cursor db_cursor_t;
+
+typedef struct db_importer db_importer_t;
+
+typedef enum
+{
+    STATS_BY_HOST,
+    STATS_BY_DAY
+} stats_grouping_t;
+
+/* Rolled-up totals for one host or one day (key). Percentiles are 0 without timed uploads. */
+typedef struct
+{
+    char *key;
+    sqlite3_int64 uploads;
+    sqlite3_int64 failures;
+    sqlite3_int64 bytes;
+    sqlite3_int64 optimized;
+    sqlite3_int64 optimized_original_bytes;
+    sqlite3_int64 optimized_bytes;
+    sqlite3_int64 timed;
+    double time_total_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+} upload_stats_t;
+
+typedef struct
+{
+    int state;
+    int consecutive_failures;
+    time_t changed_at;
+    time_t last_failure_at;
+} host_health_record_t;
+
+typedef enum
+{
+    QUEUE_PENDING,
+    QUEUE_IN_FLIGHT,
+    QUEUE_DONE,
+    QUEUE_FAILED,
+    QUEUE_STATE_COUNT
+} queue_state_t;
+
+typedef struct
+{
+    sqlite3_int64 id;
+    char *file_path;
+    char *host_name;
+    int state;
+    int attempts;
+    char *last_error;
+    time_t updated_at;
+} queue_job_t;
+
+#define DEFAULT_QUEUE_CLAIM_BATCH 64
+/* A claim not renewed for this long is given up even if its pid is alive again after reuse. */
+#define DEFAULT_QUEUE_LEASE_SECONDS 3600
+#define DB_IMPORT_BATCH_ROWS 10000
+
 bool
 db_init(void);
 
@@ -26,17 +136,109 @@ db_add_upload(const char *host_name,
               const char *remote_url,
               const char *deletion_url,
               const char *filename,
-              size_t size);
+              size_t size,
+              size_t original_size,
+              double request_time_ms);
+
+db_cursor_t *
+db_cursor_open(const db_query_t *query);
 
-upload_record_t **
-db_get_uploads(const char *host_name, int page, int limit, int *count);
+const upload_row_t *
+db_cursor_next(db_cursor_t *cursor);
+
+bool
+db_cursor_close(db_cursor_t *cursor);
+
+upload_record_t *
+db_get_deletion_targets(arena_t *arena,
+                        const char *host_name,
+                        time_t before,
+                        const int *ids,
+                        int id_count,
+                        int *count);
+
+db_importer_t *
+db_import_begin(void);
+bool
+db_import_row(db_importer_t *importer, const upload_row_t *row);
+bool
+db_import_finish(db_importer_t *importer, bool commit, int *imported, int *skipped);
+
+char **
+db_get_fastest_hosts(int limit, int *count);
+
+int
+db_get_optimization_savings(const char *host_name, size_t *original_bytes, size_t *sent_bytes);
+
+bool
+db_record_upload_failure(const char *host_name);
+
+upload_stats_t *
+db_get_stats(stats_grouping_t grouping, const char *host_name, int days, int *count);
 
 void
-db_free_records(upload_record_t **records, int count);
+db_free_stats(upload_stats_t *stats, int count);
+
+bool
+db_rebuild_stats(void);
+
+bool
+db_get_host_health(const char *host_name, host_health_record_t *record);
+
+bool
+db_set_host_health(const char *host_name, const host_health_record_t *record);
 
 bool
 db_delete_upload(int id);
 
+int
+db_delete_uploads(const int *ids, int count);
+
+int
+db_prune_uploads(const char *host_name, time_t before, long keep_newest, int limit);
+
+sqlite3_int64
+db_incremental_vacuum(int max_pages);
+
+bool
+db_vacuum(void);
+
+sqlite3_int64
+db_queue_add(char **file_paths, int count, const char *host_name);
+
+queue_job_t **
+db_queue_claim(sqlite3_int64 min_id, sqlite3_int64 end_id, int limit, int *count);
+
+bool
+db_queue_complete(const queue_job_t *job,
+                  const char *remote_url,
+                  const char *deletion_url,
+                  const char *filename,
+                  size_t size,
+                  size_t original_size,
+                  double request_time_ms);
+
+bool
+db_queue_fail(const queue_job_t *job, const char *error_message);
+
+int
+db_queue_recover(void);
+
+int
+db_queue_retry(void);
+
+int
+db_queue_prune(queue_state_t state, time_t before, int limit);
+
+bool
+db_queue_counts(int counts[QUEUE_STATE_COUNT]);
+
+queue_job_t **
+db_queue_get_jobs(queue_state_t state, int limit, int *count);
+
+void
+db_queue_free_jobs(queue_job_t **jobs, int count);
+
 void
 db_close(void);
 
@@ -0,0 +1,31 @@
+#ifndef HOSTMAN_HISTORY_H
+#define HOSTMAN_HISTORY_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define HISTORY_WRITE_BUFFER_SIZE (1024 * 1024)
+
+typedef enum
+{
+    HISTORY_FORMAT_JSONL,
+    HISTORY_FORMAT_CSV
+} history_format_t;
+
+typedef struct
+{
+    int imported;
+    int skipped;
+    int invalid;
+} history_import_stats_t;
+
+bool
+history_parse_format(const char *name, history_format_t *format);
+history_format_t
+history_format_for_path(const char *path);
+bool
+history_export(FILE *out, history_format_t format, const char *host_name, long *count);
+bool
+history_import(FILE *in, history_format_t format, history_import_stats_t *stats);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef HOSTMAN_PAGE_H
+#define HOSTMAN_PAGE_H
+
+#include "hostman/storage/database.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_PAGE_INITIAL_ROWS 64
+#define HISTORY_PAGE_INITIAL_POOL 4096
+
+/* A string in a page's pool. The pool keeps a NUL after each string; NULL columns are empty. */
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+} history_str_t;
+
+typedef enum
+{
+    HISTORY_SORT_DATE,
+    HISTORY_SORT_SIZE,
+    HISTORY_SORT_LATENCY,
+    HISTORY_SORT_HOST,
+    HISTORY_SORT_FILENAME
+} history_sort_t;
+
+/*
+ * A loaded page of history in columns: row i is ids[i], timestamps[i], ... Host names are interned,
+ * so rows from the same host share one pool entry. A zeroed page is empty and valid; loading
+ * again reuses its memory.
+ */
+typedef struct
+{
+    int count;
+    int capacity;
+    sqlite3_int64 *ids;
+    time_t *timestamps;
+    sqlite3_int64 *sizes;
+    sqlite3_int64 *original_sizes;
+    double *request_time_ms;
+    history_str_t *host_names;
+    history_str_t *filenames;
+    history_str_t *local_paths;
+    history_str_t *remote_urls;
+    history_str_t *deletion_urls;
+
+    char *pool;
+    size_t pool_size;
+    size_t pool_capacity;
+
+    /* Distinct host names on the page, for interning. */
+    history_str_t *hosts;
+    int host_count;
+    int host_capacity;
+} history_page_t;
+
+static inline const char *
+history_page_str(const history_page_t *page, history_str_t str)
+{
+    return page->pool + str.offset;
+}
+
+bool
+history_page_load(history_page_t *page, const db_query_t *query);
+void
+history_page_clear(history_page_t *page);
+int
+history_page_filter(const history_page_t *page, const char *host_name, const char *text, int *rows);
+bool
+history_page_sort(const history_page_t *page,
+                  history_sort_t key,
+                  bool descending,
+                  int *rows,
+                  int count);
+void
+history_page_free(history_page_t *page);
+
+#endif
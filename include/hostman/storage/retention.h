@@ -0,0 +1,32 @@
+#ifndef HOSTMAN_RETENTION_H
+#define HOSTMAN_RETENTION_H
+
+#include "hostman/core/config.h"
+#include <stdbool.h>
+
+#define RETENTION_BATCH_ROWS 500
+/* Budget of one opportunistic pass, e.g. after an upload or on an idle watch tick. */
+#define RETENTION_MAINTAIN_BATCHES 4
+#define RETENTION_MAINTAIN_VACUUM_PAGES 256
+/* Finished queue jobs are kept this long; failed ones stay longer for 'queue retry'. */
+#define RETENTION_QUEUE_DONE_DAYS 7
+#define RETENTION_QUEUE_FAILED_DAYS 30
+
+typedef struct
+{
+    long deleted;
+    long queue_deleted;
+    long long bytes_freed;
+    /* More rows are over a limit than the batch budget allowed deleting. */
+    bool incomplete;
+} retention_result_t;
+
+bool
+retention_enforce(const hostman_config_t *config,
+                  int max_batches,
+                  int vacuum_pages,
+                  retention_result_t *result);
+void
+retention_maintain(const hostman_config_t *config);
+
+#endif
@@ -1,10 +1,20 @@
 #include "hostman/cli/cli.h"
+#include "hostman/core/clipboard.h"
 #include "hostman/core/config.h"
 #include "hostman/core/logging.h"
+#include "hostman/core/optimize.h"
+#include "hostman/core/output.h"
 #include "hostman/core/utils.h"
+#include "hostman/core/watch.h"
+#include "hostman/network/health.h"
 #include "hostman/network/hosts.h"
 #include "hostman/network/network.h"
 #include "hostman/storage/database.h"
+#include "hostman/storage/history.h"
+#include "hostman/storage/retention.h"
+#ifdef USE_TUI
+#include "hostman/cli/tui.h"
+#endif
 #include <getopt.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -22,6 +32,8 @@
 #define EXIT_FILE_ERROR 4
 #define EXIT_CONFIG_ERROR 5
 
+#define DEFAULT_STATS_DAYS 30
+
 void
 print_section_header(const char *text)
 {
@@ -29,11 +41,40 @@ print_section_header(const char *text)
            text);
 }
 
+/* In JSON mode messages become records; the text is trimmed of layout and the "Error: " prefix. */
+static void
+output_message(const char *type, const char *format, va_list args)
+{
+    char message[1024];
+    vsnprintf(message, sizeof(message), format, args);
+
+    char *text = message + strspn(message, " \n");
+    if (strcmp(type, "error") == 0 && strncmp(text, "Error: ", 7) == 0)
+    {
+        text += 7;
+    }
+    size_t length = strlen(text);
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == ' '))
+    {
+        text[--length] = '\0';
+    }
+
+    output_begin(type);
+    output_string("message", text);
+    output_end();
+}
+
 void
 print_success(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
+    if (output_json())
+    {
+        output_message("success", format, args);
+        va_end(args);
+        return;
+    }
     printf("\033[1;32m");
     vprintf(format, args);
     printf("\033[0m");
@@ -45,6 +86,12 @@ print_error(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
+    if (output_json())
+    {
+        output_message("error", format, args);
+        va_end(args);
+        return;
+    }
     fprintf(stderr, "\033[1;31m");
     vfprintf(stderr, format, args);
     fprintf(stderr, "\033[0m");
@@ -90,16 +137,27 @@ print_command_help(const char *command)
         print_section_header("GENERAL OPTIONS");
         print_option("--version, -v", "Display version information");
         print_option("--help, -h", "Display this help message");
+        print_option("--json", "Print results as JSON lines, one object per line");
+        print_option("--format=jsonl", "Same as --json (except after `history`)");
         printf("\n");
 
         print_section_header("COMMANDS");
-        print_command_syntax("upload", "<file_path>"),
-          printf("   Upload a file to a hosting service\n");
+        print_command_syntax("upload", "<file_path>..."),
+          printf("   Upload one or more files to a hosting service\n");
         print_command_syntax("list-uploads", ""), printf("   List upload history\n");
+        print_command_syntax("search", "<query>"), printf("   Search upload history\n");
+        print_command_syntax("stats", ""), printf("   Show upload statistics per host and day\n");
+        print_command_syntax("tui", ""), printf("   Browse, search and manage upload history\n");
         print_command_syntax("delete-upload", "<id>"),
           printf("   Delete an upload record from history\n");
-        print_command_syntax("delete-file", "<id>"),
-          printf("   Delete a file from the remote host\n");
+        print_command_syntax("delete-file", "<id> | --host/--before/--ids"),
+          printf("   Delete files from the remote host\n");
+        print_command_syntax("watch", "<directory>"),
+          printf("   Upload new files as they appear in a directory\n");
+        print_command_syntax("queue", "<run|status|retry>"),
+          printf("   Resume, inspect or retry queued uploads\n");
+        print_command_syntax("history", "<export|import|prune>"),
+          printf("   Export, import or trim the upload history\n");
         print_command_syntax("list-hosts", ""), printf("   List configured hosts\n");
         print_command_syntax("add-host", ""), printf("   Add a new host configuration\n");
         print_command_syntax("remove-host", "<name>"), printf("   Remove a host configuration\n");
@@ -115,14 +173,19 @@ print_command_help(const char *command)
     if (strcmp(command, "upload") == 0)
     {
         print_section_header("UPLOAD");
-        printf("Upload a file to a configured hosting service\n\n");
+        printf("Upload one or more files to a configured hosting service\n\n");
 
         print_section_header("USAGE");
-        printf("  hostman upload [options] <file_path>\n\n");
+        printf("  hostman upload [options] <file_path>...\n\n");
 
         print_section_header("OPTIONS");
         print_option("--host <name>",
                      "Specify which host to use. If not provided, the default host will be used");
+        print_option("--parallel <n>",
+                     "Number of files to upload at once when given several (default: 4)");
+        print_option("--race[=K]",
+                     "Upload to the K historically fastest hosts (default: 2) and keep the first "
+                     "to finish");
         print_option("--help", "Show this help message");
         return;
     }
@@ -143,6 +206,61 @@ print_command_help(const char *command)
         return;
     }
 
+    if (strcmp(command, "search") == 0)
+    {
+        print_section_header("SEARCH");
+        printf("Find uploads whose file name, local path, URL or host contain every word of the "
+               "query.\nWords match as prefixes and the best matches are listed first\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman search [options] <query>...\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>", "Only search uploads to this host");
+        print_option("--since <date>", "Only uploads from YYYY-MM-DD [HH:MM[:SS]] onwards");
+        print_option("--before <date>", "Only uploads older than YYYY-MM-DD [HH:MM[:SS]]");
+        print_option("--limit <count>", "Number of results (default: 20)");
+        print_option("--help", "Show this help message");
+
+        print_section_header("EXAMPLES");
+        printf("  hostman search screenshot\n");
+        printf("  hostman search --host imgur --since 2024-01-01 invoice.pdf\n");
+        return;
+    }
+
+    if (strcmp(command, "stats") == 0)
+    {
+        print_section_header("STATS");
+        printf("Show upload counts, data sent, success rate and latency percentiles per host and "
+               "per day\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman stats [options]\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>", "Only show statistics for this host");
+        print_option("--days <n>", "Cover the last n days, 0 for all time (default: 30)");
+        print_option("--rebuild", "Recompute the statistics from the upload history");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "tui") == 0)
+    {
+        print_section_header("TUI");
+        printf("Browse the upload history in a full-screen terminal view. Type / to search, space "
+               "to select\nrows, c to copy their URLs, d to delete their records and D to delete "
+               "the files from\ntheir hosts\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman tui [options]\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>", "Only show uploads to this host");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
     if (strcmp(command, "delete-upload") == 0)
     {
         print_section_header("DELETE-UPLOAD");
@@ -152,6 +270,7 @@ print_command_help(const char *command)
         printf("  hostman delete-upload <id>\n\n");
 
         print_section_header("OPTIONS");
+        print_option("--yes, -y", "Do not ask for confirmation");
         print_option("--help", "Show this help message");
         return;
     }
@@ -162,10 +281,79 @@ print_command_help(const char *command)
         printf("Delete a file from the remote host using the deletion URL\n\n");
 
         print_section_header("USAGE");
-        printf("  hostman delete-file <id>\n\n");
+        printf("  hostman delete-file <id>\n");
+        printf("  hostman delete-file [--host <name>] [--before <date>] [--ids <id,...>]\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>", "Delete every upload on this host");
+        print_option("--before <date>", "Only uploads older than YYYY-MM-DD [HH:MM[:SS]]");
+        print_option("--ids <id,...>", "Only these upload IDs");
+        print_option("--parallel <n>", "Concurrent deletions per host (default: 4)");
+        print_option("--yes, -y", "Do not ask for confirmation");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "watch") == 0)
+    {
+        print_section_header("WATCH");
+        printf("Upload files as soon as they are written to or moved into a directory\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman watch [options] <directory>\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>",
+                     "Specify which host to use. If not provided, the default host will be used");
+        print_option("--parallel <n>", "Number of files to upload at once (default: 4)");
+        print_option("--debounce <ms>",
+                     "Wait this long after the last new file before uploading (default: 500)");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "queue") == 0)
+    {
+        print_section_header("QUEUE");
+        printf("Multi-file and watched uploads go through a queue in the history database, so an "
+               "interrupted\nbatch can be resumed\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman queue run [--parallel <n>]   Upload everything still pending\n");
+        printf("  hostman queue status                 Show queue counts and failed files\n");
+        printf("  hostman queue retry                  Move failed uploads back to pending\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--parallel <n>", "Number of files to upload at once (default: 4)");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "history") == 0)
+    {
+        print_section_header("HISTORY");
+        printf("Export the upload history, or merge an export back in. Imports skip uploads whose "
+               "URL is\nalready in the history. Prune applies the retention limits right away\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman history export [--format jsonl|csv] [--host <name>] [-o <file>]\n");
+        printf("  hostman history import [--format jsonl|csv] <file|->\n");
+        printf("  hostman history prune [--vacuum]\n\n");
 
         print_section_header("OPTIONS");
+        print_option("--format <fmt>",
+                     "jsonl or csv (default: from the file extension, otherwise jsonl)");
+        print_option("--host <name>", "Only export uploads to this host");
+        print_option("--output, -o <file>", "Write the export to a file instead of stdout");
+        print_option("--vacuum",
+                     "Also rewrite the database file to switch it to incremental vacuum");
         print_option("--help", "Show this help message");
+
+        print_section_header("EXAMPLES");
+        printf("  hostman history export --format csv -o uploads.csv\n");
+        printf("  hostman history import uploads.csv\n");
+        printf("  hostman config set retention.max_age_days 365\n");
+        printf("  hostman history prune\n");
         return;
     }
 
@@ -242,179 +430,1466 @@ print_command_help(const char *command)
     printf("Run 'hostman help' for a list of available commands.\n");
 }
 
-command_args_t
-parse_args(int argc, char *argv[])
+static int
+select_race_hosts(hostman_config_t *config, int wanted, host_config_t **candidates)
 {
-    command_args_t args = { 0 };
-    args.type = CMD_UNKNOWN;
-    args.page = 1;
-    args.limit = 20;
-
-    if (argc < 2)
+    int selected = 0;
+    if (wanted > config->host_count)
     {
-        print_command_help("general");
-        return args;
+        wanted = config->host_count;
     }
 
-    if (strcmp(argv[1], "upload") == 0)
+    int ranked_count = 0;
+    char **ranked = db_get_fastest_hosts(config->host_count, &ranked_count);
+    for (int i = 0; i < ranked_count && selected < wanted; i++)
     {
-        args.type = CMD_UPLOAD;
+        host_config_t *host = config_get_host(ranked[i]);
+        if (host)
+        {
+            candidates[selected++] = host;
+        }
     }
-    else if (strcmp(argv[1], "list-uploads") == 0)
+    for (int i = 0; i < ranked_count; i++)
     {
-        args.type = CMD_LIST_UPLOADS;
+        free(ranked[i]);
     }
-    else if (strcmp(argv[1], "list-hosts") == 0)
-    {
-        args.type = CMD_LIST_HOSTS;
-
-        static struct option long_options[] = { { "help", no_argument, 0, '?' }, { 0, 0, 0, 0 } };
-
-        int option_index = 0;
-        int c;
-        optind = 2;
+    free(ranked);
 
-        while ((c = getopt_long(argc, argv, "", long_options, &option_index)) != -1)
+    /* Hosts with no recorded latency yet still get a chance, default host first. */
+    host_config_t *default_host = config_get_default_host();
+    for (int pass = 0; pass < 2 && selected < wanted; pass++)
+    {
+        for (int i = 0; i < config->host_count && selected < wanted; i++)
         {
-            switch (c)
+            host_config_t *host = config->hosts[i];
+            if (!host || (pass == 0) != (host == default_host))
             {
-                case '?':
-                    print_command_help("list-hosts");
-                    exit(EXIT_SUCCESS);
-                default:
-                    break;
+                continue;
             }
-        }
-    }
-    else if (strcmp(argv[1], "delete-upload") == 0)
-    {
-        args.type = CMD_DELETE_UPLOAD;
-
-        static struct option long_options[] = { { "help", no_argument, 0, '?' }, { 0, 0, 0, 0 } };
-
-        int option_index = 0;
-        int c;
-        optind = 2;
 
-        while ((c = getopt_long(argc, argv, "", long_options, &option_index)) != -1)
-        {
-            switch (c)
+            bool already = false;
+            for (int j = 0; j < selected; j++)
             {
-                case '?':
-                    print_command_help("delete-upload");
-                    exit(EXIT_SUCCESS);
-                default:
+                if (candidates[j] == host)
+                {
+                    already = true;
                     break;
+                }
             }
-        }
-
-        if (optind < argc)
-        {
-            args.upload_id = atoi(argv[optind]);
-            if (args.upload_id <= 0)
+            if (!already)
             {
-                print_error("Error: Invalid upload ID\n");
-                args.type = CMD_UNKNOWN;
+                candidates[selected++] = host;
             }
         }
-        else
+    }
+
+    return selected;
+}
+
+typedef struct
+{
+    host_config_t *host;
+    int completed;
+    int total;
+    int succeeded;
+    char *urls;
+    size_t urls_len;
+    queue_job_t **jobs;
+    optimize_pool_t *optimizer;
+    int optimized;
+    size_t original_bytes;
+    size_t sent_bytes;
+    upload_batch_stats_t stats;
+} batch_context_t;
+
+/* Rewrite the file before upload when every host it goes to asks for it. */
+static const char *
+prepare_upload_file(const char *file_path,
+                    host_config_t **hosts,
+                    int host_count,
+                    optimize_result_t *result)
+{
+    for (int i = 0; i < host_count; i++)
+    {
+        if (!optimize_enabled(hosts[i]->optimize_images))
         {
-            print_error("Error: Upload ID required\n");
-            args.type = CMD_UNKNOWN;
+            return file_path;
         }
     }
-    else if (strcmp(argv[1], "delete-file") == 0)
+
+    optimize_file(file_path, result);
+    return result->upload_path ? result->upload_path : file_path;
+}
+
+static void
+print_optimization_savings(int count, size_t original_bytes, size_t sent_bytes)
+{
+    if (count == 0 || original_bytes == 0)
     {
-        args.type = CMD_DELETE_FILE;
+        return;
+    }
 
-        static struct option long_options[] = { { "help", no_argument, 0, '?' }, { 0, 0, 0, 0 } };
+    char saved_str[32];
+    format_file_size(original_bytes - sent_bytes, saved_str, sizeof(saved_str));
+    print_info("Optimized %d image%s, saving %s (%.0f%%)\n",
+               count,
+               count == 1 ? "" : "s",
+               saved_str,
+               100.0 * (original_bytes - sent_bytes) / original_bytes);
+}
 
-        int option_index = 0;
-        int c;
-        optind = 2;
+static const char *
+prepare_batch_upload(int index, void *userdata)
+{
+    batch_context_t *ctx = userdata;
+    const optimize_result_t *result = optimize_pool_result(ctx->optimizer, index);
+    if (!result)
+    {
+        return NULL;
+    }
+    return result->upload_path ? result->upload_path : ctx->jobs[index]->file_path;
+}
 
-        while ((c = getopt_long(argc, argv, "", long_options, &option_index)) != -1)
-        {
-            switch (c)
-            {
-                case '?':
-                    print_command_help("delete-file");
-                    exit(EXIT_SUCCESS);
-                default:
-                    break;
-            }
-        }
+static void
+emit_upload(const char *file_path,
+            const char *host_name,
+            const upload_response_t *response,
+            size_t size,
+            size_t original_size)
+{
+    output_begin("upload");
+    output_string("file", file_path);
+    output_string("host", host_name);
+    output_bool("ok", response->success);
+    output_string("url", response->success ? response->url : NULL);
+    output_string("deletion_url", response->success ? response->deletion_url : NULL);
+    output_int("size", (long long)size);
+    /* Like history export, an upload that was not optimized or timed has null here. */
+    if (original_size > 0)
+        output_int("original_size", (long long)original_size);
+    else
+        output_null("original_size");
+    if (response->request_time_ms > 0)
+        output_real("request_time_ms", response->request_time_ms);
+    else
+        output_null("request_time_ms");
+    output_int("http_code", response->http_code);
+    output_int("retries", response->retry_count);
+    output_string("error", response->success ? NULL : response->error_message);
+    output_end();
+}
 
-        if (optind < argc)
-        {
-            args.upload_id = atoi(argv[optind]);
-            if (args.upload_id <= 0)
-            {
-                print_error("Error: Invalid upload ID\n");
-                args.type = CMD_UNKNOWN;
-            }
-        }
+static void
+on_batch_upload_done(int index,
+                     const char *file_path,
+                     const upload_response_t *response,
+                     void *userdata)
+{
+    batch_context_t *ctx = userdata;
+    ctx->completed++;
+
+    char *filename = get_filename_from_path(file_path);
+
+    if (!response->success)
+    {
+        const char *error = response->error_message ? response->error_message : "Upload failed";
+        if (output_json())
+            emit_upload(file_path, ctx->host->name, response, 0, 0);
         else
+            print_error("[%d/%d] ✗ %s: %s\n", ctx->completed, ctx->total, filename, error);
+        if (ctx->jobs)
         {
-            print_error("Error: Upload ID required\n");
-            args.type = CMD_UNKNOWN;
+            db_queue_fail(ctx->jobs[index], error);
         }
+        free(filename);
+        return;
     }
-    else if (strcmp(argv[1], "add-host") == 0)
+
+    ctx->succeeded++;
+
+    printf("[%d/%d] \033[1;32m✓\033[0m %s \033[1;32m%s\033[0m\n",
+           ctx->completed,
+           ctx->total,
+           filename,
+           response->url);
+
+    struct stat file_stat;
+    size_t size = stat(file_path, &file_stat) == 0 ? (size_t)file_stat.st_size : 0;
+    size_t original_size = 0;
+
+    const optimize_result_t *optimized = optimize_pool_result(ctx->optimizer, index);
+    if (optimized && optimized->optimized)
     {
-        args.type = CMD_ADD_HOST;
+        original_size = optimized->original_size;
+        size = optimized->optimized_size;
+        ctx->optimized++;
+        ctx->original_bytes += original_size;
+        ctx->sent_bytes += size;
     }
-    else if (strcmp(argv[1], "remove-host") == 0)
+
+    if (output_json())
     {
-        args.type = CMD_REMOVE_HOST;
+        emit_upload(file_path, ctx->host->name, response, size, original_size);
     }
-    else if (strcmp(argv[1], "set-default-host") == 0)
+
+    if (ctx->jobs)
     {
-        args.type = CMD_SET_DEFAULT_HOST;
+        db_queue_complete(ctx->jobs[index],
+                          response->url,
+                          response->deletion_url,
+                          filename,
+                          size,
+                          original_size,
+                          response->request_time_ms);
     }
-    else if (strcmp(argv[1], "config") == 0)
+    else
     {
-        args.type = CMD_CONFIG;
+        db_add_upload(ctx->host->name,
+                      file_path,
+                      response->url,
+                      response->deletion_url,
+                      filename,
+                      size,
+                      original_size,
+                      response->request_time_ms);
     }
-    else if (strcmp(argv[1], "help") == 0 || strcmp(argv[1], "--help") == 0 ||
-             strcmp(argv[1], "-h") == 0)
+    free(filename);
+
+    size_t url_len = strlen(response->url);
+    char *urls = realloc(ctx->urls, ctx->urls_len + url_len + 2);
+    if (urls)
     {
-        args.type = CMD_HELP;
-        if (argc > 2)
+        if (ctx->urls_len > 0)
         {
-            args.command_name = strdup(argv[2]);
+            urls[ctx->urls_len++] = '\n';
+        }
+        memcpy(urls + ctx->urls_len, response->url, url_len + 1);
+        ctx->urls_len += url_len;
+        ctx->urls = urls;
+    }
+}
+
+/*
+ * Upload every pending job with min_id <= id < end_id, or every pending job when end_id is 0.
+ * Jobs are claimed a batch at a time, so a crash loses at most the claimed batch, and even that
+ * is recovered by the next run. Bounding the range keeps jobs other processes queued meanwhile
+ * out of this run.
+ */
+static void
+run_upload_queue(sqlite3_int64 min_id, sqlite3_int64 end_id, int parallel, batch_context_t *ctx)
+{
+    int count = 0;
+    queue_job_t **jobs;
+
+    while ((jobs = db_queue_claim(min_id, end_id, DEFAULT_QUEUE_CLAIM_BATCH, &count)))
+    {
+        host_config_t *host = config_get_host(jobs[0]->host_name);
+        char **file_paths = malloc(count * sizeof(char *));
+
+        if (!host || !file_paths)
+        {
+            const char *error = host ? "Out of memory" : "Host not found";
+            for (int i = 0; i < count; i++)
+            {
+                ctx->completed++;
+                print_error("[%d/%d] ✗ %s: %s\n", ctx->completed, ctx->total, jobs[i]->file_path, error);
+                db_queue_fail(jobs[i], error);
+            }
         }
         else
         {
-            args.command_name = strdup("general");
+            for (int i = 0; i < count; i++)
+            {
+                file_paths[i] = jobs[i]->file_path;
+            }
+
+            ctx->host = host;
+            ctx->jobs = jobs;
+
+            /* Optimizer threads stay ahead of the uploads, which start as each file is ready. */
+            ctx->optimizer = optimize_enabled(host->optimize_images)
+                               ? optimize_pool_start(file_paths, count, 0)
+                               : NULL;
+            network_upload_batch(file_paths,
+                                 count,
+                                 host,
+                                 parallel,
+                                 ctx->optimizer ? prepare_batch_upload : NULL,
+                                 on_batch_upload_done,
+                                 ctx,
+                                 &ctx->stats);
+            optimize_pool_free(ctx->optimizer);
+            ctx->optimizer = NULL;
+            ctx->jobs = NULL;
         }
+
+        free(file_paths);
+        db_queue_free_jobs(jobs, count);
+    }
+}
+
+static void
+print_batch_summary(batch_context_t *ctx)
+{
+    if (output_json())
+    {
+        output_begin("summary");
+        output_int("uploaded", ctx->succeeded);
+        output_int("failed", ctx->total - ctx->succeeded);
+        output_int("transfers", ctx->stats.transfers);
+        output_int("connections", ctx->stats.connections);
+        output_int("tls_handshakes", ctx->stats.tls_handshakes);
+        output_int("optimized", ctx->optimized);
+        output_int("original_bytes", (long long)ctx->original_bytes);
+        output_int("sent_bytes", (long long)ctx->sent_bytes);
+        output_end();
+        return;
+    }
+
+    printf("\n");
+    if (ctx->succeeded == ctx->total)
+    {
+        print_success("All %d files uploaded successfully.\n", ctx->succeeded);
     }
     else
     {
-        print_error("Unknown command: %s\n", argv[1]);
-        args.type = CMD_UNKNOWN;
-        return args;
+        print_error("%d of %d files failed to upload.\n", ctx->total - ctx->succeeded, ctx->total);
     }
 
-    switch (args.type)
+    /* New connections per batch; with HTTP/2 multiplexing this stays at one per host. */
+    if (ctx->stats.transfers > 0)
     {
-        case CMD_UPLOAD:
-        {
-            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
-                                                    { "help", no_argument, 0, '?' },
-                                                    { 0, 0, 0, 0 } };
+        print_info("%d transfers over %ld new connections (%ld TLS handshakes)\n",
+                   ctx->stats.transfers,
+                   ctx->stats.connections,
+                   ctx->stats.tls_handshakes);
+    }
+    print_optimization_savings(ctx->optimized, ctx->original_bytes, ctx->sent_bytes);
 
-            int option_index = 0;
-            int c;
+    const char *clipboard_manager = get_clipboard_manager_name();
+    if (ctx->urls && clipboard_manager && copy_to_clipboard(ctx->urls))
+    {
+        print_success("✓ URLs copied to clipboard using %s\n", clipboard_manager);
+    }
+}
+
+static int
+upload_batch(command_args_t *args, host_config_t *host)
+{
+    batch_context_t ctx = { .host = host, .total = args->file_count };
+
+    /* Queue everything first so an interrupted batch can be finished with `queue run`. */
+    sqlite3_int64 first_id = db_queue_add(args->file_paths, args->file_count, host->name);
+    if (first_id == 0)
+    {
+        print_error("Error: Failed to queue uploads\n");
+        return EXIT_FAILURE;
+    }
+
+    print_section_header("BATCH UPLOAD");
+    print_info("  Uploading %d files to %s\n\n", args->file_count, host->name);
+
+    run_upload_queue(first_id, first_id + args->file_count, args->parallel, &ctx);
+    print_batch_summary(&ctx);
+    free(ctx.urls);
+
+    return ctx.succeeded == ctx.total ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
+}
+
+static const char *
+queue_state_name(int state)
+{
+    switch (state)
+    {
+        case QUEUE_PENDING:
+            return "pending";
+        case QUEUE_IN_FLIGHT:
+            return "in flight";
+        case QUEUE_DONE:
+            return "done";
+        case QUEUE_FAILED:
+            return "failed";
+        default:
+            return "unknown";
+    }
+}
+
+static int
+queue_command(command_args_t *args)
+{
+    const char *action = args->command_name;
+    int counts[QUEUE_STATE_COUNT];
+
+    if (strcmp(action, "run") == 0)
+    {
+        db_queue_recover();
+        if (!db_queue_counts(counts))
+        {
+            return EXIT_FAILURE;
+        }
+        if (counts[QUEUE_PENDING] == 0)
+        {
+            print_info("Upload queue is empty.\n");
+            return EXIT_SUCCESS;
+        }
+
+        batch_context_t ctx = { .total = counts[QUEUE_PENDING] };
+
+        print_section_header("UPLOAD QUEUE");
+        print_info("  Uploading %d queued files\n\n", ctx.total);
+
+        run_upload_queue(0, 0, args->parallel, &ctx);
+        print_batch_summary(&ctx);
+        free(ctx.urls);
+
+        return ctx.succeeded == ctx.total ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
+    }
+
+    if (strcmp(action, "retry") == 0)
+    {
+        int requeued = db_queue_retry();
+        if (requeued < 0)
+        {
+            return EXIT_FAILURE;
+        }
+        print_success("%d failed uploads moved back to the queue. Run 'hostman queue run'.\n",
+                      requeued);
+        return EXIT_SUCCESS;
+    }
+
+    if (!db_queue_counts(counts))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (output_json())
+    {
+        output_begin("queue");
+        for (int state = 0; state < QUEUE_STATE_COUNT; state++)
+        {
+            output_int(state == QUEUE_IN_FLIGHT ? "in_flight" : queue_state_name(state),
+                       counts[state]);
+        }
+        output_end();
+    }
+
+    print_section_header("UPLOAD QUEUE");
+    for (int state = 0; state < QUEUE_STATE_COUNT; state++)
+    {
+        printf("  %-10s %d\n", queue_state_name(state), counts[state]);
+    }
+
+    if (counts[QUEUE_FAILED] > 0)
+    {
+        int count = 0;
+        queue_job_t **jobs = db_queue_get_jobs(QUEUE_FAILED, 20, &count);
+
+        printf("\n");
+        print_section_header("FAILED");
+        for (int i = 0; i < count; i++)
+        {
+            printf("  %s (%s): %s\n",
+                   jobs[i]->file_path,
+                   jobs[i]->host_name,
+                   jobs[i]->last_error ? jobs[i]->last_error : "unknown error");
+        }
+        if (counts[QUEUE_FAILED] > count)
+        {
+            printf("  ... and %d more\n", counts[QUEUE_FAILED] - count);
+        }
+        db_queue_free_jobs(jobs, count);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void
+print_upload_table_header(void)
+{
+    printf("\033[1m%-3s %-20s %-15s %-35s %s\033[0m\n", "ID", "Date", "Host", "Filename", "URL");
+    printf("%-3s %-20s %-15s %-35s %s\n",
+           "---",
+           "--------------------",
+           "---------------",
+           "-----------------------------------",
+           "----------------------------------------------------");
+}
+
+/* Print one history row as a table line; returns whether the upload has a deletion URL. */
+static bool
+print_upload_row(const upload_row_t *row)
+{
+    bool deletable = row->deletion_url && strlen(row->deletion_url) > 0;
+    if (output_json())
+    {
+        output_begin("history");
+        output_int("id", row->id);
+        output_int("timestamp", (long long)row->timestamp);
+        output_string("host", row->host_name);
+        output_string("filename", row->filename);
+        output_string("local_path", row->local_path);
+        output_string("url", row->remote_url);
+        output_string("deletion_url", deletable ? row->deletion_url : NULL);
+        output_int("size", row->size);
+        if (row->original_size > 0)
+            output_int("original_size", row->original_size);
+        else
+            output_null("original_size");
+        if (row->request_time_ms > 0)
+            output_real("request_time_ms", row->request_time_ms);
+        else
+            output_null("request_time_ms");
+        output_end();
+        return deletable;
+    }
+
+    char time_str[21];
+    struct tm *tm_info = localtime(&row->timestamp);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+
+    const char *filename = row->filename ? row->filename : "";
+    char filename_display[36] = { 0 };
+    if (strlen(filename) > 34)
+    {
+        strncpy(filename_display, filename, 31);
+        strcat(filename_display, "...");
+    }
+    else
+    {
+        strcpy(filename_display, filename);
+    }
+
+    printf("%-3lld \033[0;37m%-20s\033[0m \033[0;36m%-15s\033[0m %-35s \033[0;32m%s\033[0m",
+           (long long)row->id,
+           time_str,
+           row->host_name,
+           filename_display,
+           row->remote_url);
+
+    if (deletable)
+    {
+        printf(" \033[1;33m[D]\033[0m");
+    }
+    printf("\n");
+
+    return deletable;
+}
+
+static int
+search_command(command_args_t *args)
+{
+    db_query_t query = {
+        .host_name = args->host_name,
+        .search = args->command_name,
+        .since = args->since,
+        .before = args->before,
+        .limit = args->limit,
+    };
+    db_cursor_t *cursor = db_cursor_open(&query);
+    if (!cursor)
+    {
+        print_error("Error: Search failed\n");
+        return EXIT_FAILURE;
+    }
+
+    const upload_row_t *row = db_cursor_next(cursor);
+    if (!row)
+    {
+        bool ok = db_cursor_close(cursor);
+        if (ok)
+            print_info("No uploads match '%s'.\n", args->command_name);
+        else
+            print_error("Error: Search failed\n");
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    print_section_header("SEARCH RESULTS");
+    print_upload_table_header();
+
+    int count = 0;
+    for (; row; row = db_cursor_next(cursor))
+    {
+        print_upload_row(row);
+        count++;
+    }
+
+    if (!db_cursor_close(cursor))
+    {
+        print_error("Error: Search failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("\n\033[1m%d best match(es)%s\033[0m\n",
+           count,
+           count == args->limit ? "; use --limit to see more" : "");
+    return EXIT_SUCCESS;
+}
+
+static void
+format_latency(double ms, char *buffer, size_t buffer_size)
+{
+    if (ms <= 0)
+        snprintf(buffer, buffer_size, "-");
+    else if (ms < 1000)
+        snprintf(buffer, buffer_size, "%.0f ms", ms);
+    else
+        snprintf(buffer, buffer_size, "%.2f s", ms / 1000);
+}
+
+static void
+print_stats_row(const char *group, const upload_stats_t *stats)
+{
+    if (output_json())
+    {
+        output_begin("stats");
+        output_string("group", group);
+        output_string("key", stats->key);
+        output_int("uploads", stats->uploads);
+        output_int("failures", stats->failures);
+        output_int("bytes", stats->bytes);
+        output_real("avg_ms", stats->timed ? stats->time_total_ms / stats->timed : 0);
+        output_real("p50_ms", stats->p50_ms);
+        output_real("p95_ms", stats->p95_ms);
+        output_real("p99_ms", stats->p99_ms);
+        output_int("optimized", stats->optimized);
+        output_int("optimized_original_bytes", stats->optimized_original_bytes);
+        output_int("optimized_bytes", stats->optimized_bytes);
+        output_end();
+        return;
+    }
+
+    char size_str[32];
+    char avg[16];
+    char p50[16];
+    char p95[16];
+    char p99[16];
+    sqlite3_int64 attempts = stats->uploads + stats->failures;
+
+    format_file_size((size_t)stats->bytes, size_str, sizeof(size_str));
+    format_latency(stats->timed ? stats->time_total_ms / stats->timed : 0, avg, sizeof(avg));
+    format_latency(stats->p50_ms, p50, sizeof(p50));
+    format_latency(stats->p95_ms, p95, sizeof(p95));
+    format_latency(stats->p99_ms, p99, sizeof(p99));
+
+    printf("%-15s %8lld %7.1f%% %10s %9s %9s %9s %9s\n",
+           stats->key,
+           (long long)stats->uploads,
+           attempts ? 100.0 * stats->uploads / attempts : 0.0,
+           size_str,
+           avg,
+           p50,
+           p95,
+           p99);
+}
+
+static void
+print_stats_table(const char *title,
+                  const char *key_label,
+                  const char *group,
+                  upload_stats_t *stats,
+                  int count)
+{
+    print_section_header(title);
+    printf("\033[1m%-15s %8s %8s %10s %9s %9s %9s %9s\033[0m\n",
+           key_label,
+           "Uploads",
+           "Success",
+           "Data",
+           "Avg",
+           "p50",
+           "p95",
+           "p99");
+    for (int i = 0; i < count; i++)
+    {
+        print_stats_row(group, &stats[i]);
+    }
+    printf("\n");
+}
+
+static int
+stats_command(command_args_t *args)
+{
+    if (args->rebuild)
+    {
+        if (!db_rebuild_stats())
+        {
+            print_error("Error: Failed to rebuild statistics\n");
+            return EXIT_FAILURE;
+        }
+        print_success("Statistics rebuilt from the upload history.\n");
+    }
+
+    int host_count = 0;
+    int day_count = 0;
+    upload_stats_t *hosts = db_get_stats(STATS_BY_HOST, args->host_name, args->days, &host_count);
+    upload_stats_t *days = db_get_stats(STATS_BY_DAY, args->host_name, args->days, &day_count);
+    if (host_count == 0)
+    {
+        db_free_stats(hosts, host_count);
+        db_free_stats(days, day_count);
+        print_info("No uploads recorded%s.\n", args->days > 0 ? " in this period" : "");
+        return EXIT_SUCCESS;
+    }
+
+    if (args->days > 0)
+        print_info("Last %d days%s%s\n\n",
+                   args->days,
+                   args->host_name ? " on " : "",
+                   args->host_name ? args->host_name : "");
+    else if (args->host_name)
+        print_info("All time on %s\n\n", args->host_name);
+
+    print_stats_table("BY HOST", "Host", "host", hosts, host_count);
+    print_stats_table("BY DAY", "Day", "day", days, day_count);
+
+    sqlite3_int64 optimized = 0;
+    sqlite3_int64 original_bytes = 0;
+    sqlite3_int64 sent_bytes = 0;
+    for (int i = 0; i < host_count; i++)
+    {
+        optimized += hosts[i].optimized;
+        original_bytes += hosts[i].optimized_original_bytes;
+        sent_bytes += hosts[i].optimized_bytes;
+    }
+    if (optimized > 0)
+    {
+        print_optimization_savings((int)optimized, (size_t)original_bytes, (size_t)sent_bytes);
+    }
+
+    db_free_stats(hosts, host_count);
+    db_free_stats(days, day_count);
+    return EXIT_SUCCESS;
+}
+
+/* Apply the retention limits in full, then release every free page. */
+static int
+prune_history(bool vacuum)
+{
+    hostman_config_t *config = config_load();
+    if (!config)
+    {
+        log_error("Failed to load configuration");
+        return EXIT_CONFIG_ERROR;
+    }
+
+    if (vacuum && !db_vacuum())
+    {
+        print_error("Error: Failed to vacuum the history database\n");
+        config_free(config);
+        return EXIT_FAILURE;
+    }
+
+    retention_result_t result;
+    bool ok = retention_enforce(config, 0, 0, &result);
+    config_free(config);
+    if (!ok)
+    {
+        print_error("Error: Pruning stopped early; %ld uploads were removed before the failure\n",
+                    result.deleted);
+        return EXIT_FAILURE;
+    }
+
+    char size_str[32];
+    format_file_size((size_t)result.bytes_freed, size_str, sizeof(size_str));
+    print_success("Removed %ld uploads past the retention limits, released %s\n",
+                  result.deleted,
+                  size_str);
+    return EXIT_SUCCESS;
+}
+
+static int
+history_command(command_args_t *args)
+{
+    bool to_stdio = !args->file_path || strcmp(args->file_path, "-") == 0;
+    history_format_t format = history_format_for_path(to_stdio ? NULL : args->file_path);
+    if (args->format)
+    {
+        history_parse_format(args->format, &format);
+    }
+
+    if (strcmp(args->command_name, "prune") == 0)
+    {
+        return prune_history(args->vacuum);
+    }
+
+    if (strcmp(args->command_name, "export") == 0)
+    {
+        FILE *out = to_stdio ? output_stream() : fopen(args->file_path, "w");
+        if (!out)
+        {
+            print_error("Error: Cannot write %s\n", args->file_path);
+            return EXIT_FILE_ERROR;
+        }
+
+        long count = 0;
+        bool ok = history_export(out, format, args->host_name, &count);
+        if (to_stdio ? fflush(out) != 0 : fclose(out) != 0)
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            print_error("Error: History export failed\n");
+            return EXIT_FAILURE;
+        }
+
+        /* Keep stdout clean when the export itself goes there. */
+        if (to_stdio)
+        {
+            log_info("Exported %ld uploads", count);
+        }
+        else
+        {
+            print_success("Exported %ld uploads to %s\n", count, args->file_path);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    FILE *in = to_stdio ? stdin : fopen(args->file_path, "r");
+    if (!in)
+    {
+        print_error("Error: Cannot read %s\n", args->file_path);
+        return EXIT_FILE_ERROR;
+    }
+
+    history_import_stats_t stats;
+    bool ok = history_import(in, format, &stats);
+    if (!to_stdio)
+    {
+        fclose(in);
+    }
+
+    if (!ok)
+    {
+        print_error("Error: Import stopped early; %d uploads were imported before the failure\n",
+                    stats.imported);
+        return EXIT_FAILURE;
+    }
+
+    print_success("Imported %d uploads, skipped %d duplicates, %d invalid\n",
+                  stats.imported,
+                  stats.skipped,
+                  stats.invalid);
+    return EXIT_SUCCESS;
+}
+
+typedef struct
+{
+    host_config_t *host;
+    int parallel;
+} watch_context_t;
+
+static bool
+on_watched_files(char **file_paths, int file_count, void *userdata)
+{
+    watch_context_t *watch = userdata;
+    batch_context_t ctx = { .host = watch->host, .total = file_count };
+
+    if (file_count == 0)
+    {
+        /*
+         * Idle: refresh the cached DNS entry and TLS session for the next burst, and trim
+         * the history a little. The config is the cached one watch->host belongs to.
+         */
+        network_preconnect(watch->host);
+        retention_maintain(config_load());
+        return true;
+    }
+
+    sqlite3_int64 first_id = db_queue_add(file_paths, file_count, watch->host->name);
+    if (first_id == 0)
+    {
+        print_error("Error: Failed to queue %d new files\n", file_count);
+        return true;
+    }
+    run_upload_queue(first_id, first_id + file_count, watch->parallel, &ctx);
+    print_optimization_savings(ctx.optimized, ctx.original_bytes, ctx.sent_bytes);
+
+    /* Only the newest URL is useful on the clipboard while watching. */
+    if (ctx.urls)
+    {
+        char *latest = strrchr(ctx.urls, '\n');
+        latest = latest ? latest + 1 : ctx.urls;
+
+        const char *clipboard_manager = get_clipboard_manager_name();
+        if (clipboard_manager && copy_to_clipboard(latest))
+        {
+            print_success("✓ %s copied to clipboard\n", latest);
+        }
+    }
+    free(ctx.urls);
+
+    return true;
+}
+
+static int
+watch_upload_directory(command_args_t *args, host_config_t *host)
+{
+    struct stat dir_stat;
+    if (stat(args->file_path, &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+    {
+        print_error("Error: '%s' is not a directory\n", args->file_path);
+        return EXIT_INVALID_ARGS;
+    }
+
+    watch_context_t watch = { .host = host, .parallel = args->parallel };
+
+    print_section_header("WATCH");
+    print_info("  Uploading new files in %s to %s. Press Ctrl+C to stop.\n\n",
+               args->file_path,
+               host->name);
+
+    if (!watch_directory(args->file_path,
+                         args->debounce_ms > 0 ? args->debounce_ms : DEFAULT_WATCH_DEBOUNCE_MS,
+                         DEFAULT_WATCH_IDLE_MS,
+                         on_watched_files,
+                         &watch))
+    {
+        print_error("Error: Failed to watch '%s'\n", args->file_path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+typedef struct
+{
+    upload_record_t *records;
+    int total;
+    int completed;
+    int *deleted_ids;
+    int deleted_count;
+} delete_context_t;
+
+static void
+emit_delete(int id, const char *filename, bool success, long http_code, const char *error_message)
+{
+    output_begin("delete");
+    output_int("id", id);
+    output_string("file", filename);
+    output_bool("ok", success);
+    output_int("http_code", http_code);
+    output_string("error", success ? NULL : (error_message ? error_message : "Deletion failed"));
+    output_end();
+}
+
+/* --yes answers for the user; EOF or anything but y/Y is a no. */
+static bool
+confirmed(const command_args_t *args, const char *question)
+{
+    if (args->assume_yes)
+    {
+        return true;
+    }
+
+    char response[10];
+    printf("%s [y/N]: ", question);
+    fflush(stdout);
+    return fgets(response, sizeof(response), stdin) != NULL &&
+           (response[0] == 'y' || response[0] == 'Y');
+}
+
+/* Prompts are invisible in JSON mode, so deleting there needs --yes. */
+static bool
+refuse_unconfirmed_json(const command_args_t *args, const char *command)
+{
+    if (output_json() && !args->assume_yes)
+    {
+        print_error("Error: %s asks for confirmation; pass --yes to use it with --json\n", command);
+        return true;
+    }
+    return false;
+}
+
+static void
+on_batch_delete_done(int index,
+                     bool success,
+                     long http_code,
+                     const char *error_message,
+                     void *userdata)
+{
+    delete_context_t *ctx = userdata;
+    upload_record_t *record = &ctx->records[index];
+    ctx->completed++;
+
+    if (output_json())
+    {
+        emit_delete(record->id, record->filename, success, http_code, error_message);
+    }
+
+    if (!success)
+    {
+        if (output_json())
+            return;
+        if (http_code > 0)
+            print_error("[%d/%d] ✗ #%d %s: HTTP %ld\n",
+                        ctx->completed,
+                        ctx->total,
+                        record->id,
+                        record->filename,
+                        http_code);
+        else
+            print_error("[%d/%d] ✗ #%d %s: %s\n",
+                        ctx->completed,
+                        ctx->total,
+                        record->id,
+                        record->filename,
+                        error_message ? error_message : "Deletion failed");
+        return;
+    }
+
+    printf("[%d/%d] \033[1;32m✓\033[0m #%d %s\n",
+           ctx->completed,
+           ctx->total,
+           record->id,
+           record->filename);
+    ctx->deleted_ids[ctx->deleted_count++] = record->id;
+}
+
+static int
+delete_files_bulk(command_args_t *args)
+{
+    /* The records, URLs and IDs all live until the command finishes. */
+    arena_t arena;
+    arena_init(&arena, 0);
+
+    int count = 0;
+    upload_record_t *records = db_get_deletion_targets(
+      &arena, args->host_name, args->before, args->upload_ids, args->upload_id_count, &count);
+
+    if (!records || count == 0)
+    {
+        print_info("No uploads with a deletion URL match the given filters.\n");
+        arena_destroy(&arena);
+        return EXIT_SUCCESS;
+    }
+
+    print_section_header("BULK DELETE");
+    size_t total_size = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total_size += records[i].size;
+    }
+    char size_str[32];
+    format_file_size(total_size, size_str, sizeof(size_str));
+    print_info("  %d files (%s) will be deleted from their remote hosts", count, size_str);
+    if (args->host_name)
+        print_info(" on %s", args->host_name);
+    printf("\n\n");
+
+    char question[96];
+    snprintf(question, sizeof(question), "Delete these %d files and their history records?", count);
+    if (!confirmed(args, question))
+    {
+        print_info("Delete operation cancelled.\n");
+        arena_destroy(&arena);
+        return EXIT_SUCCESS;
+    }
+
+    char **urls = arena_alloc(&arena, count * sizeof(char *));
+    int *deleted_ids = arena_alloc(&arena, count * sizeof(int));
+    if (!urls || !deleted_ids)
+    {
+        print_error("Error: Out of memory\n");
+        arena_destroy(&arena);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        urls[i] = records[i].deletion_url;
+    }
+
+    delete_context_t ctx = { .records = records, .total = count, .deleted_ids = deleted_ids };
+    network_delete_batch(urls, count, args->parallel, on_batch_delete_done, &ctx);
+
+    printf("\n");
+    if (ctx.deleted_count > 0 && db_delete_uploads(deleted_ids, ctx.deleted_count) < 0)
+    {
+        print_error("Files were deleted remotely but their history records could not be removed.\n");
+    }
+
+    int failed = count - ctx.deleted_count;
+    if (failed == 0)
+    {
+        print_success("All %d files deleted.\n", count);
+    }
+    else
+    {
+        print_error("%d of %d files could not be deleted; their records were kept.\n", failed, count);
+    }
+
+    arena_destroy(&arena);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
+}
+
+static bool
+parse_id_list(const char *list, int **ids, int *count)
+{
+    *ids = NULL;
+    *count = 0;
+
+    int capacity = 0;
+    const char *p = list;
+    while (*p)
+    {
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p || id <= 0 || (*end != ',' && *end != '\0'))
+        {
+            free(*ids);
+            *ids = NULL;
+            *count = 0;
+            return false;
+        }
+
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            int *new_ids = realloc(*ids, capacity * sizeof(int));
+            if (!new_ids)
+            {
+                free(*ids);
+                *ids = NULL;
+                *count = 0;
+                return false;
+            }
+            *ids = new_ids;
+        }
+        (*ids)[(*count)++] = (int)id;
+
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return *count > 0;
+}
+
+static bool
+parse_date(const char *text, time_t *out)
+{
+    struct tm tm = { 0 };
+    int consumed = 0;
+
+    if (sscanf(text, "%d-%d-%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &consumed) != 3)
+    {
+        return false;
+    }
+
+    /* The time of day is optional; a bare date means midnight local time. */
+    if (text[consumed] != '\0' &&
+        sscanf(text + consumed, " %d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 2)
+    {
+        return false;
+    }
+
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+
+    *out = mktime(&tm);
+    return *out != (time_t)-1;
+}
+
+/*
+ * Remove the global options from argv and return the new argc. They may come before or after
+ * the command, except that `history` keeps --format for its own export format.
+ */
+static int
+take_global_options(int argc, char *argv[], bool *json)
+{
+    const char *command = NULL;
+    int kept = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool format_option = strcmp(argv[i], "--format=jsonl") == 0 ||
+                             strcmp(argv[i], "--format=json") == 0;
+        if (strcmp(argv[i], "--json") == 0 ||
+            (format_option && !(command && strcmp(command, "history") == 0)))
+        {
+            *json = true;
+            continue;
+        }
+        if (!command && argv[i][0] != '-')
+        {
+            command = argv[i];
+        }
+        argv[kept++] = argv[i];
+    }
+
+    argv[kept] = NULL;
+    return kept;
+}
+
+command_args_t
+parse_args(int argc, char *argv[])
+{
+    command_args_t args = { 0 };
+    args.type = CMD_UNKNOWN;
+    args.page = 1;
+    args.limit = 20;
+
+    bool json = false;
+    argc = take_global_options(argc, argv, &json);
+    if (json && !output_set_json())
+    {
+        return args;
+    }
+
+    if (argc < 2)
+    {
+        print_command_help("general");
+        return args;
+    }
+
+    if (strcmp(argv[1], "upload") == 0)
+    {
+        args.type = CMD_UPLOAD;
+    }
+    else if (strcmp(argv[1], "list-uploads") == 0)
+    {
+        args.type = CMD_LIST_UPLOADS;
+    }
+    else if (strcmp(argv[1], "list-hosts") == 0)
+    {
+        args.type = CMD_LIST_HOSTS;
+
+        static struct option long_options[] = { { "help", no_argument, 0, '?' }, { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int c;
+        optind = 2;
+
+        while ((c = getopt_long(argc, argv, "", long_options, &option_index)) != -1)
+        {
+            switch (c)
+            {
+                case '?':
+                    print_command_help("list-hosts");
+                    exit(EXIT_SUCCESS);
+                default:
+                    break;
+            }
+        }
+    }
+    else if (strcmp(argv[1], "delete-upload") == 0)
+    {
+        args.type = CMD_DELETE_UPLOAD;
+
+        static struct option long_options[] = { { "yes", no_argument, 0, 'y' },
+                                                { "help", no_argument, 0, '?' },
+                                                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int c;
+        optind = 2;
+
+        while ((c = getopt_long(argc, argv, "y", long_options, &option_index)) != -1)
+        {
+            switch (c)
+            {
+                case 'y':
+                    args.assume_yes = true;
+                    break;
+                case '?':
+                    print_command_help("delete-upload");
+                    exit(EXIT_SUCCESS);
+                default:
+                    break;
+            }
+        }
+
+        if (optind < argc)
+        {
+            args.upload_id = atoi(argv[optind]);
+            if (args.upload_id <= 0)
+            {
+                print_error("Error: Invalid upload ID\n");
+                args.type = CMD_UNKNOWN;
+            }
+        }
+        else
+        {
+            print_error("Error: Upload ID required\n");
+            args.type = CMD_UNKNOWN;
+        }
+    }
+    else if (strcmp(argv[1], "delete-file") == 0)
+    {
+        args.type = CMD_DELETE_FILE;
+
+        static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                { "before", required_argument, 0, 'b' },
+                                                { "ids", required_argument, 0, 'i' },
+                                                { "parallel", required_argument, 0, 'j' },
+                                                { "yes", no_argument, 0, 'y' },
+                                                { "help", no_argument, 0, '?' },
+                                                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int c;
+        optind = 2;
+
+        while ((c = getopt_long(argc, argv, "h:j:y", long_options, &option_index)) != -1)
+        {
+            switch (c)
+            {
+                case 'h':
+                    args.host_name = strdup(optarg);
+                    break;
+                case 'b':
+                    if (!parse_date(optarg, &args.before))
+                    {
+                        print_error("Error: Invalid date '%s', expected YYYY-MM-DD [HH:MM[:SS]]\n",
+                                    optarg);
+                        args.type = CMD_UNKNOWN;
+                        return args;
+                    }
+                    break;
+                case 'i':
+                    if (!parse_id_list(optarg, &args.upload_ids, &args.upload_id_count))
+                    {
+                        print_error("Error: Invalid id list '%s', expected e.g. 3,8,21\n", optarg);
+                        args.type = CMD_UNKNOWN;
+                        return args;
+                    }
+                    break;
+                case 'j':
+                    args.parallel = atoi(optarg);
+                    if (args.parallel < 1)
+                        args.parallel = 1;
+                    break;
+                case 'y':
+                    args.assume_yes = true;
+                    break;
+                case '?':
+                    print_command_help("delete-file");
+                    exit(EXIT_SUCCESS);
+                default:
+                    break;
+            }
+        }
+
+        bool bulk = args.host_name || args.before > 0 || args.upload_id_count > 0;
+        if (bulk)
+        {
+            if (optind < argc)
+            {
+                print_error("Error: Pass either an upload ID or --host/--before/--ids, not both\n");
+                args.type = CMD_UNKNOWN;
+            }
+        }
+        else if (optind < argc)
+        {
+            args.upload_id = atoi(argv[optind]);
+            if (args.upload_id <= 0)
+            {
+                print_error("Error: Invalid upload ID\n");
+                args.type = CMD_UNKNOWN;
+            }
+        }
+        else
+        {
+            print_error("Error: Upload ID required\n");
+            args.type = CMD_UNKNOWN;
+        }
+    }
+    else if (strcmp(argv[1], "watch") == 0)
+    {
+        args.type = CMD_WATCH;
+    }
+    else if (strcmp(argv[1], "queue") == 0)
+    {
+        args.type = CMD_QUEUE;
+    }
+    else if (strcmp(argv[1], "history") == 0)
+    {
+        args.type = CMD_HISTORY;
+    }
+    else if (strcmp(argv[1], "search") == 0)
+    {
+        args.type = CMD_SEARCH;
+    }
+    else if (strcmp(argv[1], "stats") == 0)
+    {
+        args.type = CMD_STATS;
+        args.days = DEFAULT_STATS_DAYS;
+    }
+    else if (strcmp(argv[1], "tui") == 0)
+    {
+        args.type = CMD_TUI;
+    }
+    else if (strcmp(argv[1], "add-host") == 0)
+    {
+        args.type = CMD_ADD_HOST;
+    }
+    else if (strcmp(argv[1], "remove-host") == 0)
+    {
+        args.type = CMD_REMOVE_HOST;
+    }
+    else if (strcmp(argv[1], "set-default-host") == 0)
+    {
+        args.type = CMD_SET_DEFAULT_HOST;
+    }
+    else if (strcmp(argv[1], "config") == 0)
+    {
+        args.type = CMD_CONFIG;
+    }
+    else if (strcmp(argv[1], "help") == 0 || strcmp(argv[1], "--help") == 0 ||
+             strcmp(argv[1], "-h") == 0)
+    {
+        args.type = CMD_HELP;
+        if (argc > 2)
+        {
+            args.command_name = strdup(argv[2]);
+        }
+        else
+        {
+            args.command_name = strdup("general");
+        }
+    }
+    else
+    {
+        print_error("Unknown command: %s\n", argv[1]);
+        args.type = CMD_UNKNOWN;
+        return args;
+    }
+
+    switch (args.type)
+    {
+        case CMD_UPLOAD:
+        {
+            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                    { "race", optional_argument, 0, 'r' },
+                                                    { "parallel", required_argument, 0, 'j' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
             optind = 2;
 
-            while ((c = getopt_long(argc, argv, "h:", long_options, &option_index)) != -1)
+            while ((c = getopt_long(argc, argv, "h:j:", long_options, &option_index)) != -1)
             {
                 switch (c)
                 {
                     case 'h':
                         args.host_name = strdup(optarg);
                         break;
+                    case 'j':
+                        args.parallel = atoi(optarg);
+                        if (args.parallel < 1)
+                            args.parallel = 1;
+                        break;
+                    case 'r':
+                        args.race_count = optarg ? atoi(optarg) : DEFAULT_RACE_HOSTS;
+                        if (args.race_count < 2)
+                        {
+                            print_error("Error: --race needs at least 2 hosts\n");
+                            args.type = CMD_UNKNOWN;
+                            return args;
+                        }
+                        break;
                     case '?':
                         print_command_help("upload");
                         exit(EXIT_SUCCESS);
@@ -425,13 +1900,329 @@ parse_args(int argc, char *argv[])
 
             if (optind < argc)
             {
+                args.file_count = argc - optind;
+                args.file_paths = calloc(args.file_count, sizeof(char *));
+                for (int i = 0; args.file_paths && i < args.file_count; i++)
+                {
+                    args.file_paths[i] = strdup(argv[optind + i]);
+                }
+                args.file_path = strdup(argv[optind]);
+            }
+            else
+            {
+                print_error("Error: File path required\n");
+                args.type = CMD_UNKNOWN;
+            }
+
+            if (args.race_count > 0 && args.file_count > 1)
+            {
+                print_error("Error: --race uploads a single file\n");
+                args.type = CMD_UNKNOWN;
+            }
+
+            if (args.race_count > 0 && args.host_name)
+            {
+                print_error("Error: --race picks its own hosts and cannot be combined with --host\n");
+                args.type = CMD_UNKNOWN;
+            }
+            break;
+        }
+
+        case CMD_WATCH:
+        {
+            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                    { "parallel", required_argument, 0, 'j' },
+                                                    { "debounce", required_argument, 0, 'd' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "h:j:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        args.host_name = strdup(optarg);
+                        break;
+                    case 'j':
+                        args.parallel = atoi(optarg);
+                        if (args.parallel < 1)
+                            args.parallel = 1;
+                        break;
+                    case 'd':
+                        args.debounce_ms = atoi(optarg);
+                        break;
+                    case '?':
+                        print_command_help("watch");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+
+            if (optind < argc)
+            {
+                args.file_path = strdup(argv[optind]);
+            }
+            else
+            {
+                print_error("Error: Directory required\n");
+                args.type = CMD_UNKNOWN;
+            }
+            break;
+        }
+
+        case CMD_QUEUE:
+        {
+            static struct option long_options[] = { { "parallel", required_argument, 0, 'j' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "j:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'j':
+                        args.parallel = atoi(optarg);
+                        if (args.parallel < 1)
+                            args.parallel = 1;
+                        break;
+                    case '?':
+                        print_command_help("queue");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+
+            const char *action = optind < argc ? argv[optind] : "status";
+            if (strcmp(action, "run") != 0 && strcmp(action, "status") != 0 &&
+                strcmp(action, "retry") != 0)
+            {
+                print_error("Error: Unknown queue action '%s'\n", action);
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+            args.command_name = strdup(action);
+            break;
+        }
+
+        case CMD_STATS:
+        {
+            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                    { "days", required_argument, 0, 'd' },
+                                                    { "rebuild", no_argument, 0, 'r' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "h:d:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        free(args.host_name);
+                        args.host_name = strdup(optarg);
+                        break;
+                    case 'd':
+                        args.days = atoi(optarg);
+                        if (args.days < 0)
+                            args.days = 0;
+                        break;
+                    case 'r':
+                        args.rebuild = true;
+                        break;
+                    case '?':
+                        print_command_help("stats");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+            break;
+        }
+
+        case CMD_TUI:
+        {
+            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "h:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        free(args.host_name);
+                        args.host_name = strdup(optarg);
+                        break;
+                    case '?':
+                        print_command_help("tui");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+            break;
+        }
+
+        case CMD_SEARCH:
+        {
+            static struct option long_options[] = { { "host", required_argument, 0, 'h' },
+                                                    { "since", required_argument, 0, 's' },
+                                                    { "before", required_argument, 0, 'b' },
+                                                    { "limit", required_argument, 0, 'l' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "h:l:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        free(args.host_name);
+                        args.host_name = strdup(optarg);
+                        break;
+                    case 's':
+                    case 'b':
+                        if (!parse_date(optarg, c == 's' ? &args.since : &args.before))
+                        {
+                            print_error(
+                              "Error: Invalid date '%s', expected YYYY-MM-DD [HH:MM[:SS]]\n",
+                              optarg);
+                            args.type = CMD_UNKNOWN;
+                            return args;
+                        }
+                        break;
+                    case 'l':
+                        args.limit = atoi(optarg);
+                        if (args.limit < 1)
+                            args.limit = 1;
+                        break;
+                    case '?':
+                        print_command_help("search");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+
+            /* The remaining words form the query, so quoting it is optional. */
+            size_t length = 0;
+            for (int i = optind; i < argc; i++)
+            {
+                length += strlen(argv[i]) + 1;
+            }
+            if (length <= 1 || !(args.command_name = malloc(length)))
+            {
+                print_error("Error: Search query required\n");
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+            args.command_name[0] = '\0';
+            for (int i = optind; i < argc; i++)
+            {
+                if (i > optind)
+                    strcat(args.command_name, " ");
+                strcat(args.command_name, argv[i]);
+            }
+            break;
+        }
+
+        case CMD_HISTORY:
+        {
+            static struct option long_options[] = { { "format", required_argument, 0, 'f' },
+                                                    { "host", required_argument, 0, 'h' },
+                                                    { "output", required_argument, 0, 'o' },
+                                                    { "vacuum", no_argument, 0, 'V' },
+                                                    { "help", no_argument, 0, '?' },
+                                                    { 0, 0, 0, 0 } };
+
+            int option_index = 0;
+            int c;
+            optind = 2;
+
+            while ((c = getopt_long(argc, argv, "f:h:o:", long_options, &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'f':
+                        free(args.format);
+                        args.format = strdup(optarg);
+                        break;
+                    case 'h':
+                        free(args.host_name);
+                        args.host_name = strdup(optarg);
+                        break;
+                    case 'o':
+                        free(args.file_path);
+                        args.file_path = strdup(optarg);
+                        break;
+                    case 'V':
+                        args.vacuum = true;
+                        break;
+                    case '?':
+                        print_command_help("history");
+                        exit(EXIT_SUCCESS);
+                    default:
+                        break;
+                }
+            }
+
+            history_format_t format;
+            if (args.format && !history_parse_format(args.format, &format))
+            {
+                print_error("Error: Unknown history format '%s' (use jsonl or csv)\n", args.format);
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+
+            const char *action = optind < argc ? argv[optind++] : "";
+            if (strcmp(action, "export") == 0)
+            {
+                if (optind < argc)
+                {
+                    print_error("Error: Use --output to export to a file\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+            }
+            else if (strcmp(action, "import") == 0)
+            {
+                if (optind >= argc || args.file_path)
+                {
+                    print_error("Error: File to import required (use - for stdin)\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
                 args.file_path = strdup(argv[optind]);
             }
-            else
+            else if (strcmp(action, "prune") != 0)
             {
-                print_error("Error: File path required\n");
+                print_error("Error: Expected 'history export', 'history import' or "
+                            "'history prune'\n");
                 args.type = CMD_UNKNOWN;
+                break;
             }
+            args.command_name = strdup(action);
             break;
         }
 
@@ -578,9 +2369,33 @@ parse_args(int argc, char *argv[])
     return args;
 }
 
+/*
+ * Start DNS, TCP and TLS for the target host in the background as soon as the arguments are
+ * known; the upload joins it just before its first request.
+ */
+static void
+preconnect_for_command(const command_args_t *args)
+{
+    bool single_host = (args->type == CMD_UPLOAD && args->race_count == 0) ||
+                       args->type == CMD_WATCH;
+    if (!single_host)
+    {
+        return;
+    }
+
+    host_config_t *host =
+      args->host_name ? config_get_host(args->host_name) : config_get_default_host();
+    if (host)
+    {
+        network_preconnect(host);
+    }
+}
+
 int
 execute_command(command_args_t *args)
 {
+    preconnect_for_command(args);
+
     switch (args->type)
     {
         case CMD_UPLOAD:
@@ -593,31 +2408,113 @@ execute_command(command_args_t *args)
             }
 
             host_config_t *host = NULL;
-            if (args->host_name)
+            upload_response_t *response = NULL;
+            int race_count = 0;
+            optimize_result_t optimized = { 0 };
+            const char *upload_path = args->file_path;
+
+            if (args->file_count > 1)
             {
-                host = config_get_host(args->host_name);
+                host = args->host_name ? config_get_host(args->host_name)
+                                       : config_get_default_host();
                 if (!host)
                 {
-                    print_error("Error: Host '%s' not found\n", args->host_name);
+                    print_error("Error: %s\n",
+                                args->host_name ? "Host not found" : "No default host configured");
                     config_free(config);
-                    return EXIT_INVALID_ARGS;
+                    return args->host_name ? EXIT_INVALID_ARGS : EXIT_CONFIG_ERROR;
                 }
+
+                int result = upload_batch(args, host);
+                config_free(config);
+                return result;
             }
-            else
+
+            if (args->race_count > 0)
             {
-                host = config_get_default_host();
-                if (!host)
+                if (config->host_count < 2)
                 {
-                    print_error("Error: No default host configured\n");
+                    print_error("Error: --race needs at least 2 configured hosts\n");
                     config_free(config);
                     return EXIT_CONFIG_ERROR;
                 }
+
+                host_config_t **candidates = calloc(config->host_count, sizeof(host_config_t *));
+                if (!candidates)
+                {
+                    log_error("Failed to allocate race candidates");
+                    config_free(config);
+                    return EXIT_FAILURE;
+                }
+
+                race_count = select_race_hosts(config, args->race_count, candidates);
+                upload_path =
+                  prepare_upload_file(args->file_path, candidates, race_count, &optimized);
+
+                int winner = -1;
+                response = network_upload_race(upload_path, candidates, race_count, &winner);
+                if (winner >= 0)
+                {
+                    host = candidates[winner];
+                }
+                free(candidates);
+            }
+            else
+            {
+                if (args->host_name)
+                {
+                    host = config_get_host(args->host_name);
+                    if (!host)
+                    {
+                        print_error("Error: Host '%s' not found\n", args->host_name);
+                        config_free(config);
+                        return EXIT_INVALID_ARGS;
+                    }
+                }
+                else
+                {
+                    host = config_get_default_host();
+                    if (!host)
+                    {
+                        print_error("Error: No default host configured\n");
+                        config_free(config);
+                        return EXIT_CONFIG_ERROR;
+                    }
+                }
+
+                upload_path = prepare_upload_file(args->file_path, &host, 1, &optimized);
+                response = network_upload_file(upload_path, host);
+
+                if (response && !response->success && host->fallback_host &&
+                    health_get_state(host->name, NULL, NULL) != HEALTH_CLOSED)
+                {
+                    host_config_t *fallback = config_get_host(host->fallback_host);
+                    if (fallback)
+                    {
+                        print_info("Host '%s' is unhealthy, failing over to '%s'\n",
+                                   host->name,
+                                   fallback->name);
+                        network_free_response(response);
+                        host = fallback;
+                        if (!optimize_enabled(host->optimize_images))
+                        {
+                            upload_path = args->file_path;
+                        }
+                        response = network_upload_file(upload_path, host);
+                    }
+                    else
+                    {
+                        log_warn("Fallback host '%s' for '%s' does not exist",
+                                 host->fallback_host,
+                                 host->name);
+                    }
+                }
             }
 
-            upload_response_t *response = network_upload_file(args->file_path, host);
             if (!response)
             {
                 print_error("Error: Upload failed\n");
+                optimize_result_free(&optimized);
                 config_free(config);
                 return EXIT_NETWORK_ERROR;
             }
@@ -633,8 +2530,28 @@ execute_command(command_args_t *args)
                 char size_str[32];
                 format_file_size(file_stat.st_size, size_str, sizeof(size_str));
 
-                print_info("  File: %s (%s)\n", filename, size_str);
-                print_info("  Host: %s\n", host->name);
+                size_t sent_size = file_stat.st_size;
+                size_t original_size = 0;
+                if (optimized.optimized && upload_path == optimized.upload_path)
+                {
+                    char sent_str[32];
+                    original_size = optimized.original_size;
+                    sent_size = optimized.optimized_size;
+                    format_file_size(sent_size, sent_str, sizeof(sent_str));
+                    print_info("  File: %s (%s, optimized to %s)\n", filename, size_str, sent_str);
+                }
+                else
+                {
+                    print_info("  File: %s (%s)\n", filename, size_str);
+                }
+                if (race_count > 0)
+                {
+                    print_info("  Host: %s (fastest of %d raced)\n", host->name, race_count);
+                }
+                else
+                {
+                    print_info("  Host: %s\n", host->name);
+                }
 
                 double time_ms = response->request_time_ms;
                 char time_str[32];
@@ -657,28 +2574,43 @@ execute_command(command_args_t *args)
                 }
                 printf("\n");
 
-                const char *clipboard_manager = get_clipboard_manager_name();
+                /* A script reads the URL from the record; leave the clipboard alone. */
+                const char *clipboard_manager = output_json() ? NULL : get_clipboard_manager_name();
                 if (clipboard_manager && copy_to_clipboard(response->url))
                 {
                     print_success("✓ URL copied to clipboard using %s\n", clipboard_manager);
                 }
+                if (output_json())
+                {
+                    emit_upload(args->file_path, host->name, response, sent_size, original_size);
+                }
 
                 db_add_upload(host->name,
                               args->file_path,
                               response->url,
                               response->deletion_url,
                               filename,
-                              file_stat.st_size);
+                              sent_size,
+                              original_size,
+                              response->request_time_ms);
+
+                /* The result is already out, so cleaning up the losers' copies delays nothing. */
+                network_delete_redundant();
 
                 free(filename);
                 network_free_response(response);
+                optimize_result_free(&optimized);
                 config_free(config);
                 return EXIT_SUCCESS;
             }
             else
             {
-                print_error("Error: %s\n", response->error_message);
+                if (output_json())
+                    emit_upload(args->file_path, host ? host->name : NULL, response, 0, 0);
+                else
+                    print_error("Error: %s\n", response->error_message);
                 network_free_response(response);
+                optimize_result_free(&optimized);
                 config_free(config);
                 return EXIT_NETWORK_ERROR;
             }
@@ -686,20 +2618,23 @@ execute_command(command_args_t *args)
 
         case CMD_LIST_UPLOADS:
         {
-            int count = 0;
-            upload_record_t **records =
-              db_get_uploads(args->host_name, args->page, args->limit, &count);
-
-            if (!records)
-            {
-                print_error("Error: Failed to retrieve upload records\n");
-                return EXIT_FAILURE;
-            }
-
-            if (count == 0)
+            db_query_t query = {
+                .host_name = args->host_name,
+                .newest_first = true,
+                .limit = args->limit,
+                .offset = (args->page - 1) * args->limit,
+            };
+            db_cursor_t *cursor = db_cursor_open(&query);
+            const upload_row_t *row = db_cursor_next(cursor);
+
+            if (!row)
             {
+                if (!db_cursor_close(cursor))
+                {
+                    print_error("Error: Failed to retrieve upload records\n");
+                    return EXIT_FAILURE;
+                }
                 print_info("No upload records found.\n");
-                db_free_records(records, count);
                 return EXIT_SUCCESS;
             }
 
@@ -710,59 +2645,24 @@ execute_command(command_args_t *args)
                 print_info("Host: %s\n\n", args->host_name);
             }
 
-            printf(
-              "\033[1m%-3s %-20s %-15s %-35s %s\033[0m\n", "ID", "Date", "Host", "Filename", "URL");
-            printf("%-3s %-20s %-15s %-35s %s\n",
-                   "---",
-                   "--------------------",
-                   "---------------",
-                   "-----------------------------------",
-                   "----------------------------------------------------");
+            print_upload_table_header();
 
-            for (int i = 0; i < count; i++)
+            int count = 0;
+            bool has_deletion_urls = false;
+            for (; row; row = db_cursor_next(cursor))
             {
-                char time_str[21];
-                struct tm *tm_info = localtime(&records[i]->timestamp);
-                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
-                char filename_display[36] = { 0 };
-                if (strlen(records[i]->filename) > 34)
-                {
-                    strncpy(filename_display, records[i]->filename, 31);
-                    strcat(filename_display, "...");
-                }
-                else
-                {
-                    strcpy(filename_display, records[i]->filename);
-                }
-
-                printf(
-                  "%-3d \033[0;37m%-20s\033[0m \033[0;36m%-15s\033[0m %-35s \033[0;32m%s\033[0m",
-                  records[i]->id,
-                  time_str,
-                  records[i]->host_name,
-                  filename_display,
-                  records[i]->remote_url);
-
-                if (records[i]->deletion_url && strlen(records[i]->deletion_url) > 0)
-                {
-                    printf(" \033[1;33m[D]\033[0m");
-                }
-                printf("\n");
+                has_deletion_urls |= print_upload_row(row);
+                count++;
             }
 
-            printf("\n\033[1mPage %d, showing %d record(s)\033[0m\n", args->page, count);
-
-            bool has_deletion_urls = false;
-            for (int i = 0; i < count; i++)
+            if (!db_cursor_close(cursor))
             {
-                if (records[i]->deletion_url && strlen(records[i]->deletion_url) > 0)
-                {
-                    has_deletion_urls = true;
-                    break;
-                }
+                print_error("Error: Failed to retrieve upload records\n");
+                return EXIT_FAILURE;
             }
 
+            printf("\n\033[1mPage %d, showing %d record(s)\033[0m\n", args->page, count);
+
             if (has_deletion_urls)
             {
                 printf("\nRecords marked with \033[1;33m[D]\033[0m have deletion URLs.\n");
@@ -770,7 +2670,16 @@ execute_command(command_args_t *args)
                 printf("  hostman delete-file <id>\n");
             }
 
-            db_free_records(records, count);
+            size_t original_bytes = 0;
+            size_t sent_bytes = 0;
+            int optimized_count =
+              db_get_optimization_savings(args->host_name, &original_bytes, &sent_bytes);
+            if (optimized_count > 0)
+            {
+                printf("\n");
+                print_optimization_savings(optimized_count, original_bytes, sent_bytes);
+            }
+
             return EXIT_SUCCESS;
         }
 
@@ -792,21 +2701,63 @@ execute_command(command_args_t *args)
 
             print_section_header("CONFIGURED HOSTS");
 
-            printf("\033[1m%-20s %-40s %s\033[0m\n", "Name", "API Endpoint", "Default");
-            printf("%-20s %-40s %s\n",
+            printf("\033[1m%-20s %-40s %-7s %s\033[0m\n", "Name", "API Endpoint", "Default", "Health");
+            printf("%-20s %-40s %-7s %s\n",
                    "--------------------",
                    "----------------------------------------",
-                   "-------");
+                   "-------",
+                   "------------------------------");
 
+            time_t now = time(NULL);
             for (int i = 0; i < config->host_count; i++)
             {
                 const bool is_default = (config->default_host &&
                                          strcmp(config->default_host, config->hosts[i]->name) == 0);
 
-                printf("\033[0;36m%-20s\033[0m %-40s %s\n",
+                int failures = 0;
+                time_t retry_at = 0;
+                health_state_t state = health_get_state(config->hosts[i]->name, &failures, &retry_at);
+
+                if (output_json())
+                {
+                    output_begin("host");
+                    output_string("name", config->hosts[i]->name);
+                    output_string("api_endpoint", config->hosts[i]->api_endpoint);
+                    output_bool("default", is_default);
+                    output_string("health", health_state_to_string(state));
+                    output_int("failures", failures);
+                    output_int("retry_at", state == HEALTH_CLOSED ? 0 : (long long)retry_at);
+                    output_end();
+                    continue;
+                }
+
+                char health_str[64];
+                if (state == HEALTH_CLOSED)
+                {
+                    snprintf(health_str, sizeof(health_str), "\033[0;32mok\033[0m");
+                }
+                else if (state == HEALTH_OPEN && retry_at > now)
+                {
+                    snprintf(health_str,
+                             sizeof(health_str),
+                             "\033[1;31mopen\033[0m (%d failures, probe in %lds)",
+                             failures,
+                             (long)(retry_at - now));
+                }
+                else
+                {
+                    snprintf(health_str,
+                             sizeof(health_str),
+                             "\033[1;33m%s\033[0m (%d failures)",
+                             health_state_to_string(state),
+                             failures);
+                }
+
+                printf("\033[0;36m%-20s\033[0m %-40s %s %s\n",
                        config->hosts[i]->name,
                        config->hosts[i]->api_endpoint,
-                       is_default ? "\033[1;32m✓ Yes\033[0m" : "No");
+                       is_default ? "\033[1;32m✓ Yes\033[0m  " : "No     ",
+                       health_str);
             }
 
             config_free(config);
@@ -815,6 +2766,11 @@ execute_command(command_args_t *args)
 
         case CMD_ADD_HOST:
         {
+            if (output_json())
+            {
+                print_error("Error: add-host is interactive and cannot be used with --json\n");
+                return EXIT_INVALID_ARGS;
+            }
             return hosts_add_interactive();
         }
 
@@ -863,6 +2819,15 @@ execute_command(command_args_t *args)
             if (args->config_get)
             {
                 char *value = config_get_value(args->config_key);
+                if (value && output_json())
+                {
+                    output_begin("config");
+                    output_string("key", args->config_key);
+                    output_string("value", value);
+                    output_end();
+                    free(value);
+                    return EXIT_SUCCESS;
+                }
                 if (value)
                 {
                     print_success("%s\n", value);
@@ -896,43 +2861,40 @@ execute_command(command_args_t *args)
 
         case CMD_DELETE_UPLOAD:
         {
+            if (refuse_unconfirmed_json(args, "delete-upload"))
+            {
+                return EXIT_INVALID_ARGS;
+            }
             if (args->upload_id <= 0)
             {
                 print_error("Error: Invalid upload ID\n");
                 return EXIT_INVALID_ARGS;
             }
 
-            int count = 0;
-            upload_record_t **records = db_get_uploads(NULL, 1, 1000, &count);
-            bool found = false;
+            db_query_t query = { .ids = &args->upload_id, .id_count = 1 };
+            db_cursor_t *cursor = db_cursor_open(&query);
+            const upload_row_t *row = db_cursor_next(cursor);
+            bool found = row != NULL;
+            char *filename = row && row->filename ? strdup(row->filename) : NULL;
 
-            if (records)
+            if (row)
             {
-                for (int i = 0; i < count; i++)
-                {
-                    if (records[i]->id == args->upload_id)
-                    {
-                        found = true;
-                        printf("Delete the following record?\n\n");
-
-                        char time_str[21];
-                        struct tm *tm_info = localtime(&records[i]->timestamp);
-                        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+                printf("Delete the following record?\n\n");
 
-                        char size_str[32];
-                        format_file_size(records[i]->size, size_str, sizeof(size_str));
+                char time_str[21];
+                struct tm *tm_info = localtime(&row->timestamp);
+                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
 
-                        print_info("ID: %d\n", records[i]->id);
-                        print_info("Date: %s\n", time_str);
-                        print_info("Host: %s\n", records[i]->host_name);
-                        print_info("File: %s (%s)\n", records[i]->filename, size_str);
-                        print_info("URL: %s\n\n", records[i]->remote_url);
+                char size_str[32];
+                format_file_size((size_t)row->size, size_str, sizeof(size_str));
 
-                        break;
-                    }
-                }
-                db_free_records(records, count);
+                print_info("ID: %lld\n", (long long)row->id);
+                print_info("Date: %s\n", time_str);
+                print_info("Host: %s\n", row->host_name);
+                print_info("File: %s (%s)\n", row->filename, size_str);
+                print_info("URL: %s\n\n", row->remote_url);
             }
+            db_cursor_close(cursor);
 
             if (!found)
             {
@@ -940,172 +2902,177 @@ execute_command(command_args_t *args)
                 return EXIT_FAILURE;
             }
 
-            char response[10];
-            printf("Are you sure you want to delete this record? [y/N]: ");
-            if (fgets(response, sizeof(response), stdin) == NULL)
+            if (!confirmed(args, "Are you sure you want to delete this record?"))
+            {
+                print_info("Delete operation cancelled.\n");
+                free(filename);
+                return EXIT_SUCCESS;
+            }
+
+            bool deleted = db_delete_upload(args->upload_id);
+            if (output_json())
+                emit_delete(args->upload_id, filename, deleted, 0, "Failed to delete upload record");
+            else if (deleted)
+                print_success("Upload record deleted successfully.\n");
+            else
+                print_error("Error: Failed to delete upload record.\n");
+            free(filename);
+            return deleted ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        case CMD_QUEUE:
+        {
+            return queue_command(args);
+        }
+
+        case CMD_HISTORY:
+        {
+            return history_command(args);
+        }
+
+        case CMD_SEARCH:
+        {
+            return search_command(args);
+        }
+
+        case CMD_STATS:
+        {
+            return stats_command(args);
+        }
+
+        case CMD_TUI:
+        {
+            if (output_json())
+            {
+                print_error("Error: tui is interactive and cannot be used with --json\n");
+                return EXIT_INVALID_ARGS;
+            }
+#ifdef USE_TUI
+            return tui_run(args->host_name) ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+            print_error("Error: hostman was built without TUI support "
+                        "(configure with -DHOSTMAN_USE_TUI=ON)\n");
+            return EXIT_FAILURE;
+#endif
+        }
+
+        case CMD_WATCH:
+        {
+            if (!watch_supported())
             {
-                print_error("Error reading response\n");
+                print_error("Error: watch is only supported on Linux\n");
                 return EXIT_FAILURE;
             }
 
-            if (response[0] == 'y' || response[0] == 'Y')
+            hostman_config_t *config = config_load();
+            if (!config)
             {
-                if (db_delete_upload(args->upload_id))
-                {
-                    print_success("Upload record deleted successfully.\n");
-                    return EXIT_SUCCESS;
-                }
-                else
-                {
-                    print_error("Error: Failed to delete upload record.\n");
-                    return EXIT_FAILURE;
-                }
+                log_error("Failed to load configuration");
+                return EXIT_CONFIG_ERROR;
             }
-            else
+
+            host_config_t *host =
+              args->host_name ? config_get_host(args->host_name) : config_get_default_host();
+            if (!host)
             {
-                print_info("Delete operation cancelled.\n");
-                return EXIT_SUCCESS;
+                print_error("Error: %s\n",
+                            args->host_name ? "Host not found" : "No default host configured");
+                config_free(config);
+                return args->host_name ? EXIT_INVALID_ARGS : EXIT_CONFIG_ERROR;
             }
+
+            int result = watch_upload_directory(args, host);
+            config_free(config);
+            return result;
         }
 
         case CMD_DELETE_FILE:
         {
+            if (refuse_unconfirmed_json(args, "delete-file"))
+            {
+                return EXIT_INVALID_ARGS;
+            }
+            if (args->host_name || args->before > 0 || args->upload_id_count > 0)
+            {
+                return delete_files_bulk(args);
+            }
+
             if (args->upload_id <= 0)
             {
                 print_error("Error: Invalid upload ID\n");
                 return EXIT_INVALID_ARGS;
             }
 
-            int count = 0;
-            upload_record_t **records = db_get_uploads(NULL, 1, 1000, &count);
-            bool found = false;
-            char *deletion_url = NULL;
-            upload_record_t *record = NULL;
+            db_query_t query = { .ids = &args->upload_id, .id_count = 1 };
+            db_cursor_t *cursor = db_cursor_open(&query);
+            const upload_row_t *row = db_cursor_next(cursor);
 
-            if (records)
+            if (!row)
             {
-                for (int i = 0; i < count; i++)
-                {
-                    if (records[i]->id == args->upload_id)
-                    {
-                        found = true;
-                        record = records[i];
-
-                        if (!record->deletion_url || strlen(record->deletion_url) == 0)
-                        {
-                            print_error("Error: This upload doesn't have a deletion URL\n");
-                            db_free_records(records, count);
-                            return EXIT_FAILURE;
-                        }
-
-                        deletion_url = strdup(record->deletion_url);
-
-                        printf("Delete the following file from the remote host?\n\n");
-
-                        char time_str[21];
-                        struct tm *tm_info = localtime(&record->timestamp);
-                        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
-                        char size_str[32];
-                        format_file_size(record->size, size_str, sizeof(size_str));
-
-                        print_info("ID: %d\n", record->id);
-                        print_info("Date: %s\n", time_str);
-                        print_info("Host: %s\n", record->host_name);
-                        print_info("File: %s (%s)\n", record->filename, size_str);
-                        print_info("URL: %s\n", record->remote_url);
-                        print_info("Deletion URL: %s\n\n", record->deletion_url);
-                        break;
-                    }
-                }
+                db_cursor_close(cursor);
+                print_error("Error: No upload record found with ID %d\n", args->upload_id);
+                return EXIT_FAILURE;
             }
 
-            if (!found || !deletion_url)
+            if (!row->deletion_url || strlen(row->deletion_url) == 0)
             {
-                print_error("Error: No upload record found with ID %d\n", args->upload_id);
-                if (records)
-                    db_free_records(records, count);
+                db_cursor_close(cursor);
+                print_error("Error: This upload doesn't have a deletion URL\n");
                 return EXIT_FAILURE;
             }
 
-            char response[10];
-            printf("Are you sure you want to delete this file from the remote host? [y/N]: ");
-            if (fgets(response, sizeof(response), stdin) == NULL)
+            printf("Delete the following file from the remote host?\n\n");
+
+            char time_str[21];
+            struct tm *tm_info = localtime(&row->timestamp);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+
+            char size_str[32];
+            format_file_size((size_t)row->size, size_str, sizeof(size_str));
+
+            print_info("ID: %lld\n", (long long)row->id);
+            print_info("Date: %s\n", time_str);
+            print_info("Host: %s\n", row->host_name);
+            print_info("File: %s (%s)\n", row->filename, size_str);
+            print_info("URL: %s\n", row->remote_url);
+            print_info("Deletion URL: %s\n\n", row->deletion_url);
+
+            /* The row borrows from the cursor, which must close before the record is deleted. */
+            char *deletion_url = strdup(row->deletion_url);
+            char *filename = row->filename ? strdup(row->filename) : NULL;
+            db_cursor_close(cursor);
+            if (!deletion_url)
             {
-                print_error("Error reading response\n");
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
+                print_error("Error: Out of memory\n");
+                free(filename);
                 return EXIT_FAILURE;
             }
 
-            if (response[0] != 'y' && response[0] != 'Y')
+            if (!confirmed(args, "Are you sure you want to delete this file from the remote host?"))
             {
                 print_info("Delete operation cancelled.\n");
-                if (records)
-                    db_free_records(records, count);
+                free(filename);
                 free(deletion_url);
                 return EXIT_SUCCESS;
             }
 
-            CURL *curl;
-            CURLcode res;
-
-            curl = curl_easy_init();
-            if (!curl)
-            {
-                print_error("Error: Failed to initialize cURL\n");
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
-                return EXIT_NETWORK_ERROR;
-            }
-
             print_info("Sending deletion request...\n");
 
-            curl_easy_setopt(curl, CURLOPT_URL, deletion_url);
-            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-            res = curl_easy_perform(curl);
+            long http_code = 0;
+            char *delete_error = NULL;
+            bool success = network_delete_file(deletion_url, &http_code, &delete_error);
 
-            if (res != CURLE_OK)
+            if (output_json())
             {
-                print_error("Error: %s\n", curl_easy_strerror(res));
-                curl_easy_cleanup(curl);
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
-                return EXIT_NETWORK_ERROR;
+                emit_delete(args->upload_id, filename, success, http_code, delete_error);
             }
-
-            long http_code = 0;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-
-            curl_easy_cleanup(curl);
-            free(deletion_url);
-
-            bool success = (http_code >= 200 && http_code < 300);
-
-            if (success)
+            else if (success)
             {
                 print_success("File deleted successfully from the remote host!\n");
-
-                char confirm[10];
-                printf("Do you want to remove the record from the local database too? [y/N]: ");
-                if (fgets(confirm, sizeof(confirm), stdin) != NULL &&
-                    (confirm[0] == 'y' || confirm[0] == 'Y'))
-                {
-                    if (db_delete_upload(args->upload_id))
-                    {
-                        print_success("Upload record deleted from local database.\n");
-                    }
-                    else
-                    {
-                        print_error("Failed to delete upload record from local database.\n");
-                    }
-                }
+            }
+            else if (http_code == 0)
+            {
+                print_error("Error: %s\n", delete_error ? delete_error : "Deletion request failed");
             }
             else
             {
@@ -1113,11 +3080,26 @@ execute_command(command_args_t *args)
                 print_info("The file server might require a specific request method or additional "
                            "parameters.\n");
                 print_info("You can try visiting the deletion URL in your browser: %s\n",
-                           record->deletion_url);
+                           deletion_url);
+            }
+
+            /* With --yes the record goes too, as bulk deletes do. */
+            if (success &&
+                confirmed(args, "Do you want to remove the record from the local database too?"))
+            {
+                if (db_delete_upload(args->upload_id))
+                {
+                    print_success("Upload record deleted from local database.\n");
+                }
+                else
+                {
+                    print_error("Failed to delete upload record from local database.\n");
+                }
             }
 
-            if (records)
-                db_free_records(records, count);
+            free(delete_error);
+            free(filename);
+            free(deletion_url);
             return success ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
         }
 
@@ -1139,7 +3121,7 @@ run_setup_wizard(void)
     print_info("This appears to be your first time running the application.\n");
     print_info("Let's set up your initial configuration.\n\n");
 
-    char *config_dir = get_config_dir();
+    const char *config_dir = get_config_dir();
     if (!config_dir)
     {
         print_error("Error: Failed to determine config directory.\n");
@@ -1152,13 +3134,11 @@ run_setup_wizard(void)
         if (mkdir(config_dir, 0755) != 0)
         {
             print_error("Error: Failed to create configuration directory.\n");
-            free(config_dir);
             return EXIT_FAILURE;
         }
     }
-    free(config_dir);
 
-    char *cache_dir = get_cache_dir();
+    const char *cache_dir = get_cache_dir();
     if (!cache_dir)
     {
         print_error("Error: Failed to determine cache directory.\n");
@@ -1171,7 +3151,6 @@ run_setup_wizard(void)
         if (mkdir(cache_dir, 0755) != 0)
         {
             print_error("Error: Failed to create cache directory.\n");
-            free(cache_dir);
             return EXIT_FAILURE;
         }
     }
@@ -1195,13 +3174,12 @@ run_setup_wizard(void)
     if (!config)
     {
         print_error("Error: Failed to allocate memory for configuration.\n");
-        free(cache_dir);
         return EXIT_FAILURE;
     }
 
     config->version = 1;
-    config->log_level = strdup("INFO");
-    config->log_file = strdup(log_file);
+    config->log_level = arena_strdup(&config->arena, "INFO");
+    config->log_file = arena_strdup(&config->arena, log_file);
     config->hosts = NULL;
     config->host_count = 0;
     config->default_host = NULL;
@@ -1210,7 +3188,6 @@ run_setup_wizard(void)
     {
         print_error("Error: Failed to save initial configuration.\n");
         config_free(config);
-        free(cache_dir);
         return EXIT_FAILURE;
     }
 
@@ -1232,7 +3209,6 @@ run_setup_wizard(void)
         print_info("Use 'hostman add-host' to add a host when ready.\n");
     }
 
-    free(cache_dir);
     return result;
 }
 
@@ -1243,8 +3219,15 @@ free_command_args(command_args_t *args)
     {
         free(args->host_name);
         free(args->file_path);
+        for (int i = 0; i < args->file_count; i++)
+        {
+            free(args->file_paths[i]);
+        }
+        free(args->file_paths);
+        free(args->upload_ids);
         free(args->config_key);
         free(args->config_value);
         free(args->command_name);
+        free(args->format);
     }
 }
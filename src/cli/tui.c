@@ -0,0 +1,897 @@
+#include "hostman/cli/tui.h"
+#include "hostman/core/arena.h"
+#include "hostman/core/clipboard.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include "hostman/network/network.h"
+#include "hostman/storage/database.h"
+#include "hostman/storage/page.h"
+#include <curses.h>
+#include <locale.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TUI_SEARCH_MAX 128
+#define TUI_HEADER_LINES 2
+#define TUI_FOOTER_LINES 2
+#define TUI_KEY_ESCAPE 27
+
+/* Orders search results can be shown in; the first keeps the ranking. */
+static const struct
+{
+    const char *label;
+    history_sort_t key;
+    bool descending;
+} sort_orders[] = {
+    { "best match", HISTORY_SORT_DATE, false }, { "newest", HISTORY_SORT_DATE, true },
+    { "largest", HISTORY_SORT_SIZE, true },     { "slowest", HISTORY_SORT_LATENCY, true },
+    { "host", HISTORY_SORT_HOST, false },       { "file name", HISTORY_SORT_FILENAME, false },
+};
+
+/*
+ * The browser only holds the rows around the screen. below starts at the anchor row and runs
+ * towards older uploads; above holds the rows newer than the anchor, nearest first. Row i of
+ * the loaded range counts from the newest loaded row, across both pages. Search results are
+ * all in below and shown through rows, which narrows and reorders them without a query.
+ */
+typedef struct
+{
+    const char *host_name;
+    history_page_t above;
+    history_page_t below;
+    bool at_start;
+    bool at_end;
+    int top;
+    int cursor;
+    int visible;
+
+    char search[TUI_SEARCH_MAX];
+    bool editing_search;
+    bool search_pending;
+    bool showing_results;
+    char results_search[TUI_SEARCH_MAX];
+    int *rows;
+    int row_count;
+    int sort;
+
+    int *selected;
+    int selected_count;
+    int selected_capacity;
+
+    char status[256];
+} tui_t;
+
+typedef struct
+{
+    upload_record_t *records;
+    int total;
+    int completed;
+    int *deleted_ids;
+    int deleted_count;
+} tui_delete_context_t;
+
+static int
+loaded_rows(const tui_t *tui)
+{
+    return tui->showing_results ? tui->row_count : tui->above.count + tui->below.count;
+}
+
+static const history_page_t *
+row_at(const tui_t *tui, int i, int *row)
+{
+    if (tui->showing_results)
+    {
+        *row = tui->rows[i];
+        return &tui->below;
+    }
+    if (i < tui->above.count)
+    {
+        *row = tui->above.count - 1 - i;
+        return &tui->above;
+    }
+    *row = i - tui->above.count;
+    return &tui->below;
+}
+
+static db_key_t
+key_at(const tui_t *tui, int i)
+{
+    int row;
+    const history_page_t *page = row_at(tui, i, &row);
+    return (db_key_t){ .timestamp = page->timestamps[row], .id = page->ids[row] };
+}
+
+static void
+set_status(tui_t *tui, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void
+set_status(tui_t *tui, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(tui->status, sizeof(tui->status), format, args);
+    va_end(args);
+}
+
+/* Load the rows around key so that it becomes the first row of below; NULL means the newest. */
+static bool
+load_around(tui_t *tui, const db_key_t *key)
+{
+    int prefetch = tui->visible * TUI_PREFETCH_SCREENS;
+
+    /* Keys are compared strictly, so one past the id makes the anchor itself the first row. */
+    db_key_t inclusive;
+    db_query_t below = {
+        .host_name = tui->host_name,
+        .newest_first = true,
+        .limit = tui->visible + prefetch,
+    };
+    if (key)
+    {
+        inclusive = (db_key_t){ .timestamp = key->timestamp, .id = key->id + 1 };
+        below.after = &inclusive;
+    }
+    tui->showing_results = false;
+    if (!history_page_load(&tui->below, &below))
+    {
+        return false;
+    }
+    tui->at_end = tui->below.count < below.limit;
+
+    history_page_clear(&tui->above);
+    tui->at_start = true;
+    if (key)
+    {
+        db_query_t above = {
+            .host_name = tui->host_name,
+            .newest_first = true,
+            .after = key,
+            .backwards = true,
+            .limit = prefetch,
+        };
+        if (!history_page_load(&tui->above, &above))
+        {
+            return false;
+        }
+        tui->at_start = tui->above.count < prefetch;
+    }
+    return true;
+}
+
+static bool
+load_oldest(tui_t *tui)
+{
+    db_query_t above = {
+        .host_name = tui->host_name,
+        .newest_first = true,
+        .backwards = true,
+        .limit = tui->visible * (TUI_PREFETCH_SCREENS + 1),
+    };
+    tui->showing_results = false;
+    history_page_clear(&tui->below);
+    if (!history_page_load(&tui->above, &above))
+    {
+        return false;
+    }
+    tui->at_start = tui->above.count < above.limit;
+    tui->at_end = true;
+    return true;
+}
+
+/* Show the loaded results that contain text (all of them for NULL), in the chosen order. */
+static void
+arrange_results(tui_t *tui, const char *text)
+{
+    tui->row_count = history_page_filter(&tui->below, NULL, text, tui->rows);
+    if (tui->sort > 0)
+    {
+        history_page_sort(&tui->below,
+                          sort_orders[tui->sort].key,
+                          sort_orders[tui->sort].descending,
+                          tui->rows,
+                          tui->row_count);
+    }
+    tui->top = 0;
+    tui->cursor = 0;
+}
+
+/* Search results are ranked rather than dated, so the best matches are loaded in one go. */
+static bool
+load_search(tui_t *tui)
+{
+    db_query_t query = {
+        .host_name = tui->host_name,
+        .search = tui->search,
+        .limit = TUI_SEARCH_LIMIT,
+    };
+    if (!tui->rows && !(tui->rows = malloc(sizeof(int) * TUI_SEARCH_LIMIT)))
+    {
+        return false;
+    }
+
+    tui->showing_results = false;
+    history_page_clear(&tui->above);
+    if (!history_page_load(&tui->below, &query))
+    {
+        return false;
+    }
+    tui->at_start = true;
+    tui->at_end = true;
+    tui->showing_results = true;
+    snprintf(tui->results_search, sizeof(tui->results_search), "%s", tui->search);
+    arrange_results(tui, NULL);
+    return true;
+}
+
+static void
+reload_failed(tui_t *tui)
+{
+    tui->showing_results = false;
+    history_page_clear(&tui->above);
+    history_page_clear(&tui->below);
+    tui->top = 0;
+    tui->cursor = 0;
+    set_status(tui, "Failed to read the upload history, see the log for details");
+}
+
+static void
+go_to_start(tui_t *tui)
+{
+    if (!load_around(tui, NULL))
+    {
+        reload_failed(tui);
+        return;
+    }
+    tui->top = 0;
+    tui->cursor = 0;
+}
+
+static void
+go_to_end(tui_t *tui)
+{
+    if (!load_oldest(tui))
+    {
+        reload_failed(tui);
+        return;
+    }
+    int count = loaded_rows(tui);
+    tui->top = count > tui->visible ? count - tui->visible : 0;
+    tui->cursor = count > 0 ? count - 1 : 0;
+}
+
+/* Reload around the top row of the screen, keeping the cursor on the same line. */
+static void
+recentre(tui_t *tui)
+{
+    if (tui->search[0])
+    {
+        if (!load_search(tui))
+            reload_failed(tui);
+        return;
+    }
+    if (loaded_rows(tui) == 0)
+    {
+        go_to_start(tui);
+        return;
+    }
+
+    db_key_t key = key_at(tui, tui->top < loaded_rows(tui) ? tui->top : loaded_rows(tui) - 1);
+    int offset = tui->cursor - tui->top;
+    if (!load_around(tui, &key))
+    {
+        reload_failed(tui);
+        return;
+    }
+
+    tui->top = tui->above.count;
+    int count = loaded_rows(tui);
+    tui->cursor = tui->top + offset < count ? tui->top + offset : count - 1;
+    if (tui->cursor < 0)
+    {
+        tui->cursor = 0;
+    }
+}
+
+static void
+move_cursor(tui_t *tui, int delta)
+{
+    int count = loaded_rows(tui);
+    if (count == 0)
+    {
+        return;
+    }
+
+    int target = tui->cursor + delta;
+    tui->cursor = target < 0 ? 0 : target >= count ? count - 1 : target;
+    if (tui->cursor < tui->top)
+    {
+        tui->top = tui->cursor;
+    }
+    else if (tui->cursor >= tui->top + tui->visible)
+    {
+        tui->top = tui->cursor - tui->visible + 1;
+    }
+
+    /* Fetch the next stretch before the screen reaches the edge of what is loaded. */
+    bool near_start = !tui->at_start && tui->top < tui->visible;
+    bool near_end = !tui->at_end && tui->top + 2 * tui->visible > count;
+    if (near_start || near_end)
+    {
+        recentre(tui);
+    }
+}
+
+static int
+find_selected(const tui_t *tui, int id)
+{
+    for (int i = 0; i < tui->selected_count; i++)
+    {
+        if (tui->selected[i] == id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void
+toggle_selected(tui_t *tui, int id)
+{
+    int index = find_selected(tui, id);
+    if (index >= 0)
+    {
+        tui->selected[index] = tui->selected[--tui->selected_count];
+        return;
+    }
+
+    if (tui->selected_count == tui->selected_capacity)
+    {
+        int capacity = tui->selected_capacity > 0 ? tui->selected_capacity * 2 : 16;
+        int *selected = realloc(tui->selected, sizeof(int) * (size_t)capacity);
+        if (!selected)
+        {
+            set_status(tui, "Out of memory");
+            return;
+        }
+        tui->selected = selected;
+        tui->selected_capacity = capacity;
+    }
+    tui->selected[tui->selected_count++] = id;
+}
+
+static void
+draw_row(const tui_t *tui, int y, int i)
+{
+    int row;
+    const history_page_t *page = row_at(tui, i, &row);
+    int id = (int)page->ids[row];
+    bool selected = find_selected(tui, id) >= 0;
+
+    char date[20];
+    struct tm *tm_info = localtime(&page->timestamps[row]);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M", tm_info);
+
+    char size[16];
+    format_file_size((size_t)page->sizes[row], size, sizeof(size));
+
+    /* Marker, id, date, host and size take 51 columns; the rest is split by name and URL. */
+    int rest = COLS - 51;
+    int name_width = rest > 60 ? 30 : rest > 0 ? rest / 2 : 0;
+    int url_width = rest - name_width - 1 > 0 ? rest - name_width - 1 : 0;
+
+    int attributes = (i == tui->cursor ? A_REVERSE : 0) | (selected ? A_BOLD : 0);
+    attron(attributes);
+    mvprintw(y,
+             0,
+             "%c %8d %-16s %-12.12s %9s %-*.*s %-*.*s",
+             selected ? '*' : ' ',
+             id,
+             date,
+             history_page_str(page, page->host_names[row]),
+             size,
+             name_width,
+             name_width,
+             history_page_str(page, page->filenames[row]),
+             url_width,
+             url_width,
+             history_page_str(page, page->remote_urls[row]));
+    attroff(attributes);
+}
+
+static void
+draw(const tui_t *tui)
+{
+    erase();
+
+    attron(A_BOLD);
+    mvprintw(0, 0, "hostman history");
+    if (tui->host_name)
+        printw(" - %s", tui->host_name);
+    if (tui->search[0] && !tui->editing_search)
+    {
+        printw(" - best matches for '%s'", tui->search);
+        if (tui->sort > 0)
+            printw(" by %s", sort_orders[tui->sort].label);
+    }
+    if (tui->selected_count > 0)
+        printw(" - %d selected", tui->selected_count);
+    mvprintw(1, 0, "  %8s %-16s %-12s %9s %s", "ID", "Date", "Host", "Size", "File / URL");
+    attroff(A_BOLD);
+
+    int count = loaded_rows(tui);
+    for (int line = 0; line < tui->visible && tui->top + line < count; line++)
+    {
+        draw_row(tui, TUI_HEADER_LINES + line, tui->top + line);
+    }
+    if (count == 0)
+    {
+        mvprintw(TUI_HEADER_LINES, 2, "%s", tui->search[0] ? "No matches." : "No uploads yet.");
+    }
+
+    if (tui->editing_search)
+        mvprintw(LINES - 2, 0, "/%s", tui->search);
+    else
+        mvprintw(LINES - 2, 0, "%s", tui->status);
+
+    attron(A_REVERSE);
+    mvprintw(LINES - 1,
+             0,
+             "%-*.*s",
+             COLS,
+             COLS,
+             " q quit  / search  s sort results  space select  c copy URLs  d delete records "
+             " D delete files  g/G first/last");
+    attroff(A_REVERSE);
+
+    if (tui->editing_search)
+    {
+        move(LINES - 2, 1 + (int)strlen(tui->search));
+        curs_set(1);
+    }
+    else
+    {
+        curs_set(0);
+    }
+    refresh();
+}
+
+static bool
+confirm(tui_t *tui, const char *question)
+{
+    set_status(tui, "%s [y/N]", question);
+    draw(tui);
+    timeout(-1);
+    int key = getch();
+    tui->status[0] = '\0';
+    return key == 'y' || key == 'Y';
+}
+
+/* The selection, or the row under the cursor when nothing is selected. */
+static int *
+target_ids(tui_t *tui, int *count, int *single)
+{
+    if (tui->selected_count > 0)
+    {
+        *count = tui->selected_count;
+        return tui->selected;
+    }
+    if (loaded_rows(tui) == 0)
+    {
+        *count = 0;
+        return NULL;
+    }
+
+    int row;
+    const history_page_t *page = row_at(tui, tui->cursor, &row);
+    *single = (int)page->ids[row];
+    *count = 1;
+    return single;
+}
+
+static void
+copy_urls(tui_t *tui)
+{
+    int single;
+    int count;
+    int *ids = target_ids(tui, &count, &single);
+    if (count == 0)
+    {
+        return;
+    }
+
+    /* Selected rows may have scrolled out of the loaded range, so they are read back by id. */
+    db_query_t query = { .ids = ids, .id_count = count, .newest_first = true };
+    db_cursor_t *cursor = db_cursor_open(&query);
+    char *text = NULL;
+    size_t length = 0;
+    int copied = 0;
+    const upload_row_t *row;
+    while ((row = db_cursor_next(cursor)))
+    {
+        size_t url_length = row->remote_url ? strlen(row->remote_url) : 0;
+        if (url_length == 0)
+            continue;
+
+        char *grown = realloc(text, length + url_length + 2);
+        if (!grown)
+            break;
+        text = grown;
+        if (length > 0)
+            text[length++] = '\n';
+        memcpy(text + length, row->remote_url, url_length + 1);
+        length += url_length;
+        copied++;
+    }
+    db_cursor_close(cursor);
+
+    const char *clipboard_manager = get_clipboard_manager_name();
+    if (!text)
+        set_status(tui, "Nothing to copy");
+    else if (clipboard_manager && copy_to_clipboard(text))
+        set_status(tui, "Copied %d URL(s) using %s", copied, clipboard_manager);
+    else
+        set_status(tui, "Could not copy to the clipboard");
+    free(text);
+}
+
+static void
+forget_selected(tui_t *tui, const int *ids, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int index = find_selected(tui, ids[i]);
+        if (index >= 0)
+        {
+            tui->selected[index] = tui->selected[--tui->selected_count];
+        }
+    }
+}
+
+static void
+delete_records(tui_t *tui)
+{
+    int single;
+    int count;
+    int *ids = target_ids(tui, &count, &single);
+    if (count == 0)
+    {
+        return;
+    }
+
+    char question[96];
+    snprintf(question, sizeof(question), "Delete %d record(s) from the history?", count);
+    if (!confirm(tui, question))
+    {
+        set_status(tui, "Delete operation cancelled");
+        return;
+    }
+
+    int deleted = db_delete_uploads(ids, count);
+    if (deleted < 0)
+    {
+        set_status(tui, "Failed to delete the records, see the log for details");
+        return;
+    }
+
+    forget_selected(tui, ids, count);
+    set_status(tui, "Deleted %d record(s)", deleted);
+    recentre(tui);
+}
+
+static void
+on_delete_done(int index, bool success, long http_code, const char *error_message, void *userdata)
+{
+    (void)http_code;
+    (void)error_message;
+
+    tui_delete_context_t *ctx = userdata;
+    ctx->completed++;
+    if (success)
+    {
+        ctx->deleted_ids[ctx->deleted_count++] = ctx->records[index].id;
+    }
+
+    mvprintw(LINES - 2, 0, "Deleting files... %d/%d", ctx->completed, ctx->total);
+    clrtoeol();
+    refresh();
+}
+
+static void
+delete_files(tui_t *tui)
+{
+    int single;
+    int count;
+    int *ids = target_ids(tui, &count, &single);
+    if (count == 0)
+    {
+        return;
+    }
+
+    arena_t arena;
+    arena_init(&arena, 0);
+
+    int target_count = 0;
+    upload_record_t *records = db_get_deletion_targets(&arena, NULL, 0, ids, count, &target_count);
+    if (!records || target_count == 0)
+    {
+        set_status(tui, "No deletion URL for the selected upload(s)");
+        arena_destroy(&arena);
+        return;
+    }
+
+    char question[128];
+    snprintf(question,
+             sizeof(question),
+             "Delete %d file(s) from their hosts and the history?",
+             target_count);
+    if (!confirm(tui, question))
+    {
+        set_status(tui, "Delete operation cancelled");
+        arena_destroy(&arena);
+        return;
+    }
+
+    char **urls = arena_alloc(&arena, target_count * sizeof(char *));
+    int *deleted_ids = arena_alloc(&arena, target_count * sizeof(int));
+    if (!urls || !deleted_ids)
+    {
+        set_status(tui, "Out of memory");
+        arena_destroy(&arena);
+        return;
+    }
+    for (int i = 0; i < target_count; i++)
+    {
+        urls[i] = records[i].deletion_url;
+    }
+
+    tui_delete_context_t ctx = { .records = records,
+                                 .total = target_count,
+                                 .deleted_ids = deleted_ids };
+    network_delete_batch(
+      urls, target_count, DEFAULT_DELETE_HOST_CONNECTIONS, on_delete_done, &ctx);
+
+    if (ctx.deleted_count > 0 && db_delete_uploads(deleted_ids, ctx.deleted_count) < 0)
+    {
+        set_status(tui, "Files were deleted remotely but their records could not be removed");
+    }
+    else if (ctx.deleted_count < target_count)
+    {
+        set_status(tui,
+                   "%d of %d file(s) could not be deleted; their records were kept",
+                   target_count - ctx.deleted_count,
+                   target_count);
+    }
+    else
+    {
+        set_status(tui, "Deleted %d file(s)", target_count);
+    }
+
+    forget_selected(tui, deleted_ids, ctx.deleted_count);
+    arena_destroy(&arena);
+    recentre(tui);
+}
+
+/* A key typed at the search prompt. Enter keeps the results, Escape drops the search. */
+static void
+edit_search(tui_t *tui, int key)
+{
+    size_t length = strlen(tui->search);
+
+    if (key == '\n' || key == KEY_ENTER)
+    {
+        tui->editing_search = false;
+        if (tui->search_pending && tui->search[0])
+        {
+            tui->search_pending = false;
+            recentre(tui);
+        }
+        return;
+    }
+    if (key == TUI_KEY_ESCAPE)
+    {
+        tui->editing_search = false;
+        tui->search_pending = false;
+        tui->search[0] = '\0';
+        go_to_start(tui);
+        return;
+    }
+
+    if (key == KEY_BACKSPACE || key == 127 || key == '\b')
+    {
+        if (length == 0)
+            return;
+        tui->search[length - 1] = '\0';
+    }
+    else if (key >= ' ' && key <= 0xff && key != 127 && length + 1 < sizeof(tui->search))
+    {
+        tui->search[length] = (char)key;
+        tui->search[length + 1] = '\0';
+    }
+    else
+    {
+        return;
+    }
+
+    /*
+     * An empty query goes straight back to the full history; anything else waits for a pause.
+     * A single word that extends the shown results' query narrows them straight away meanwhile.
+     */
+    if (tui->search[0])
+    {
+        tui->search_pending = true;
+        size_t results_length = strlen(tui->results_search);
+        if (tui->showing_results && results_length > 0 && !strchr(tui->search, ' ') &&
+            strncmp(tui->search, tui->results_search, results_length) == 0)
+        {
+            arrange_results(tui, tui->search);
+        }
+    }
+    else
+    {
+        tui->search_pending = false;
+        go_to_start(tui);
+    }
+}
+
+static bool
+handle_key(tui_t *tui, int key)
+{
+    switch (key)
+    {
+        case 'q':
+            return false;
+        case KEY_DOWN:
+        case 'j':
+            move_cursor(tui, 1);
+            break;
+        case KEY_UP:
+        case 'k':
+            move_cursor(tui, -1);
+            break;
+        case KEY_NPAGE:
+            move_cursor(tui, tui->visible);
+            break;
+        case KEY_PPAGE:
+            move_cursor(tui, -tui->visible);
+            break;
+        case KEY_HOME:
+        case 'g':
+            if (tui->search[0])
+                move_cursor(tui, -loaded_rows(tui));
+            else
+                go_to_start(tui);
+            break;
+        case KEY_END:
+        case 'G':
+            if (tui->search[0])
+                move_cursor(tui, loaded_rows(tui));
+            else
+                go_to_end(tui);
+            break;
+        case ' ':
+            if (loaded_rows(tui) > 0)
+            {
+                int row;
+                const history_page_t *page = row_at(tui, tui->cursor, &row);
+                toggle_selected(tui, (int)page->ids[row]);
+                move_cursor(tui, 1);
+            }
+            break;
+        case '/':
+            tui->editing_search = true;
+            tui->search[0] = '\0';
+            break;
+        case 's':
+            if (!tui->showing_results)
+            {
+                set_status(tui, "Only search results can be sorted; press / to search");
+                break;
+            }
+            tui->sort = (tui->sort + 1) % (int)(sizeof(sort_orders) / sizeof(sort_orders[0]));
+            arrange_results(tui, NULL);
+            set_status(tui, "Sorted by %s", sort_orders[tui->sort].label);
+            break;
+        case '\n':
+        case KEY_ENTER:
+        case 'c':
+            copy_urls(tui);
+            break;
+        case 'd':
+            delete_records(tui);
+            break;
+        case 'D':
+            delete_files(tui);
+            break;
+        case TUI_KEY_ESCAPE:
+            if (tui->selected_count > 0)
+            {
+                tui->selected_count = 0;
+            }
+            else if (tui->search[0])
+            {
+                tui->search[0] = '\0';
+                go_to_start(tui);
+            }
+            break;
+        case KEY_RESIZE:
+            tui->visible = LINES - TUI_HEADER_LINES - TUI_FOOTER_LINES;
+            if (tui->visible < 1)
+                tui->visible = 1;
+            recentre(tui);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/*
+ * Browse the upload history in a full-screen table. Only the rows on screen plus a few screens
+ * either side are held in memory; scrolling past them reads the next stretch through a keyset
+ * query, so large histories open and scroll as quickly as small ones.
+ */
+bool
+tui_run(const char *host_name)
+{
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+    {
+        log_error("The history browser needs a terminal");
+        return false;
+    }
+
+    setlocale(LC_ALL, "");
+    if (!initscr())
+    {
+        log_error("Failed to initialise the terminal");
+        return false;
+    }
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    set_escdelay(25);
+    logging_set_console_errors(false);
+
+    tui_t tui = { .host_name = host_name };
+    tui.visible = LINES - TUI_HEADER_LINES - TUI_FOOTER_LINES;
+    if (tui.visible < 1)
+        tui.visible = 1;
+    go_to_start(&tui);
+
+    bool running = true;
+    while (running)
+    {
+        draw(&tui);
+
+        /* While a query is being typed, searching waits until the keys pause. */
+        timeout(tui.search_pending ? TUI_SEARCH_DEBOUNCE_MS : -1);
+        int key = getch();
+        if (key == ERR)
+        {
+            if (tui.search_pending)
+            {
+                tui.search_pending = false;
+                recentre(&tui);
+            }
+            continue;
+        }
+
+        tui.status[0] = '\0';
+        if (tui.editing_search && key != KEY_RESIZE)
+            edit_search(&tui, key);
+        else
+            running = handle_key(&tui, key);
+    }
+
+    endwin();
+    logging_set_console_errors(true);
+
+    history_page_free(&tui.above);
+    history_page_free(&tui.below);
+    free(tui.rows);
+    free(tui.selected);
+    return true;
+}
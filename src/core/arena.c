@@ -0,0 +1,131 @@
+#include "hostman/core/arena.h"
+#include "hostman/core/logging.h"
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_chunk
+{
+    arena_chunk_t *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+#define ARENA_ALIGN(size) (((size) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+void
+arena_init(arena_t *arena, size_t chunk_size)
+{
+    arena->chunks = NULL;
+    arena->chunk_size = chunk_size;
+}
+
+void *
+arena_alloc(arena_t *arena, size_t size)
+{
+    if (size > SIZE_MAX / 2)
+    {
+        return NULL;
+    }
+    size = ARENA_ALIGN(size ? size : 1);
+
+    arena_chunk_t *chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        /* Allocations larger than a chunk get one of their own. */
+        size_t chunk_size = arena->chunk_size ? arena->chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+        if (chunk_size < size)
+        {
+            chunk_size = size;
+        }
+
+        chunk = malloc(sizeof(arena_chunk_t) + chunk_size);
+        if (!chunk)
+        {
+            log_error("Failed to allocate %zu bytes of arena memory", chunk_size);
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+
+    void *memory = chunk->data + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+void *
+arena_calloc(arena_t *arena, size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+
+    void *memory = arena_alloc(arena, count * size);
+    if (memory)
+    {
+        memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+/* Like strdup; NULL is passed through so optional fields can be copied unconditionally. */
+char *
+arena_strdup(arena_t *arena, const char *text)
+{
+    if (!text)
+    {
+        return NULL;
+    }
+
+    size_t length = strlen(text) + 1;
+    char *copy = arena_alloc(arena, length);
+    if (copy)
+    {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
+
+char *
+arena_sprintf(arena_t *arena, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        return NULL;
+    }
+
+    char *text = arena_alloc(arena, (size_t)length + 1);
+    if (text)
+    {
+        va_start(args, format);
+        vsnprintf(text, (size_t)length + 1, format, args);
+        va_end(args);
+    }
+    return text;
+}
+
+void
+arena_destroy(arena_t *arena)
+{
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk)
+    {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
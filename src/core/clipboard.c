@@ -0,0 +1,345 @@
+/* For pipe2(). */
+#define _GNU_SOURCE
+
+#include "hostman/core/clipboard.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+typedef struct
+{
+    const char *name;
+    const char *args[3];
+} clipboard_tool_t;
+
+/* In order of preference. */
+static const clipboard_tool_t tools[] = {
+    { "wl-copy", { NULL } },                          // Wayland
+    { "xclip", { "-selection", "clipboard", NULL } }, // X11
+    { "xsel", { "-ib", NULL } },                      // X11 alternative
+    { "pbcopy", { NULL } },                           // macOS
+    { "clip.exe", { NULL } },                         // Windows (i think wsl too)
+    { "fish_clipboard_copy", { NULL } },              // Fish shell (im desperate)
+};
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static const clipboard_tool_t *tool = NULL;
+static char *tool_path = NULL;
+
+/* Tools started by earlier copies that have not been reaped yet. */
+static pid_t *spawned = NULL;
+static int spawned_count = 0;
+static int spawned_capacity = 0;
+
+static const clipboard_tool_t *
+tool_for_path(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++)
+    {
+        if (strcmp(tools[i].name, name) == 0)
+        {
+            return &tools[i];
+        }
+    }
+    return NULL;
+}
+
+/* The first tool, by preference, that is executable somewhere on search_path. */
+static char *
+scan_path(const char *search_path)
+{
+    for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++)
+    {
+        const char *dir = search_path;
+        while (dir)
+        {
+            const char *end = strchr(dir, ':');
+            size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+
+            /* An empty PATH entry means the current directory. */
+            char candidate[4096];
+            int len = dir_len == 0
+                        ? snprintf(candidate, sizeof(candidate), "./%s", tools[i].name)
+                        : snprintf(candidate,
+                                   sizeof(candidate),
+                                   "%.*s/%s",
+                                   (int)dir_len,
+                                   dir,
+                                   tools[i].name);
+            if (len > 0 && (size_t)len < sizeof(candidate) && access(candidate, X_OK) == 0)
+            {
+                return strdup(candidate);
+            }
+
+            dir = end ? end + 1 : NULL;
+        }
+    }
+    return NULL;
+}
+
+static char *
+strip_newline(char *line, ssize_t len)
+{
+    if (len > 0 && line[len - 1] == '\n')
+    {
+        line[len - 1] = '\0';
+    }
+    return line;
+}
+
+/* The cache holds the PATH it was found with and the tool; either changing invalidates it. */
+static bool
+read_cache(const char *cache_path, const char *search_path)
+{
+    FILE *file = fopen(cache_path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    bool valid = false;
+
+    ssize_t len = getline(&line, &capacity, file);
+    if (len > 0 && strcmp(strip_newline(line, len), search_path) == 0)
+    {
+        len = getline(&line, &capacity, file);
+        if (len > 0)
+        {
+            strip_newline(line, len);
+            const clipboard_tool_t *cached = tool_for_path(line);
+            if (cached && access(line, X_OK) == 0)
+            {
+                tool = cached;
+                tool_path = line;
+                line = NULL;
+                valid = true;
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return valid;
+}
+
+static void
+write_cache(const char *cache_path, const char *search_path)
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+
+    FILE *file = fopen(tmp_path, "w");
+    if (!file)
+    {
+        log_debug("Cannot write clipboard cache %s", tmp_path);
+        return;
+    }
+
+    bool ok = fprintf(file, "%s\n%s\n", search_path, tool_path) > 0;
+    if (fclose(file) != 0 || !ok || rename(tmp_path, cache_path) != 0)
+    {
+        log_debug("Cannot write clipboard cache %s", cache_path);
+        unlink(tmp_path);
+    }
+}
+
+/* Only a tool that was found is cached, so installing one later is still noticed. */
+static void
+detect_clipboard_manager(void)
+{
+    const char *search_path = getenv("PATH");
+    if (!search_path || !*search_path)
+    {
+        search_path = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    char cache_path[4096] = { 0 };
+    const char *cache_dir = get_cache_dir();
+    if (cache_dir)
+    {
+        snprintf(cache_path, sizeof(cache_path), "%s/%s", cache_dir, CLIPBOARD_CACHE_FILE);
+        if (read_cache(cache_path, search_path))
+        {
+            return;
+        }
+    }
+
+    tool_path = scan_path(search_path);
+    if (!tool_path)
+    {
+        return;
+    }
+
+    tool = tool_for_path(tool_path);
+    if (cache_dir)
+    {
+        write_cache(cache_path, search_path);
+    }
+}
+
+const char *
+get_clipboard_manager_name(void)
+{
+    pthread_once(&detect_once, detect_clipboard_manager);
+    return tool ? tool->name : NULL;
+}
+
+/*
+ * Copies are not waited for, so a long-running command such as watch reaps the tools of earlier
+ * copies here; a short one just exits and leaves them to init.
+ */
+static void
+reap_finished_tools(void)
+{
+    int kept = 0;
+    for (int i = 0; i < spawned_count; i++)
+    {
+        int status = 0;
+        pid_t result = waitpid(spawned[i], &status, WNOHANG);
+        if (result == 0)
+        {
+            spawned[kept++] = spawned[i];
+        }
+        else if (result > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+        {
+            log_warn("%s failed to copy to the clipboard", tool->name);
+        }
+    }
+    spawned_count = kept;
+}
+
+static void
+remember_tool(pid_t pid)
+{
+    if (spawned_count == spawned_capacity)
+    {
+        int capacity = spawned_capacity ? spawned_capacity * 2 : 4;
+        pid_t *grown = realloc(spawned, capacity * sizeof(pid_t));
+        if (!grown)
+        {
+            return;
+        }
+        spawned = grown;
+        spawned_capacity = capacity;
+    }
+    spawned[spawned_count++] = pid;
+}
+
+/*
+ * A URL fits in the empty pipe, so this returns without waiting for the tool to read it. A tool
+ * that exits without reading must not take the process down with SIGPIPE.
+ */
+static bool
+write_text(int fd, const char *text)
+{
+    sigset_t pipe_signal;
+    sigset_t previous;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, &previous);
+
+    size_t length = strlen(text);
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t result = write(fd, text + written, length - written);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        written += (size_t)result;
+    }
+
+    if (written < length && errno == EPIPE)
+    {
+        const struct timespec no_wait = { 0, 0 };
+        sigtimedwait(&pipe_signal, NULL, &no_wait);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    return written == length;
+}
+
+/* The tool reads the text on stdin; its output goes to /dev/null so it never holds our pipes. */
+static bool
+spawn_tool(int input_fd, pid_t *pid)
+{
+    char *argv[5] = { (char *)tool->name };
+    for (int i = 0; tool->args[i]; i++)
+    {
+        argv[i + 1] = (char *)tool->args[i];
+    }
+
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0)
+    {
+        return false;
+    }
+    posix_spawn_file_actions_adddup2(&actions, input_fd, STDIN_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    int result = posix_spawn(pid, tool_path, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0)
+    {
+        log_warn("Failed to start %s: %s", tool_path, strerror(result));
+        return false;
+    }
+    return true;
+}
+
+bool
+copy_to_clipboard(const char *text)
+{
+    if (!text || !get_clipboard_manager_name())
+    {
+        return false;
+    }
+
+    reap_finished_tools();
+
+    /* Other tools spawned meanwhile must not inherit the pipe, or it would never see EOF. */
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        log_error("Failed to prepare clipboard copy: %s", strerror(errno));
+        return false;
+    }
+
+    pid_t pid;
+    bool spawned_tool = spawn_tool(fds[0], &pid);
+    close(fds[0]);
+    if (!spawned_tool)
+    {
+        close(fds[1]);
+        return false;
+    }
+
+    bool written = write_text(fds[1], text);
+    close(fds[1]);
+    remember_tool(pid);
+
+    if (!written)
+    {
+        log_warn("%s failed to copy to the clipboard", tool->name);
+    }
+    return written;
+}
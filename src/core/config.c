@@ -2,6 +2,7 @@
 #include "hostman/core/logging.h"
 #include "hostman/core/utils.h"
 #include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,10 +17,172 @@
 
 static hostman_config_t *current_config = NULL;
 
+static const struct
+{
+    const char *key;
+    size_t offset;
+} timeout_fields[] = {
+    { "connect", offsetof(timeout_config_t, connect_seconds) },
+    { "tls", offsetof(timeout_config_t, tls_seconds) },
+    { "total", offsetof(timeout_config_t, total_seconds) },
+    { "total_per_mb", offsetof(timeout_config_t, total_per_mb_seconds) },
+    { "low_speed_limit", offsetof(timeout_config_t, low_speed_limit) },
+    { "low_speed_time", offsetof(timeout_config_t, low_speed_seconds) },
+    { "stall", offsetof(timeout_config_t, stall_seconds) },
+};
+
+#define TIMEOUT_FIELD_COUNT (sizeof(timeout_fields) / sizeof(timeout_fields[0]))
+
+static long *
+timeout_field(timeout_config_t *timeouts, const char *key)
+{
+    for (size_t i = 0; i < TIMEOUT_FIELD_COUNT; i++)
+    {
+        if (strcmp(timeout_fields[i].key, key) == 0)
+        {
+            return (long *)((char *)timeouts + timeout_fields[i].offset);
+        }
+    }
+    return NULL;
+}
+
+static const struct
+{
+    const char *key;
+    size_t offset;
+} retention_fields[] = {
+    { "max_age_days", offsetof(retention_config_t, max_age_days) },
+    { "max_rows", offsetof(retention_config_t, max_rows) },
+};
+
+#define RETENTION_FIELD_COUNT (sizeof(retention_fields) / sizeof(retention_fields[0]))
+
+static long *
+retention_field(retention_config_t *retention, const char *key)
+{
+    for (size_t i = 0; i < RETENTION_FIELD_COUNT; i++)
+    {
+        if (strcmp(retention_fields[i].key, key) == 0)
+        {
+            return (long *)((char *)retention + retention_fields[i].offset);
+        }
+    }
+    return NULL;
+}
+
+/* Shared by the global "retention" key and hosts.<name>.retention.<key>. */
+static bool
+set_retention_value(retention_config_t *retention, const char *key, const char *value)
+{
+    long *field = retention_field(retention, key);
+    char *end = NULL;
+    long number = strtol(value, &end, 10);
+    if (!field)
+    {
+        log_error("Unknown retention setting: %s", key);
+        return false;
+    }
+    if (end == value || *end != '\0' || number < 0)
+    {
+        log_error("Invalid retention value: %s", value);
+        return false;
+    }
+    *field = number;
+    return true;
+}
+
+/* log_levels.<subsystem>; an empty value removes the override. */
+static bool
+set_log_level_override(hostman_config_t *config, const char *name, const char *value)
+{
+    log_subsystem_t subsystem;
+    log_level_t level;
+    if (!log_subsystem_from_string(name, &subsystem))
+    {
+        log_error("Unknown log subsystem: %s", name);
+        return false;
+    }
+    if (*value && !log_level_from_string(value, &level))
+    {
+        log_error("Invalid log level: %s", value);
+        return false;
+    }
+    config->log_levels[subsystem] = *value ? arena_strdup(&config->arena, value) : NULL;
+    return true;
+}
+
+static char *
+default_log_file(arena_t *arena)
+{
+    const char *cache_dir = get_cache_dir();
+    return cache_dir ? arena_sprintf(arena, "%s/hostman.log", cache_dir) : NULL;
+}
+
+static hostman_config_t *
+config_new(void)
+{
+    hostman_config_t *config = calloc(1, sizeof(hostman_config_t));
+    if (!config)
+    {
+        return NULL;
+    }
+
+    config->version = 1;
+    config->log_level = arena_strdup(&config->arena, "INFO");
+    config->log_file = default_log_file(&config->arena);
+    return config;
+}
+
+/* Deep copy of a host built outside the config, e.g. by the add-host wizard. */
+static host_config_t *
+copy_host(arena_t *arena, const host_config_t *host)
+{
+    host_config_t *copy = arena_alloc(arena, sizeof(host_config_t));
+    if (!copy)
+    {
+        return NULL;
+    }
+
+    *copy = *host;
+    copy->name = arena_strdup(arena, host->name);
+    copy->api_endpoint = arena_strdup(arena, host->api_endpoint);
+    copy->auth_type = arena_strdup(arena, host->auth_type);
+    copy->api_key_name = arena_strdup(arena, host->api_key_name);
+    copy->api_key_encrypted = arena_strdup(arena, host->api_key_encrypted);
+    copy->request_body_format = arena_strdup(arena, host->request_body_format);
+    copy->file_form_field = arena_strdup(arena, host->file_form_field);
+    copy->response_url_json_path = arena_strdup(arena, host->response_url_json_path);
+    copy->response_deletion_url_json_path =
+      arena_strdup(arena, host->response_deletion_url_json_path);
+    copy->fallback_host = arena_strdup(arena, host->fallback_host);
+    copy->http_version = arena_strdup(arena, host->http_version);
+    copy->optimize_images = arena_strdup(arena, host->optimize_images);
+    copy->compress = arena_strdup(arena, host->compress);
+    copy->compress_as = arena_strdup(arena, host->compress_as);
+
+    if (host->static_field_count > 0)
+    {
+        copy->static_field_names = arena_calloc(arena, host->static_field_count, sizeof(char *));
+        copy->static_field_values = arena_calloc(arena, host->static_field_count, sizeof(char *));
+        if (!copy->static_field_names || !copy->static_field_values)
+        {
+            return NULL;
+        }
+
+        for (int i = 0; i < host->static_field_count; i++)
+        {
+            copy->static_field_names[i] = arena_strdup(arena, host->static_field_names[i]);
+            copy->static_field_values[i] = arena_strdup(arena, host->static_field_values[i]);
+        }
+    }
+
+    return copy;
+}
+
 char *
 config_get_path(void)
 {
-    char *config_dir = get_config_dir();
+    const char *config_dir = get_config_dir();
     if (!config_dir)
     {
         return NULL;
@@ -29,68 +192,143 @@ config_get_path(void)
     char *path = malloc(len);
     if (!path)
     {
-        free(config_dir);
         return NULL;
     }
 
     snprintf(path, len, "%s/config.json", config_dir);
-    free(config_dir);
 
     return path;
 }
 
 #ifdef USE_CJSON
+static void
+parse_retention(cJSON *json, retention_config_t *retention)
+{
+    if (!json || !cJSON_IsObject(json))
+    {
+        return;
+    }
+    for (size_t i = 0; i < RETENTION_FIELD_COUNT; i++)
+    {
+        cJSON *item = cJSON_GetObjectItem(json, retention_fields[i].key);
+        if (item && cJSON_IsNumber(item) && item->valuedouble >= 0)
+        {
+            *retention_field(retention, retention_fields[i].key) = (long)item->valuedouble;
+        }
+    }
+}
+
+static void
+parse_log_levels(arena_t *arena, cJSON *json, char **log_levels)
+{
+    if (!json || !cJSON_IsObject(json))
+    {
+        return;
+    }
+    for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+    {
+        cJSON *item = cJSON_GetObjectItem(json, log_subsystem_to_string(i));
+        if (item && cJSON_IsString(item))
+        {
+            log_levels[i] = arena_strdup(arena, item->valuestring);
+        }
+    }
+}
+
+static void
+add_log_levels(cJSON *json, char **log_levels)
+{
+    cJSON *object = NULL;
+    for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+    {
+        if (log_levels[i])
+        {
+            if (!object)
+            {
+                object = cJSON_CreateObject();
+            }
+            cJSON_AddStringToObject(object, log_subsystem_to_string(i), log_levels[i]);
+        }
+    }
+    if (object)
+    {
+        cJSON_AddItemToObject(json, "log_levels", object);
+    }
+}
+
+static void
+add_retention(cJSON *json, retention_config_t *retention)
+{
+    cJSON *object = NULL;
+    for (size_t i = 0; i < RETENTION_FIELD_COUNT; i++)
+    {
+        long value = *retention_field(retention, retention_fields[i].key);
+        if (value > 0)
+        {
+            if (!object)
+            {
+                object = cJSON_CreateObject();
+            }
+            cJSON_AddNumberToObject(object, retention_fields[i].key, value);
+        }
+    }
+    if (object)
+    {
+        cJSON_AddItemToObject(json, "retention", object);
+    }
+}
+
 static host_config_t *
-parse_host_config(cJSON *host_json, const char *name)
+parse_host_config(arena_t *arena, cJSON *host_json, const char *name)
 {
-    host_config_t *host = calloc(1, sizeof(host_config_t));
+    host_config_t *host = arena_calloc(arena, 1, sizeof(host_config_t));
     if (!host)
     {
         return NULL;
     }
 
-    host->name = strdup(name);
+    host->name = arena_strdup(arena, name);
 
     cJSON *api_endpoint = cJSON_GetObjectItem(host_json, "api_endpoint");
     if (api_endpoint && cJSON_IsString(api_endpoint))
     {
-        host->api_endpoint = strdup(api_endpoint->valuestring);
+        host->api_endpoint = arena_strdup(arena, api_endpoint->valuestring);
     }
 
     cJSON *auth_type = cJSON_GetObjectItem(host_json, "auth_type");
     if (auth_type && cJSON_IsString(auth_type))
     {
-        host->auth_type = strdup(auth_type->valuestring);
+        host->auth_type = arena_strdup(arena, auth_type->valuestring);
     }
 
     cJSON *api_key_name = cJSON_GetObjectItem(host_json, "api_key_name");
     if (api_key_name && cJSON_IsString(api_key_name))
     {
-        host->api_key_name = strdup(api_key_name->valuestring);
+        host->api_key_name = arena_strdup(arena, api_key_name->valuestring);
     }
 
     cJSON *api_key_encrypted = cJSON_GetObjectItem(host_json, "api_key_encrypted");
     if (api_key_encrypted && cJSON_IsString(api_key_encrypted))
     {
-        host->api_key_encrypted = strdup(api_key_encrypted->valuestring);
+        host->api_key_encrypted = arena_strdup(arena, api_key_encrypted->valuestring);
     }
 
     cJSON *request_body_format = cJSON_GetObjectItem(host_json, "request_body_format");
     if (request_body_format && cJSON_IsString(request_body_format))
     {
-        host->request_body_format = strdup(request_body_format->valuestring);
+        host->request_body_format = arena_strdup(arena, request_body_format->valuestring);
     }
 
     cJSON *file_form_field = cJSON_GetObjectItem(host_json, "file_form_field");
     if (file_form_field && cJSON_IsString(file_form_field))
     {
-        host->file_form_field = strdup(file_form_field->valuestring);
+        host->file_form_field = arena_strdup(arena, file_form_field->valuestring);
     }
 
     cJSON *response_url_json_path = cJSON_GetObjectItem(host_json, "response_url_json_path");
     if (response_url_json_path && cJSON_IsString(response_url_json_path))
     {
-        host->response_url_json_path = strdup(response_url_json_path->valuestring);
+        host->response_url_json_path = arena_strdup(arena, response_url_json_path->valuestring);
     }
 
     cJSON *response_deletion_url_json_path =
@@ -98,9 +336,54 @@ parse_host_config(cJSON *host_json, const char *name)
     if (response_deletion_url_json_path && cJSON_IsString(response_deletion_url_json_path))
     {
         host->response_deletion_url_json_path =
-          strdup(response_deletion_url_json_path->valuestring);
+          arena_strdup(arena, response_deletion_url_json_path->valuestring);
+    }
+
+    cJSON *fallback_host = cJSON_GetObjectItem(host_json, "fallback_host");
+    if (fallback_host && cJSON_IsString(fallback_host))
+    {
+        host->fallback_host = arena_strdup(arena, fallback_host->valuestring);
+    }
+
+    cJSON *http_version = cJSON_GetObjectItem(host_json, "http_version");
+    if (http_version && cJSON_IsString(http_version))
+    {
+        host->http_version = arena_strdup(arena, http_version->valuestring);
+    }
+
+    cJSON *optimize_images = cJSON_GetObjectItem(host_json, "optimize_images");
+    if (optimize_images && cJSON_IsString(optimize_images))
+    {
+        host->optimize_images = arena_strdup(arena, optimize_images->valuestring);
+    }
+
+    cJSON *compress = cJSON_GetObjectItem(host_json, "compress");
+    if (compress && cJSON_IsString(compress))
+    {
+        host->compress = arena_strdup(arena, compress->valuestring);
     }
 
+    cJSON *compress_as = cJSON_GetObjectItem(host_json, "compress_as");
+    if (compress_as && cJSON_IsString(compress_as))
+    {
+        host->compress_as = arena_strdup(arena, compress_as->valuestring);
+    }
+
+    cJSON *timeouts = cJSON_GetObjectItem(host_json, "timeouts");
+    if (timeouts && cJSON_IsObject(timeouts))
+    {
+        for (size_t i = 0; i < TIMEOUT_FIELD_COUNT; i++)
+        {
+            cJSON *item = cJSON_GetObjectItem(timeouts, timeout_fields[i].key);
+            if (item && cJSON_IsNumber(item) && item->valuedouble >= 0)
+            {
+                *timeout_field(&host->timeouts, timeout_fields[i].key) = (long)item->valuedouble;
+            }
+        }
+    }
+
+    parse_retention(cJSON_GetObjectItem(host_json, "retention"), &host->retention);
+
     cJSON *static_form_fields = cJSON_GetObjectItem(host_json, "static_form_fields");
     if (static_form_fields && cJSON_IsObject(static_form_fields))
     {
@@ -108,13 +391,11 @@ parse_host_config(cJSON *host_json, const char *name)
         if (field_count > 0)
         {
             host->static_field_count = field_count;
-            host->static_field_names = calloc(field_count, sizeof(char *));
-            host->static_field_values = calloc(field_count, sizeof(char *));
+            host->static_field_names = arena_calloc(arena, field_count, sizeof(char *));
+            host->static_field_values = arena_calloc(arena, field_count, sizeof(char *));
 
             if (!host->static_field_names || !host->static_field_values)
             {
-                free(host->static_field_names);
-                free(host->static_field_values);
                 host->static_field_count = 0;
             }
             else
@@ -125,8 +406,8 @@ parse_host_config(cJSON *host_json, const char *name)
                 {
                     if (cJSON_IsString(field))
                     {
-                        host->static_field_names[i] = strdup(field->string);
-                        host->static_field_values[i] = strdup(field->valuestring);
+                        host->static_field_names[i] = arena_strdup(arena, field->string);
+                        host->static_field_values[i] = arena_strdup(arena, field->valuestring);
                         i++;
                     }
                 }
@@ -164,39 +445,46 @@ parse_config(cJSON *json)
     cJSON *default_host = cJSON_GetObjectItem(json, "default_host");
     if (default_host && cJSON_IsString(default_host))
     {
-        config->default_host = strdup(default_host->valuestring);
+        config->default_host = arena_strdup(&config->arena, default_host->valuestring);
     }
 
     cJSON *log_level = cJSON_GetObjectItem(json, "log_level");
     if (log_level && cJSON_IsString(log_level))
     {
-        config->log_level = strdup(log_level->valuestring);
+        config->log_level = arena_strdup(&config->arena, log_level->valuestring);
     }
     else
     {
-        config->log_level = strdup("INFO");
+        config->log_level = arena_strdup(&config->arena, "INFO");
+    }
+
+    parse_log_levels(&config->arena, cJSON_GetObjectItem(json, "log_levels"), config->log_levels);
+
+    cJSON *log_format = cJSON_GetObjectItem(json, "log_format");
+    if (log_format && cJSON_IsString(log_format))
+    {
+        config->log_format = arena_strdup(&config->arena, log_format->valuestring);
     }
 
     cJSON *log_file = cJSON_GetObjectItem(json, "log_file");
     if (log_file && cJSON_IsString(log_file))
     {
-        config->log_file = strdup(log_file->valuestring);
+        config->log_file = arena_strdup(&config->arena, log_file->valuestring);
     }
     else
     {
-        char *cache_dir = get_cache_dir();
-        if (cache_dir)
-        {
-            size_t len = strlen(cache_dir) + strlen("/hostman.log") + 1;
-            config->log_file = malloc(len);
-            if (config->log_file)
-            {
-                snprintf(config->log_file, len, "%s/hostman.log", cache_dir);
-            }
-            free(cache_dir);
-        }
+        config->log_file = default_log_file(&config->arena);
     }
 
+    cJSON *max_response_size = cJSON_GetObjectItem(json, "max_response_size");
+    if (max_response_size && cJSON_IsNumber(max_response_size) &&
+        max_response_size->valuedouble > 0)
+    {
+        config->max_response_size = (long)max_response_size->valuedouble;
+    }
+
+    parse_retention(cJSON_GetObjectItem(json, "retention"), &config->retention);
+
     cJSON *hosts = cJSON_GetObjectItem(json, "hosts");
     if (hosts && cJSON_IsObject(hosts))
     {
@@ -204,7 +492,7 @@ parse_config(cJSON *json)
         if (host_count > 0)
         {
             config->host_count = host_count;
-            config->hosts = calloc(host_count, sizeof(host_config_t *));
+            config->hosts = arena_calloc(&config->arena, host_count, sizeof(host_config_t *));
 
             if (!config->hosts)
             {
@@ -216,7 +504,7 @@ parse_config(cJSON *json)
                 cJSON *host;
                 cJSON_ArrayForEach(host, hosts)
                 {
-                    host_config_t *host_config = parse_host_config(host, host->string);
+                    host_config_t *host_config = parse_host_config(&config->arena, host, host->string);
                     if (host_config)
                     {
                         config->hosts[i++] = host_config;
@@ -275,6 +563,50 @@ host_config_to_json(host_config_t *host)
           json, "response_deletion_url_json_path", host->response_deletion_url_json_path);
     }
 
+    if (host->fallback_host)
+    {
+        cJSON_AddStringToObject(json, "fallback_host", host->fallback_host);
+    }
+
+    if (host->http_version)
+    {
+        cJSON_AddStringToObject(json, "http_version", host->http_version);
+    }
+
+    if (host->optimize_images)
+    {
+        cJSON_AddStringToObject(json, "optimize_images", host->optimize_images);
+    }
+
+    if (host->compress)
+    {
+        cJSON_AddStringToObject(json, "compress", host->compress);
+    }
+
+    if (host->compress_as)
+    {
+        cJSON_AddStringToObject(json, "compress_as", host->compress_as);
+    }
+
+    cJSON *timeouts = NULL;
+    for (size_t i = 0; i < TIMEOUT_FIELD_COUNT; i++)
+    {
+        long value = *timeout_field(&host->timeouts, timeout_fields[i].key);
+        if (value > 0)
+        {
+            if (!timeouts)
+            {
+                timeouts = cJSON_CreateObject();
+            }
+            cJSON_AddNumberToObject(timeouts, timeout_fields[i].key, value);
+        }
+    }
+    if (timeouts)
+    {
+        cJSON_AddItemToObject(json, "timeouts", timeouts);
+    }
+    add_retention(json, &host->retention);
+
     if (host->static_field_count > 0 && host->static_field_names && host->static_field_values)
     {
         cJSON *static_form_fields = cJSON_CreateObject();
@@ -309,11 +641,24 @@ config_to_json(hostman_config_t *config)
         cJSON_AddStringToObject(json, "log_level", config->log_level);
     }
 
+    add_log_levels(json, config->log_levels);
+
+    if (config->log_format)
+    {
+        cJSON_AddStringToObject(json, "log_format", config->log_format);
+    }
+
     if (config->log_file)
     {
         cJSON_AddStringToObject(json, "log_file", config->log_file);
     }
 
+    if (config->max_response_size > 0)
+    {
+        cJSON_AddNumberToObject(json, "max_response_size", (double)config->max_response_size);
+    }
+    add_retention(json, &config->retention);
+
     cJSON *hosts = cJSON_CreateObject();
     for (int i = 0; i < config->host_count; i++)
     {
@@ -330,57 +675,134 @@ config_to_json(hostman_config_t *config)
 
 #else
 
+static void
+parse_retention(json_t *json, retention_config_t *retention)
+{
+    if (!json || !json_is_object(json))
+    {
+        return;
+    }
+    for (size_t i = 0; i < RETENTION_FIELD_COUNT; i++)
+    {
+        json_t *item = json_object_get(json, retention_fields[i].key);
+        if (item && json_is_integer(item) && json_integer_value(item) >= 0)
+        {
+            *retention_field(retention, retention_fields[i].key) = json_integer_value(item);
+        }
+    }
+}
+
+static void
+parse_log_levels(arena_t *arena, json_t *json, char **log_levels)
+{
+    if (!json || !json_is_object(json))
+    {
+        return;
+    }
+    for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+    {
+        json_t *item = json_object_get(json, log_subsystem_to_string(i));
+        if (item && json_is_string(item))
+        {
+            log_levels[i] = arena_strdup(arena, json_string_value(item));
+        }
+    }
+}
+
+static void
+add_log_levels(json_t *json, char **log_levels)
+{
+    json_t *object = NULL;
+    for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+    {
+        if (log_levels[i])
+        {
+            if (!object)
+            {
+                object = json_object();
+            }
+            json_object_set_new(object, log_subsystem_to_string(i), json_string(log_levels[i]));
+        }
+    }
+    if (object)
+    {
+        json_object_set_new(json, "log_levels", object);
+    }
+}
+
+static void
+add_retention(json_t *json, retention_config_t *retention)
+{
+    json_t *object = NULL;
+    for (size_t i = 0; i < RETENTION_FIELD_COUNT; i++)
+    {
+        long value = *retention_field(retention, retention_fields[i].key);
+        if (value > 0)
+        {
+            if (!object)
+            {
+                object = json_object();
+            }
+            json_object_set_new(object, retention_fields[i].key, json_integer(value));
+        }
+    }
+    if (object)
+    {
+        json_object_set_new(json, "retention", object);
+    }
+}
+
 static host_config_t *
-parse_host_config(json_t *host_json, const char *name)
+parse_host_config(arena_t *arena, json_t *host_json, const char *name)
 {
-    host_config_t *host = calloc(1, sizeof(host_config_t));
+    host_config_t *host = arena_calloc(arena, 1, sizeof(host_config_t));
     if (!host)
     {
         return NULL;
     }
 
-    host->name = strdup(name);
+    host->name = arena_strdup(arena, name);
 
     json_t *api_endpoint = json_object_get(host_json, "api_endpoint");
     if (api_endpoint && json_is_string(api_endpoint))
     {
-        host->api_endpoint = strdup(json_string_value(api_endpoint));
+        host->api_endpoint = arena_strdup(arena, json_string_value(api_endpoint));
     }
 
     json_t *auth_type = json_object_get(host_json, "auth_type");
     if (auth_type && json_is_string(auth_type))
     {
-        host->auth_type = strdup(json_string_value(auth_type));
+        host->auth_type = arena_strdup(arena, json_string_value(auth_type));
     }
 
     json_t *api_key_name = json_object_get(host_json, "api_key_name");
     if (api_key_name && json_is_string(api_key_name))
     {
-        host->api_key_name = strdup(json_string_value(api_key_name));
+        host->api_key_name = arena_strdup(arena, json_string_value(api_key_name));
     }
 
     json_t *api_key_encrypted = json_object_get(host_json, "api_key_encrypted");
     if (api_key_encrypted && json_is_string(api_key_encrypted))
     {
-        host->api_key_encrypted = strdup(json_string_value(api_key_encrypted));
+        host->api_key_encrypted = arena_strdup(arena, json_string_value(api_key_encrypted));
     }
 
     json_t *request_body_format = json_object_get(host_json, "request_body_format");
     if (request_body_format && json_is_string(request_body_format))
     {
-        host->request_body_format = strdup(json_string_value(request_body_format));
+        host->request_body_format = arena_strdup(arena, json_string_value(request_body_format));
     }
 
     json_t *file_form_field = json_object_get(host_json, "file_form_field");
     if (file_form_field && json_is_string(file_form_field))
     {
-        host->file_form_field = strdup(json_string_value(file_form_field));
+        host->file_form_field = arena_strdup(arena, json_string_value(file_form_field));
     }
 
     json_t *response_url_json_path = json_object_get(host_json, "response_url_json_path");
     if (response_url_json_path && json_is_string(response_url_json_path))
     {
-        host->response_url_json_path = strdup(json_string_value(response_url_json_path));
+        host->response_url_json_path = arena_strdup(arena, json_string_value(response_url_json_path));
     }
 
     json_t *response_deletion_url_json_path =
@@ -388,9 +810,54 @@ parse_host_config(json_t *host_json, const char *name)
     if (response_deletion_url_json_path && json_is_string(response_deletion_url_json_path))
     {
         host->response_deletion_url_json_path =
-          strdup(json_string_value(response_deletion_url_json_path));
+          arena_strdup(arena, json_string_value(response_deletion_url_json_path));
+    }
+
+    json_t *fallback_host = json_object_get(host_json, "fallback_host");
+    if (fallback_host && json_is_string(fallback_host))
+    {
+        host->fallback_host = arena_strdup(arena, json_string_value(fallback_host));
+    }
+
+    json_t *http_version = json_object_get(host_json, "http_version");
+    if (http_version && json_is_string(http_version))
+    {
+        host->http_version = arena_strdup(arena, json_string_value(http_version));
+    }
+
+    json_t *optimize_images = json_object_get(host_json, "optimize_images");
+    if (optimize_images && json_is_string(optimize_images))
+    {
+        host->optimize_images = arena_strdup(arena, json_string_value(optimize_images));
+    }
+
+    json_t *compress = json_object_get(host_json, "compress");
+    if (compress && json_is_string(compress))
+    {
+        host->compress = arena_strdup(arena, json_string_value(compress));
     }
 
+    json_t *compress_as = json_object_get(host_json, "compress_as");
+    if (compress_as && json_is_string(compress_as))
+    {
+        host->compress_as = arena_strdup(arena, json_string_value(compress_as));
+    }
+
+    json_t *timeouts = json_object_get(host_json, "timeouts");
+    if (timeouts && json_is_object(timeouts))
+    {
+        for (size_t i = 0; i < TIMEOUT_FIELD_COUNT; i++)
+        {
+            json_t *item = json_object_get(timeouts, timeout_fields[i].key);
+            if (item && json_is_integer(item) && json_integer_value(item) >= 0)
+            {
+                *timeout_field(&host->timeouts, timeout_fields[i].key) = json_integer_value(item);
+            }
+        }
+    }
+
+    parse_retention(json_object_get(host_json, "retention"), &host->retention);
+
     json_t *static_form_fields = json_object_get(host_json, "static_form_fields");
     if (static_form_fields && json_is_object(static_form_fields))
     {
@@ -398,13 +865,11 @@ parse_host_config(json_t *host_json, const char *name)
         if (field_count > 0)
         {
             host->static_field_count = field_count;
-            host->static_field_names = calloc(field_count, sizeof(char *));
-            host->static_field_values = calloc(field_count, sizeof(char *));
+            host->static_field_names = arena_calloc(arena, field_count, sizeof(char *));
+            host->static_field_values = arena_calloc(arena, field_count, sizeof(char *));
 
             if (!host->static_field_names || !host->static_field_values)
             {
-                free(host->static_field_names);
-                free(host->static_field_values);
                 host->static_field_count = 0;
             }
             else
@@ -417,8 +882,8 @@ parse_host_config(json_t *host_json, const char *name)
                 {
                     if (json_is_string(value))
                     {
-                        host->static_field_names[i] = strdup(key);
-                        host->static_field_values[i] = strdup(json_string_value(value));
+                        host->static_field_names[i] = arena_strdup(arena, key);
+                        host->static_field_values[i] = arena_strdup(arena, json_string_value(value));
                         i++;
                     }
                 }
@@ -456,39 +921,46 @@ parse_config(json_t *json)
     json_t *default_host = json_object_get(json, "default_host");
     if (default_host && json_is_string(default_host))
     {
-        config->default_host = strdup(json_string_value(default_host));
+        config->default_host = arena_strdup(&config->arena, json_string_value(default_host));
     }
 
     json_t *log_level = json_object_get(json, "log_level");
     if (log_level && json_is_string(log_level))
     {
-        config->log_level = strdup(json_string_value(log_level));
+        config->log_level = arena_strdup(&config->arena, json_string_value(log_level));
     }
     else
     {
-        config->log_level = strdup("INFO");
+        config->log_level = arena_strdup(&config->arena, "INFO");
+    }
+
+    parse_log_levels(&config->arena, json_object_get(json, "log_levels"), config->log_levels);
+
+    json_t *log_format = json_object_get(json, "log_format");
+    if (log_format && json_is_string(log_format))
+    {
+        config->log_format = arena_strdup(&config->arena, json_string_value(log_format));
     }
 
     json_t *log_file = json_object_get(json, "log_file");
     if (log_file && json_is_string(log_file))
     {
-        config->log_file = strdup(json_string_value(log_file));
+        config->log_file = arena_strdup(&config->arena, json_string_value(log_file));
     }
     else
     {
-        char *cache_dir = get_cache_dir();
-        if (cache_dir)
-        {
-            size_t len = strlen(cache_dir) + strlen("/hostman.log") + 1;
-            config->log_file = malloc(len);
-            if (config->log_file)
-            {
-                snprintf(config->log_file, len, "%s/hostman.log", cache_dir);
-            }
-            free(cache_dir);
-        }
+        config->log_file = default_log_file(&config->arena);
     }
 
+    json_t *max_response_size = json_object_get(json, "max_response_size");
+    if (max_response_size && json_is_integer(max_response_size) &&
+        json_integer_value(max_response_size) > 0)
+    {
+        config->max_response_size = (long)json_integer_value(max_response_size);
+    }
+
+    parse_retention(json_object_get(json, "retention"), &config->retention);
+
     json_t *hosts = json_object_get(json, "hosts");
     if (hosts && json_is_object(hosts))
     {
@@ -496,7 +968,7 @@ parse_config(json_t *json)
         if (host_count > 0)
         {
             config->host_count = host_count;
-            config->hosts = calloc(host_count, sizeof(host_config_t *));
+            config->hosts = arena_calloc(&config->arena, host_count, sizeof(host_config_t *));
 
             if (!config->hosts)
             {
@@ -510,7 +982,7 @@ parse_config(json_t *json)
 
                 json_object_foreach(hosts, key, value)
                 {
-                    host_config_t *host_config = parse_host_config(value, key);
+                    host_config_t *host_config = parse_host_config(&config->arena, value, key);
                     if (host_config)
                     {
                         config->hosts[i++] = host_config;
@@ -571,6 +1043,50 @@ host_config_to_json(host_config_t *host)
                             json_string(host->response_deletion_url_json_path));
     }
 
+    if (host->fallback_host)
+    {
+        json_object_set_new(json, "fallback_host", json_string(host->fallback_host));
+    }
+
+    if (host->http_version)
+    {
+        json_object_set_new(json, "http_version", json_string(host->http_version));
+    }
+
+    if (host->optimize_images)
+    {
+        json_object_set_new(json, "optimize_images", json_string(host->optimize_images));
+    }
+
+    if (host->compress)
+    {
+        json_object_set_new(json, "compress", json_string(host->compress));
+    }
+
+    if (host->compress_as)
+    {
+        json_object_set_new(json, "compress_as", json_string(host->compress_as));
+    }
+
+    json_t *timeouts = NULL;
+    for (size_t i = 0; i < TIMEOUT_FIELD_COUNT; i++)
+    {
+        long value = *timeout_field(&host->timeouts, timeout_fields[i].key);
+        if (value > 0)
+        {
+            if (!timeouts)
+            {
+                timeouts = json_object();
+            }
+            json_object_set_new(timeouts, timeout_fields[i].key, json_integer(value));
+        }
+    }
+    if (timeouts)
+    {
+        json_object_set_new(json, "timeouts", timeouts);
+    }
+    add_retention(json, &host->retention);
+
     if (host->static_field_count > 0 && host->static_field_names && host->static_field_values)
     {
         json_t *static_form_fields = json_object();
@@ -606,11 +1122,24 @@ config_to_json(hostman_config_t *config)
         json_object_set_new(json, "log_level", json_string(config->log_level));
     }
 
+    add_log_levels(json, config->log_levels);
+
+    if (config->log_format)
+    {
+        json_object_set_new(json, "log_format", json_string(config->log_format));
+    }
+
     if (config->log_file)
     {
         json_object_set_new(json, "log_file", json_string(config->log_file));
     }
 
+    if (config->max_response_size > 0)
+    {
+        json_object_set_new(json, "max_response_size", json_integer(config->max_response_size));
+    }
+    add_retention(json, &config->retention);
+
     json_t *hosts = json_object();
     for (int i = 0; i < config->host_count; i++)
     {
@@ -735,7 +1264,7 @@ config_save(hostman_config_t *config)
         return false;
     }
 
-    char *dir = get_config_dir();
+    const char *dir = get_config_dir();
     if (!dir)
     {
         free(path);
@@ -747,12 +1276,10 @@ config_save(hostman_config_t *config)
         if (mkdir(dir, 0755) != 0)
         {
             log_error("Failed to create config directory: %s", dir);
-            free(dir);
             free(path);
             return false;
         }
     }
-    free(dir);
 
     FILE *file = fopen(path, "w");
     if (!file)
@@ -846,6 +1373,21 @@ config_get_value(const char *key)
             value = strdup(config->log_level);
         }
     }
+    else if (strncmp(key, "log_levels.", 11) == 0)
+    {
+        log_subsystem_t subsystem;
+        if (log_subsystem_from_string(key + 11, &subsystem))
+        {
+            /* Report the level in effect, so an unset override shows the inherited one. */
+            const char *level = config->log_levels[subsystem] ? config->log_levels[subsystem]
+                                                               : config->log_level;
+            value = level ? strdup(level) : NULL;
+        }
+    }
+    else if (strcmp(key, "log_format") == 0)
+    {
+        value = strdup(config->log_format ? config->log_format : "text");
+    }
     else if (strcmp(key, "log_file") == 0)
     {
         if (config->log_file)
@@ -853,6 +1395,20 @@ config_get_value(const char *key)
             value = strdup(config->log_file);
         }
     }
+    else if (strcmp(key, "max_response_size") == 0)
+    {
+        value = malloc(32);
+        snprintf(value, 32, "%ld", config->max_response_size);
+    }
+    else if (strncmp(key, "retention.", 10) == 0)
+    {
+        long *field = retention_field(&config->retention, key + 10);
+        if (field)
+        {
+            value = malloc(32);
+            snprintf(value, 32, "%ld", *field);
+        }
+    }
     else
     {
         if (strncmp(key, "hosts.", 6) == 0)
@@ -928,6 +1484,47 @@ config_get_value(const char *key)
                             value = strdup(host->response_deletion_url_json_path);
                         }
                     }
+                    else if (strcmp(prop, "fallback_host") == 0)
+                    {
+                        if (host->fallback_host)
+                        {
+                            value = strdup(host->fallback_host);
+                        }
+                    }
+                    else if (strcmp(prop, "http_version") == 0)
+                    {
+                        value = strdup(host->http_version ? host->http_version : "auto");
+                    }
+                    else if (strcmp(prop, "optimize_images") == 0)
+                    {
+                        value = strdup(host->optimize_images ? host->optimize_images : "off");
+                    }
+                    else if (strcmp(prop, "compress") == 0)
+                    {
+                        value = strdup(host->compress ? host->compress : "off");
+                    }
+                    else if (strcmp(prop, "compress_as") == 0)
+                    {
+                        value = strdup(host->compress_as ? host->compress_as : "suffix");
+                    }
+                    else if (strncmp(prop, "timeouts.", 9) == 0)
+                    {
+                        long *field = timeout_field(&host->timeouts, prop + 9);
+                        if (field)
+                        {
+                            value = malloc(32);
+                            snprintf(value, 32, "%ld", *field);
+                        }
+                    }
+                    else if (strncmp(prop, "retention.", 10) == 0)
+                    {
+                        long *field = retention_field(&host->retention, prop + 10);
+                        if (field)
+                        {
+                            value = malloc(32);
+                            snprintf(value, 32, "%ld", *field);
+                        }
+                    }
                 }
 
                 free(host_name);
@@ -949,25 +1546,11 @@ config_set_value(const char *key, const char *value)
     hostman_config_t *config = config_load();
     if (!config)
     {
-        config = calloc(1, sizeof(hostman_config_t));
+        config = config_new();
         if (!config)
         {
             return false;
         }
-        config->version = 1;
-        config->log_level = strdup("INFO");
-
-        char *cache_dir = get_cache_dir();
-        if (cache_dir)
-        {
-            size_t len = strlen(cache_dir) + strlen("/hostman.log") + 1;
-            config->log_file = malloc(len);
-            if (config->log_file)
-            {
-                snprintf(config->log_file, len, "%s/hostman.log", cache_dir);
-            }
-            free(cache_dir);
-        }
     }
 
     bool changed = false;
@@ -995,8 +1578,7 @@ config_set_value(const char *key, const char *value)
 
         if (host_exists)
         {
-            free(config->default_host);
-            config->default_host = strdup(value);
+            config->default_host = arena_strdup(&config->arena, value);
             changed = true;
         }
         else
@@ -1009,8 +1591,7 @@ config_set_value(const char *key, const char *value)
         if (strcmp(value, "DEBUG") == 0 || strcmp(value, "INFO") == 0 ||
             strcmp(value, "WARN") == 0 || strcmp(value, "ERROR") == 0)
         {
-            free(config->log_level);
-            config->log_level = strdup(value);
+            config->log_level = arena_strdup(&config->arena, value);
             changed = true;
         }
         else
@@ -1018,12 +1599,45 @@ config_set_value(const char *key, const char *value)
             log_error("Invalid log level: %s", value);
         }
     }
+    else if (strncmp(key, "log_levels.", 11) == 0)
+    {
+        changed = set_log_level_override(config, key + 11, value);
+    }
+    else if (strcmp(key, "log_format") == 0)
+    {
+        if (strcmp(value, "text") == 0 || strcmp(value, "json") == 0)
+        {
+            config->log_format = arena_strdup(&config->arena, value);
+            changed = true;
+        }
+        else
+        {
+            log_error("Invalid log format: %s (use text or json)", value);
+        }
+    }
     else if (strcmp(key, "log_file") == 0)
     {
-        free(config->log_file);
-        config->log_file = strdup(value);
+        config->log_file = arena_strdup(&config->arena, value);
         changed = true;
     }
+    else if (strcmp(key, "max_response_size") == 0)
+    {
+        char *end = NULL;
+        long max_response_size = strtol(value, &end, 10);
+        if (end != value && *end == '\0' && max_response_size >= 0)
+        {
+            config->max_response_size = max_response_size;
+            changed = true;
+        }
+        else
+        {
+            log_error("Invalid max_response_size: %s", value);
+        }
+    }
+    else if (strncmp(key, "retention.", 10) == 0)
+    {
+        changed = set_retention_value(&config->retention, key + 10, value);
+    }
     else
     {
         if (strncmp(key, "hosts.", 6) == 0)
@@ -1052,46 +1666,128 @@ config_set_value(const char *key, const char *value)
                     const char *prop = dot + 1;
                     if (strcmp(prop, "api_endpoint") == 0)
                     {
-                        free(host->api_endpoint);
-                        host->api_endpoint = strdup(value);
+                        host->api_endpoint = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "auth_type") == 0)
                     {
-                        free(host->auth_type);
-                        host->auth_type = strdup(value);
+                        host->auth_type = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "api_key_name") == 0)
                     {
-                        free(host->api_key_name);
-                        host->api_key_name = strdup(value);
+                        host->api_key_name = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "request_body_format") == 0)
                     {
-                        free(host->request_body_format);
-                        host->request_body_format = strdup(value);
+                        host->request_body_format = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "file_form_field") == 0)
                     {
-                        free(host->file_form_field);
-                        host->file_form_field = strdup(value);
+                        host->file_form_field = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "response_url_json_path") == 0)
                     {
-                        free(host->response_url_json_path);
-                        host->response_url_json_path = strdup(value);
+                        host->response_url_json_path = arena_strdup(&config->arena, value);
                         changed = true;
                     }
                     else if (strcmp(prop, "response_deletion_url_json_path") == 0)
                     {
-                        free(host->response_deletion_url_json_path);
-                        host->response_deletion_url_json_path = strdup(value);
+                        host->response_deletion_url_json_path =
+                          arena_strdup(&config->arena, value);
                         changed = true;
                     }
+                    else if (strcmp(prop, "fallback_host") == 0)
+                    {
+                        if (strcmp(value, host->name) == 0)
+                        {
+                            log_error("Host '%s' cannot fall back to itself", host->name);
+                        }
+                        else
+                        {
+                            host->fallback_host = arena_strdup(&config->arena, value);
+                            changed = true;
+                        }
+                    }
+                    else if (strcmp(prop, "http_version") == 0)
+                    {
+                        if (strcmp(value, "auto") == 0 || strcmp(value, "1.1") == 0 ||
+                            strcmp(value, "2") == 0 || strcmp(value, "3") == 0)
+                        {
+                            host->http_version = arena_strdup(&config->arena, value);
+                            changed = true;
+                        }
+                        else
+                        {
+                            log_error("Invalid http_version: %s (expected auto, 1.1, 2 or 3)",
+                                      value);
+                        }
+                    }
+                    else if (strcmp(prop, "optimize_images") == 0)
+                    {
+                        if (strcmp(value, "off") == 0 || strcmp(value, "lossless") == 0)
+                        {
+                            host->optimize_images = arena_strdup(&config->arena, value);
+                            changed = true;
+                        }
+                        else
+                        {
+                            log_error("Invalid optimize_images: %s (expected off or lossless)",
+                                      value);
+                        }
+                    }
+                    else if (strcmp(prop, "compress") == 0)
+                    {
+                        if (strcmp(value, "off") == 0 || strcmp(value, "gzip") == 0 ||
+                            strcmp(value, "zstd") == 0)
+                        {
+                            host->compress = arena_strdup(&config->arena, value);
+                            changed = true;
+                        }
+                        else
+                        {
+                            log_error("Invalid compress: %s (expected off, gzip or zstd)", value);
+                        }
+                    }
+                    else if (strcmp(prop, "compress_as") == 0)
+                    {
+                        if (strcmp(value, "suffix") == 0 || strcmp(value, "encoding") == 0)
+                        {
+                            host->compress_as = arena_strdup(&config->arena, value);
+                            changed = true;
+                        }
+                        else
+                        {
+                            log_error("Invalid compress_as: %s (expected suffix or encoding)",
+                                      value);
+                        }
+                    }
+                    else if (strncmp(prop, "timeouts.", 9) == 0)
+                    {
+                        long *field = timeout_field(&host->timeouts, prop + 9);
+                        char *end = NULL;
+                        long number = strtol(value, &end, 10);
+                        if (!field)
+                        {
+                            log_error("Unknown timeout setting: %s", prop + 9);
+                        }
+                        else if (!end || *end != '\0' || number < 0)
+                        {
+                            log_error("Invalid timeout value: %s", value);
+                        }
+                        else
+                        {
+                            *field = number;
+                            changed = true;
+                        }
+                    }
+                    else if (strncmp(prop, "retention.", 10) == 0)
+                    {
+                        changed = set_retention_value(&host->retention, prop + 10, value);
+                    }
                 }
                 else
                 {
@@ -1116,7 +1812,7 @@ config_set_value(const char *key, const char *value)
 }
 
 bool
-config_add_host(host_config_t *host)
+config_add_host(const host_config_t *host)
 {
     if (!host || !host->name)
     {
@@ -1126,25 +1822,11 @@ config_add_host(host_config_t *host)
     hostman_config_t *config = config_load();
     if (!config)
     {
-        config = calloc(1, sizeof(hostman_config_t));
+        config = config_new();
         if (!config)
         {
             return false;
         }
-        config->version = 1;
-        config->log_level = strdup("INFO");
-
-        char *cache_dir = get_cache_dir();
-        if (cache_dir)
-        {
-            size_t len = strlen(cache_dir) + strlen("/hostman.log") + 1;
-            config->log_file = malloc(len);
-            if (config->log_file)
-            {
-                snprintf(config->log_file, len, "%s/hostman.log", cache_dir);
-            }
-            free(cache_dir);
-        }
     }
 
     for (int i = 0; i < config->host_count; i++)
@@ -1156,21 +1838,27 @@ config_add_host(host_config_t *host)
         }
     }
 
+    /* The old array stays in the arena; adding hosts is rare enough not to matter. */
     host_config_t **new_hosts =
-      realloc(config->hosts, (config->host_count + 1) * sizeof(host_config_t *));
-    if (!new_hosts)
+      arena_alloc(&config->arena, (config->host_count + 1) * sizeof(host_config_t *));
+    host_config_t *copy = copy_host(&config->arena, host);
+    if (!new_hosts || !copy)
     {
         log_error("Failed to allocate memory for new host");
         return false;
     }
 
+    if (config->host_count > 0)
+    {
+        memcpy(new_hosts, config->hosts, config->host_count * sizeof(host_config_t *));
+    }
     config->hosts = new_hosts;
-    config->hosts[config->host_count] = host;
+    config->hosts[config->host_count] = copy;
     config->host_count++;
 
     if (config->host_count == 1 && !config->default_host)
     {
-        config->default_host = strdup(host->name);
+        config->default_host = copy->name;
     }
 
     return config_save(config);
@@ -1195,29 +1883,6 @@ config_remove_host(const char *host_name)
     {
         if (config->hosts[i] && strcmp(config->hosts[i]->name, host_name) == 0)
         {
-            free(config->hosts[i]->name);
-            free(config->hosts[i]->api_endpoint);
-            free(config->hosts[i]->auth_type);
-            free(config->hosts[i]->api_key_name);
-            free(config->hosts[i]->api_key_encrypted);
-            free(config->hosts[i]->request_body_format);
-            free(config->hosts[i]->file_form_field);
-            free(config->hosts[i]->response_url_json_path);
-            free(config->hosts[i]->response_deletion_url_json_path);
-
-            if (config->hosts[i]->static_field_count > 0)
-            {
-                for (int j = 0; j < config->hosts[i]->static_field_count; j++)
-                {
-                    free(config->hosts[i]->static_field_names[j]);
-                    free(config->hosts[i]->static_field_values[j]);
-                }
-                free(config->hosts[i]->static_field_names);
-                free(config->hosts[i]->static_field_values);
-            }
-
-            free(config->hosts[i]);
-
             for (int j = i; j < config->host_count - 1; j++)
             {
                 config->hosts[j] = config->hosts[j + 1];
@@ -1237,12 +1902,11 @@ config_remove_host(const char *host_name)
 
     if (config->default_host && strcmp(config->default_host, host_name) == 0)
     {
-        free(config->default_host);
         config->default_host = NULL;
 
         if (config->host_count > 0 && config->hosts[0])
         {
-            config->default_host = strdup(config->hosts[0]->name);
+            config->default_host = config->hosts[0]->name;
         }
     }
 
@@ -1279,8 +1943,7 @@ config_set_default_host(const char *host_name)
         return false;
     }
 
-    free(config->default_host);
-    config->default_host = strdup(host_name);
+    config->default_host = arena_strdup(&config->arena, host_name);
 
     return config_save(config);
 }
@@ -1338,40 +2001,8 @@ config_free(hostman_config_t *config)
         return;
     }
 
-    free(config->default_host);
-    free(config->log_level);
-    free(config->log_file);
-
-    for (int i = 0; i < config->host_count; i++)
-    {
-        if (config->hosts[i])
-        {
-            free(config->hosts[i]->name);
-            free(config->hosts[i]->api_endpoint);
-            free(config->hosts[i]->auth_type);
-            free(config->hosts[i]->api_key_name);
-            free(config->hosts[i]->api_key_encrypted);
-            free(config->hosts[i]->request_body_format);
-            free(config->hosts[i]->file_form_field);
-            free(config->hosts[i]->response_url_json_path);
-            free(config->hosts[i]->response_deletion_url_json_path);
-
-            if (config->hosts[i]->static_field_count > 0)
-            {
-                for (int j = 0; j < config->hosts[i]->static_field_count; j++)
-                {
-                    free(config->hosts[i]->static_field_names[j]);
-                    free(config->hosts[i]->static_field_values[j]);
-                }
-                free(config->hosts[i]->static_field_names);
-                free(config->hosts[i]->static_field_values);
-            }
-
-            free(config->hosts[i]);
-        }
-    }
-
-    free(config->hosts);
+    /* Every string, host and array of the config lives in its arena. */
+    arena_destroy(&config->arena);
     free(config);
 
     if (current_config == config)
@@ -1,5 +1,6 @@
 #include "hostman/core/logging.h"
 #include "hostman/core/config.h"
+#include "hostman/core/output.h"
 #include "hostman/core/utils.h"
 #include <errno.h>
 #include <pthread.h>
@@ -13,35 +14,69 @@
 #include <unistd.h>
 
 static FILE *log_file = NULL;
-static log_level_t current_log_level = LOG_LEVEL_INFO;
+static log_format_t log_format = LOG_FORMAT_TEXT;
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool console_errors = true;
+static _Thread_local log_context_t log_context = { 0 };
 
-static log_level_t
-string_to_log_level(const char *level_str)
+log_level_t log_subsystem_levels[LOG_SUBSYSTEM_COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+};
+
+static const char *subsystem_names[LOG_SUBSYSTEM_COUNT] = {
+    "core", "cli", "network", "storage", "crypto",
+};
+
+bool
+log_level_from_string(const char *text, log_level_t *level)
 {
-    if (!level_str)
+    if (!text)
     {
-        return LOG_LEVEL_INFO;
+        return false;
     }
 
-    if (strcasecmp(level_str, "DEBUG") == 0)
+    if (strcasecmp(text, "DEBUG") == 0)
+    {
+        *level = LOG_LEVEL_DEBUG;
+    }
+    else if (strcasecmp(text, "INFO") == 0)
     {
-        return LOG_LEVEL_DEBUG;
+        *level = LOG_LEVEL_INFO;
     }
-    else if (strcasecmp(level_str, "INFO") == 0)
+    else if (strcasecmp(text, "WARN") == 0)
     {
-        return LOG_LEVEL_INFO;
+        *level = LOG_LEVEL_WARN;
     }
-    else if (strcasecmp(level_str, "WARN") == 0)
+    else if (strcasecmp(text, "ERROR") == 0)
     {
-        return LOG_LEVEL_WARN;
+        *level = LOG_LEVEL_ERROR;
     }
-    else if (strcasecmp(level_str, "ERROR") == 0)
+    else
     {
-        return LOG_LEVEL_ERROR;
+        return false;
+    }
+    return true;
+}
+
+bool
+log_subsystem_from_string(const char *text, log_subsystem_t *subsystem)
+{
+    for (int i = 0; text && i < LOG_SUBSYSTEM_COUNT; i++)
+    {
+        if (strcmp(subsystem_names[i], text) == 0)
+        {
+            *subsystem = (log_subsystem_t)i;
+            return true;
+        }
     }
+    return false;
+}
 
-    return LOG_LEVEL_INFO;
+const char *
+log_subsystem_to_string(log_subsystem_t subsystem)
+{
+    return subsystem >= 0 && subsystem < LOG_SUBSYSTEM_COUNT ? subsystem_names[subsystem]
+                                                               : "unknown";
 }
 
 static const char *
@@ -76,11 +111,19 @@ logging_init(void)
     hostman_config_t *config = config_load();
     if (config)
     {
-        if (config->log_level)
+        /* Unknown names fall back to INFO, as config files are edited by hand. */
+        log_level_t level = LOG_LEVEL_INFO;
+        log_level_from_string(config->log_level, &level);
+        for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
         {
-            current_log_level = string_to_log_level(config->log_level);
+            log_subsystem_levels[i] = level;
+            log_level_from_string(config->log_levels[i], &log_subsystem_levels[i]);
         }
 
+        log_format = config->log_format && strcmp(config->log_format, "json") == 0
+                       ? LOG_FORMAT_JSON
+                       : LOG_FORMAT_TEXT;
+
         if (config->log_file)
         {
             char *last_slash = strrchr(config->log_file, '/');
@@ -113,7 +156,7 @@ logging_init(void)
 
     if (!log_file)
     {
-        char *cache_dir = get_cache_dir();
+        const char *cache_dir = get_cache_dir();
         if (cache_dir)
         {
             char log_path[512];
@@ -133,31 +176,84 @@ logging_init(void)
                         log_path,
                         strerror(errno));
             }
-
-            free(cache_dir);
         }
     }
 
     pthread_mutex_unlock(&log_mutex);
 
-    log_info("Logging system initialized (level: %s)", log_level_to_string(current_log_level));
+    log_info("Logging system initialized (level: %s)",
+             log_level_to_string(log_subsystem_levels[LOG_SUBSYSTEM]));
 
     return true;
 }
 
+static void
+write_json_string(FILE *file, const char *value)
+{
+    if (!value)
+    {
+        fputs("null", file);
+        return;
+    }
+
+    fputc('"', file);
+    for (const char *p = value; *p; p++)
+    {
+        char buffer[8];
+        const char *escape = json_escape((unsigned char)*p, buffer);
+        if (escape)
+            fputs(escape, file);
+        else
+            fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+/* One object per line with a fixed set of keys; absent values are null rather than left out. */
+static void
+write_json_line(log_level_t level,
+                log_subsystem_t subsystem,
+                const char *file,
+                int line,
+                const char *function,
+                const char *message)
+{
+    struct timespec now;
+    struct tm tm_now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    gmtime_r(&now.tv_sec, &tm_now);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm_now);
+
+    fprintf(log_file,
+            "{\"ts\":\"%s.%03ldZ\",\"level\":\"%s\",\"subsystem\":\"%s\",\"file\":",
+            timestamp,
+            now.tv_nsec / 1000000,
+            log_level_to_string(level),
+            log_subsystem_to_string(subsystem));
+    write_json_string(log_file, file);
+    fprintf(log_file, ",\"line\":%d,\"func\":", line);
+    write_json_string(log_file, function);
+    fputs(",\"msg\":", log_file);
+    write_json_string(log_file, message);
+    if (log_context.upload_id > 0)
+        fprintf(log_file, ",\"upload_id\":%lld", log_context.upload_id);
+    else
+        fputs(",\"upload_id\":null", log_file);
+    fputs(",\"host\":", log_file);
+    write_json_string(log_file, log_context.host);
+    fputs("}\n", log_file);
+}
+
 void
 log_message(log_level_t level,
+            log_subsystem_t subsystem,
             const char *file,
             int line,
             const char *function,
             const char *format,
             ...)
 {
-    if (level < current_log_level)
-    {
-        return;
-    }
-
     pthread_mutex_lock(&log_mutex);
 
     if (!log_file && !logging_init())
@@ -197,7 +293,12 @@ log_message(log_level_t level,
     vsnprintf(msg_buffer, sizeof(msg_buffer), format, args);
     va_end(args);
 
-    if (log_file)
+    if (log_file && log_format == LOG_FORMAT_JSON)
+    {
+        write_json_line(level, subsystem, basename, line, function, msg_buffer);
+        fflush(log_file);
+    }
+    else if (log_file)
     {
         fprintf(log_file,
                 "[%s] [%s] [%s:%d %s] %s\n",
@@ -210,7 +311,7 @@ log_message(log_level_t level,
         fflush(log_file);
     }
 
-    if (level == LOG_LEVEL_ERROR)
+    if (level == LOG_LEVEL_ERROR && console_errors)
     {
         fprintf(stderr, "[%s] ERROR: %s\n", timestamp, msg_buffer);
     }
@@ -218,6 +319,36 @@ log_message(log_level_t level,
     pthread_mutex_unlock(&log_mutex);
 }
 
+log_context_t
+log_push_context(const char *host, long long upload_id)
+{
+    log_context_t previous = log_context;
+    if (host)
+    {
+        log_context.host = host;
+    }
+    if (upload_id > 0)
+    {
+        log_context.upload_id = upload_id;
+    }
+    return previous;
+}
+
+void
+log_pop_context(log_context_t previous)
+{
+    log_context = previous;
+}
+
+/* Errors still reach the log file; only the copy on stderr is suppressed, e.g. under curses. */
+void
+logging_set_console_errors(bool enabled)
+{
+    pthread_mutex_lock(&log_mutex);
+    console_errors = enabled;
+    pthread_mutex_unlock(&log_mutex);
+}
+
 void
 logging_cleanup(void)
 {
@@ -0,0 +1,666 @@
+#include "hostman/core/optimize.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_CHUNK_OVERHEAD 12
+#define PNG_IHDR_LENGTH 13
+#define PNG_MAX_CHUNK_LENGTH 0x7fffffffUL
+
+static const unsigned char png_signature[PNG_SIGNATURE_SIZE] = { 0x89, 'P',  'N',  'G',
+                                                                 '\r', '\n', 0x1a, '\n' };
+
+/* Ancillary chunks that only carry metadata; dropping them never changes the decoded image. */
+static const char *const stripped_chunks[] = { "tEXt", "zTXt", "iTXt", "eXIf", "tIME" };
+
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} byte_buffer_t;
+
+struct optimize_pool
+{
+    char **file_paths;
+    int file_count;
+    optimize_result_t *results;
+    bool *done;
+    int next;
+    bool cancel;
+    pthread_mutex_t lock;
+    pthread_t *threads;
+    int thread_count;
+};
+
+static bool
+bytes_reserve(byte_buffer_t *buf, size_t extra)
+{
+    if (extra <= buf->capacity - buf->size)
+    {
+        return true;
+    }
+
+    size_t capacity = buf->capacity ? buf->capacity : 4096;
+    while (capacity - buf->size < extra)
+    {
+        if (capacity > SIZE_MAX / 2)
+        {
+            return false;
+        }
+        capacity *= 2;
+    }
+
+    unsigned char *data = realloc(buf->data, capacity);
+    if (!data)
+    {
+        return false;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+    return true;
+}
+
+static bool
+bytes_append(byte_buffer_t *buf, const void *data, size_t size)
+{
+    if (!bytes_reserve(buf, size))
+    {
+        return false;
+    }
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+    return true;
+}
+
+static uint32_t
+read_u32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void
+write_u32(unsigned char *p, uint32_t value)
+{
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+static bool
+append_chunk(byte_buffer_t *out, const unsigned char *type, const unsigned char *data, size_t len)
+{
+    if (len > PNG_MAX_CHUNK_LENGTH || !bytes_reserve(out, len + PNG_CHUNK_OVERHEAD))
+    {
+        return false;
+    }
+
+    unsigned char header[8];
+    write_u32(header, (uint32_t)len);
+    memcpy(header + 4, type, 4);
+    bytes_append(out, header, sizeof(header));
+    bytes_append(out, data, len);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, type, 4);
+    crc = crc32(crc, data, (uInt)len);
+
+    unsigned char trailer[4];
+    write_u32(trailer, (uint32_t)crc);
+    bytes_append(out, trailer, sizeof(trailer));
+    return true;
+}
+
+static bool
+is_stripped_chunk(const unsigned char *type)
+{
+    for (size_t i = 0; i < sizeof(stripped_chunks) / sizeof(stripped_chunks[0]); i++)
+    {
+        if (memcmp(type, stripped_chunks[i], 4) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Upper bound on the decompressed image data from the IHDR fields, so a crafted file cannot
+ * make the optimizer inflate without limit. Interlacing adds at most a few bytes per row.
+ */
+static size_t
+png_raw_limit(const unsigned char *ihdr)
+{
+    uint32_t width = read_u32(ihdr);
+    uint32_t height = read_u32(ihdr + 4);
+    unsigned int depth = ihdr[8];
+    unsigned int channels;
+
+    switch (ihdr[9])
+    {
+        case 0:
+        case 3:
+            channels = 1;
+            break;
+        case 2:
+            channels = 3;
+            break;
+        case 4:
+            channels = 2;
+            break;
+        case 6:
+            channels = 4;
+            break;
+        default:
+            return 0;
+    }
+
+    uint64_t row = ((uint64_t)width * channels * depth + 7) / 8 + 1;
+    uint64_t limit = row * height + 16 * (uint64_t)height;
+    return limit > UINT_MAX ? 0 : (size_t)limit;
+}
+
+static bool
+inflate_all(const byte_buffer_t *compressed, byte_buffer_t *raw, size_t limit)
+{
+    z_stream stream = { 0 };
+    if (inflateInit(&stream) != Z_OK)
+    {
+        return false;
+    }
+
+    stream.next_in = compressed->data;
+    stream.avail_in = (uInt)compressed->size;
+
+    int status = Z_OK;
+    while (status == Z_OK)
+    {
+        if (raw->size >= limit || !bytes_reserve(raw, compressed->size + 65536))
+        {
+            break;
+        }
+        size_t room = raw->capacity - raw->size;
+        stream.next_out = raw->data + raw->size;
+        stream.avail_out = room > UINT_MAX ? UINT_MAX : (uInt)room;
+
+        uInt before = stream.avail_out;
+        status = inflate(&stream, Z_NO_FLUSH);
+        raw->size += before - stream.avail_out;
+
+        if (status == Z_BUF_ERROR && stream.avail_in > 0)
+        {
+            status = Z_OK;
+        }
+    }
+
+    inflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+/*
+ * Recompress at the highest level with both the default and the filtered strategy; PNG
+ * scanlines are already delta-filtered, so which one wins depends on the image.
+ */
+static bool
+deflate_best(const byte_buffer_t *raw, byte_buffer_t *best)
+{
+    static const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED };
+    bool found = false;
+
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+    {
+        z_stream stream = { 0 };
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15, 9, strategies[i]) != Z_OK)
+        {
+            continue;
+        }
+
+        uLong bound = deflateBound(&stream, (uLong)raw->size);
+        unsigned char *data = malloc(bound);
+        if (!data)
+        {
+            deflateEnd(&stream);
+            continue;
+        }
+
+        stream.next_in = raw->data;
+        stream.avail_in = (uInt)raw->size;
+        stream.next_out = data;
+        stream.avail_out = (uInt)bound;
+
+        int status = deflate(&stream, Z_FINISH);
+        size_t size = stream.total_out;
+        deflateEnd(&stream);
+
+        if (status == Z_STREAM_END && (!found || size < best->size))
+        {
+            free(best->data);
+            best->data = data;
+            best->size = size;
+            best->capacity = bound;
+            found = true;
+        }
+        else
+        {
+            free(data);
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Rewrite a PNG with its metadata chunks removed and all IDAT data recompressed into a single
+ * chunk. The filtered scanlines are left untouched, so the decoded pixels are identical. Any
+ * structural problem or CRC mismatch makes this give up rather than touch the file.
+ */
+static bool
+optimize_png(const unsigned char *data, size_t size, byte_buffer_t *out)
+{
+    if (size < PNG_SIGNATURE_SIZE + PNG_CHUNK_OVERHEAD + PNG_IHDR_LENGTH ||
+        memcmp(data, png_signature, PNG_SIGNATURE_SIZE) != 0 ||
+        memcmp(data + PNG_SIGNATURE_SIZE + 4, "IHDR", 4) != 0)
+    {
+        return false;
+    }
+
+    size_t raw_limit = png_raw_limit(data + PNG_SIGNATURE_SIZE + 8);
+    bytes_append(out, png_signature, PNG_SIGNATURE_SIZE);
+
+    size_t pos = PNG_SIGNATURE_SIZE;
+    bool seen_idat = false;
+    bool seen_iend = false;
+
+    while (!seen_iend && size - pos >= PNG_CHUNK_OVERHEAD)
+    {
+        size_t len = read_u32(data + pos);
+        const unsigned char *type = data + pos + 4;
+        if (len > size - pos - PNG_CHUNK_OVERHEAD)
+        {
+            return false;
+        }
+
+        uLong crc = crc32(crc32(0L, Z_NULL, 0), type, (uInt)(len + 4));
+        if (crc != read_u32(type + 4 + len))
+        {
+            return false;
+        }
+
+        if (memcmp(type, "IDAT", 4) == 0)
+        {
+            /* The image data must be one consecutive run of IDAT chunks. */
+            if (seen_idat)
+            {
+                return false;
+            }
+            seen_idat = true;
+
+            byte_buffer_t compressed = { 0 };
+            while (size - pos >= PNG_CHUNK_OVERHEAD && memcmp(data + pos + 4, "IDAT", 4) == 0)
+            {
+                size_t idat_len = read_u32(data + pos);
+                const unsigned char *idat = data + pos + 8;
+                if (idat_len > size - pos - PNG_CHUNK_OVERHEAD ||
+                    crc32(crc32(0L, Z_NULL, 0), idat - 4, (uInt)(idat_len + 4)) !=
+                      read_u32(idat + idat_len) ||
+                    !bytes_append(&compressed, idat, idat_len))
+                {
+                    free(compressed.data);
+                    return false;
+                }
+                pos += idat_len + PNG_CHUNK_OVERHEAD;
+            }
+
+            byte_buffer_t raw = { 0 };
+            byte_buffer_t recompressed = { 0 };
+            bool ok = compressed.size <= UINT_MAX && raw_limit > 0 &&
+                      inflate_all(&compressed, &raw, raw_limit) && raw.size <= raw_limit &&
+                      deflate_best(&raw, &recompressed);
+            const byte_buffer_t *chosen =
+              ok && recompressed.size < compressed.size ? &recompressed : &compressed;
+
+            ok = ok && append_chunk(out, (const unsigned char *)"IDAT", chosen->data, chosen->size);
+
+            free(compressed.data);
+            free(raw.data);
+            free(recompressed.data);
+            if (!ok)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        seen_iend = memcmp(type, "IEND", 4) == 0;
+        if (!is_stripped_chunk(type) && !bytes_append(out, data + pos, len + PNG_CHUNK_OVERHEAD))
+        {
+            return false;
+        }
+        pos += len + PNG_CHUNK_OVERHEAD;
+    }
+
+    return seen_idat && seen_iend;
+}
+
+/* Anything that does not start with the PNG signature is turned away after reading 8 bytes. */
+static bool
+read_png_file(const char *file_path, unsigned char **data, size_t *size)
+{
+    FILE *file = fopen(file_path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    unsigned char signature[PNG_SIGNATURE_SIZE];
+    if (fstat(fileno(file), &file_stat) != 0 || file_stat.st_size <= PNG_SIGNATURE_SIZE ||
+        file_stat.st_size > MAX_OPTIMIZE_INPUT_BYTES ||
+        fread(signature, 1, PNG_SIGNATURE_SIZE, file) != PNG_SIGNATURE_SIZE ||
+        memcmp(signature, png_signature, PNG_SIGNATURE_SIZE) != 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    *size = (size_t)file_stat.st_size;
+    *data = malloc(*size);
+    bool ok = *data != NULL;
+    if (ok)
+    {
+        memcpy(*data, signature, PNG_SIGNATURE_SIZE);
+        size_t rest = *size - PNG_SIGNATURE_SIZE;
+        ok = fread(*data + PNG_SIGNATURE_SIZE, 1, rest, file) == rest;
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        free(*data);
+        *data = NULL;
+    }
+    return ok;
+}
+
+/* Written under a private directory so the upload keeps the original file name. */
+static char *
+write_optimized_copy(const char *file_path, const byte_buffer_t *contents)
+{
+    const char *cache_dir = get_cache_dir();
+    char *filename = get_filename_from_path(file_path);
+    if (!cache_dir || !filename)
+    {
+        free(filename);
+        return NULL;
+    }
+
+    size_t dir_len = strlen(cache_dir) + strlen("/optimize-XXXXXX") + 1;
+    char *dir = malloc(dir_len);
+    char *path = malloc(dir_len + strlen(filename) + 1);
+    if (!dir || !path)
+    {
+        free(filename);
+        free(dir);
+        free(path);
+        return NULL;
+    }
+
+    snprintf(dir, dir_len, "%s/optimize-XXXXXX", cache_dir);
+
+    if (!mkdtemp(dir))
+    {
+        log_warn("Failed to create directory for optimized copy of %s", file_path);
+        free(filename);
+        free(dir);
+        free(path);
+        return NULL;
+    }
+
+    snprintf(path, dir_len + strlen(filename) + 1, "%s/%s", dir, filename);
+    free(filename);
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file && fwrite(contents->data, 1, contents->size, file) == contents->size;
+    if (file && fclose(file) != 0)
+    {
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        log_warn("Failed to write optimized copy of %s", file_path);
+        unlink(path);
+        rmdir(dir);
+        free(path);
+        path = NULL;
+    }
+
+    free(dir);
+    return path;
+}
+
+bool
+optimize_enabled(const char *mode)
+{
+    return mode && strcmp(mode, "lossless") == 0;
+}
+
+bool
+optimize_file(const char *file_path, optimize_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    unsigned char *data = NULL;
+    size_t size = 0;
+    if (!read_png_file(file_path, &data, &size))
+    {
+        result->upload_path = strdup(file_path);
+        return false;
+    }
+
+    result->original_size = size;
+    result->optimized_size = size;
+
+    byte_buffer_t out = { 0 };
+    double start_ms = monotonic_ms();
+    if (optimize_png(data, size, &out) && out.size < size)
+    {
+        result->upload_path = write_optimized_copy(file_path, &out);
+        if (result->upload_path)
+        {
+            result->optimized = true;
+            result->optimized_size = out.size;
+            log_info("Optimized %s from %zu to %zu bytes in %.1f ms",
+                     file_path,
+                     size,
+                     out.size,
+                     monotonic_ms() - start_ms);
+        }
+    }
+
+    free(out.data);
+    free(data);
+
+    if (!result->upload_path)
+    {
+        result->upload_path = strdup(file_path);
+    }
+    return result->optimized;
+}
+
+void
+optimize_result_free(optimize_result_t *result)
+{
+    if (!result)
+    {
+        return;
+    }
+
+    if (result->optimized && result->upload_path)
+    {
+        unlink(result->upload_path);
+        char *slash = strrchr(result->upload_path, '/');
+        if (slash)
+        {
+            *slash = '\0';
+            rmdir(result->upload_path);
+        }
+    }
+
+    free(result->upload_path);
+    memset(result, 0, sizeof(*result));
+}
+
+static void *
+optimize_worker(void *arg)
+{
+    optimize_pool_t *pool = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->cancel || pool->next >= pool->file_count)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        int index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        optimize_result_t result;
+        optimize_file(pool->file_paths[index], &result);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->results[index] = result;
+        pool->done[index] = true;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Optimize file_paths in order on a few worker threads. Results become available one by one
+ * through optimize_pool_result, so uploads can start while later files are still being
+ * processed. file_paths must stay valid until optimize_pool_free.
+ */
+optimize_pool_t *
+optimize_pool_start(char **file_paths, int file_count, int workers)
+{
+    if (file_count <= 0)
+    {
+        return NULL;
+    }
+
+    if (workers <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers > MAX_OPTIMIZE_WORKERS)
+    {
+        workers = MAX_OPTIMIZE_WORKERS;
+    }
+    if (workers > file_count)
+    {
+        workers = file_count;
+    }
+
+    optimize_pool_t *pool = calloc(1, sizeof(optimize_pool_t));
+    if (!pool)
+    {
+        log_error("Failed to allocate optimizer pool");
+        return NULL;
+    }
+
+    pool->file_paths = file_paths;
+    pool->file_count = file_count;
+    pool->results = calloc(file_count, sizeof(optimize_result_t));
+    pool->done = calloc(file_count, sizeof(bool));
+    pool->threads = calloc(workers, sizeof(pthread_t));
+    if (!pool->results || !pool->done || !pool->threads)
+    {
+        log_error("Failed to allocate optimizer pool");
+        free(pool->results);
+        free(pool->done);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+
+    for (int i = 0; i < workers; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, optimize_worker, pool) != 0)
+        {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0)
+    {
+        log_warn("Failed to start optimizer threads, optimizing inline");
+        optimize_worker(pool);
+    }
+
+    return pool;
+}
+
+/* The result for one file, or NULL while it is still being processed. */
+const optimize_result_t *
+optimize_pool_result(optimize_pool_t *pool, int index)
+{
+    if (!pool || index < 0 || index >= pool->file_count)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    const optimize_result_t *result = pool->done[index] ? &pool->results[index] : NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    return result;
+}
+
+void
+optimize_pool_free(optimize_pool_t *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->cancel = true;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->file_count; i++)
+    {
+        if (pool->done[i])
+        {
+            optimize_result_free(&pool->results[i]);
+        }
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->results);
+    free(pool->done);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,266 @@
+#include "hostman/core/output.h"
+#include "hostman/core/logging.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int record_fd = -1;
+static FILE *data_stream = NULL;
+
+/* The record being built; kept between records so its buffer is reused. */
+static char *record = NULL;
+static size_t record_size = 0;
+static size_t record_capacity = 0;
+static bool record_failed = false;
+
+/* Route stdout to /dev/null and keep the original descriptor for records. */
+bool
+output_set_json(void)
+{
+    if (record_fd >= 0)
+    {
+        return true;
+    }
+
+    /* Close-on-exec, so a spawned helper such as a clipboard tool cannot hold the stream open. */
+    fflush(stdout);
+    int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        log_error("Failed to duplicate stdout: %s", strerror(errno));
+        return false;
+    }
+    if (!freopen("/dev/null", "w", stdout))
+    {
+        log_error("Failed to redirect stdout: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    record_fd = fd;
+    return true;
+}
+
+bool
+output_json(void)
+{
+    return record_fd >= 0;
+}
+
+/* Where bulk data such as a history export goes: the real stdout in either mode. */
+FILE *
+output_stream(void)
+{
+    if (record_fd < 0)
+    {
+        return stdout;
+    }
+    if (!data_stream)
+    {
+        int fd = fcntl(record_fd, F_DUPFD_CLOEXEC, 0);
+        data_stream = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (!data_stream)
+        {
+            log_error("Failed to open the output stream: %s", strerror(errno));
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+    return data_stream;
+}
+
+static void
+record_write(const char *data, size_t size)
+{
+    if (record_failed)
+    {
+        return;
+    }
+
+    if (record_size + size > record_capacity)
+    {
+        size_t capacity = record_capacity > 0 ? record_capacity : OUTPUT_RECORD_INITIAL_CAPACITY;
+        while (capacity < record_size + size)
+        {
+            capacity *= 2;
+        }
+
+        char *ptr = realloc(record, capacity);
+        if (!ptr)
+        {
+            log_error("Failed to allocate memory for output record");
+            record_failed = true;
+            return;
+        }
+        record = ptr;
+        record_capacity = capacity;
+    }
+
+    memcpy(record + record_size, data, size);
+    record_size += size;
+}
+
+static void
+record_puts(const char *text)
+{
+    record_write(text, strlen(text));
+}
+
+/* The JSON escape for c, or NULL when c can be written as it is. */
+const char *
+json_escape(unsigned char c, char escape[8])
+{
+    switch (c)
+    {
+        case '"':
+            return "\\\"";
+        case '\\':
+            return "\\\\";
+        case '\n':
+            return "\\n";
+        case '\r':
+            return "\\r";
+        case '\t':
+            return "\\t";
+        default:
+            if (c < 0x20)
+            {
+                snprintf(escape, 8, "\\u%04x", c);
+                return escape;
+            }
+            return NULL;
+    }
+}
+
+static void
+record_json_string(const char *value)
+{
+    if (!value)
+    {
+        record_puts("null");
+        return;
+    }
+
+    record_puts("\"");
+    const char *run = value;
+    for (const char *p = value; *p; p++)
+    {
+        char buffer[8];
+        const char *escape = json_escape((unsigned char)*p, buffer);
+        if (escape)
+        {
+            record_write(run, (size_t)(p - run));
+            record_puts(escape);
+            run = p + 1;
+        }
+    }
+    record_puts(run);
+    record_puts("\"");
+}
+
+static void
+record_key(const char *key)
+{
+    record_puts(",\"");
+    record_puts(key);
+    record_puts("\":");
+}
+
+void
+output_begin(const char *type)
+{
+    pthread_mutex_lock(&output_mutex);
+    record_size = 0;
+    record_failed = false;
+    record_puts("{\"type\":");
+    record_json_string(type);
+}
+
+void
+output_string(const char *key, const char *value)
+{
+    record_key(key);
+    record_json_string(value);
+}
+
+void
+output_int(const char *key, long long value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "%lld", value);
+    record_key(key);
+    record_puts(number);
+}
+
+void
+output_real(const char *key, double value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "%.3f", value);
+    record_key(key);
+    record_puts(number);
+}
+
+void
+output_bool(const char *key, bool value)
+{
+    record_key(key);
+    record_puts(value ? "true" : "false");
+}
+
+void
+output_null(const char *key)
+{
+    record_key(key);
+    record_puts("null");
+}
+
+void
+output_end(void)
+{
+    record_puts("}\n");
+
+    /* In text mode records are dropped; the caller has already printed its own output. */
+    if (!record_failed && record_fd >= 0)
+    {
+        size_t written = 0;
+        while (written < record_size)
+        {
+            ssize_t result = write(record_fd, record + written, record_size - written);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            written += (size_t)result;
+        }
+    }
+
+    pthread_mutex_unlock(&output_mutex);
+}
+
+void
+output_cleanup(void)
+{
+    pthread_mutex_lock(&output_mutex);
+    if (data_stream)
+    {
+        fclose(data_stream);
+        data_stream = NULL;
+    }
+    if (record_fd >= 0)
+    {
+        close(record_fd);
+        record_fd = -1;
+    }
+    free(record);
+    record = NULL;
+    record_size = 0;
+    record_capacity = 0;
+    pthread_mutex_unlock(&output_mutex);
+}
@@ -0,0 +1,229 @@
+#include "hostman/core/progress.h"
+#include "hostman/core/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PROGRESS_BAR_WIDTH 30
+#define PROGRESS_LABEL_WIDTH 20
+#define PROGRESS_EWMA_ALPHA 0.3
+#define PROGRESS_LINE_MAX 256
+
+typedef struct
+{
+    bool active;
+    char label[PROGRESS_LABEL_WIDTH + 1];
+    int64_t current;
+    int64_t total;
+    double sample_ms;
+    int64_t sample_bytes;
+    double rate;
+} progress_bar_t;
+
+static progress_bar_t *bars = NULL;
+static int bar_capacity = 0;
+static int drawn_lines = 0;
+static double last_frame_ms = 0;
+static int tty_state = -1;
+
+bool
+progress_enabled(void)
+{
+    if (tty_state < 0)
+    {
+        tty_state = isatty(STDERR_FILENO) ? 1 : 0;
+    }
+    return tty_state == 1;
+}
+
+int
+progress_add_bar(const char *label)
+{
+    if (!progress_enabled())
+    {
+        return -1;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < bar_capacity; i++)
+    {
+        if (!bars[i].active)
+        {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot < 0)
+    {
+        int new_capacity = bar_capacity == 0 ? 4 : bar_capacity * 2;
+        progress_bar_t *new_bars = realloc(bars, new_capacity * sizeof(progress_bar_t));
+        if (!new_bars)
+        {
+            return -1;
+        }
+        memset(new_bars + bar_capacity, 0, (new_capacity - bar_capacity) * sizeof(progress_bar_t));
+        slot = bar_capacity;
+        bars = new_bars;
+        bar_capacity = new_capacity;
+    }
+
+    progress_bar_t *bar = &bars[slot];
+    memset(bar, 0, sizeof(*bar));
+    bar->active = true;
+    snprintf(bar->label, sizeof(bar->label), "%s", label ? label : "Uploading");
+    bar->sample_ms = monotonic_ms();
+
+    return slot;
+}
+
+static void
+format_eta(double seconds, char *buffer, size_t buffer_size)
+{
+    long total = (long)(seconds + 0.5);
+    if (total >= 3600)
+        snprintf(buffer, buffer_size, "%ld:%02ld:%02ld", total / 3600, total / 60 % 60, total % 60);
+    else
+        snprintf(buffer, buffer_size, "%ld:%02ld", total / 60, total % 60);
+}
+
+static size_t
+render_bar(const progress_bar_t *bar, char *out, size_t out_size)
+{
+    double percent = bar->total > 0 ? (double)bar->current / (double)bar->total * 100.0 : 0.0;
+    int pos = (int)(PROGRESS_BAR_WIDTH * percent / 100.0);
+
+    char gauge[PROGRESS_BAR_WIDTH + 1];
+    for (int i = 0; i < PROGRESS_BAR_WIDTH; i++)
+    {
+        gauge[i] = i < pos ? '=' : (i == pos ? '>' : ' ');
+    }
+    gauge[PROGRESS_BAR_WIDTH] = '\0';
+
+    char current_str[32], total_str[32];
+    format_file_size(bar->current, current_str, sizeof(current_str));
+    format_file_size(bar->total, total_str, sizeof(total_str));
+
+    int len = snprintf(out,
+                       out_size,
+                       "%-*s [%s] %5.1f%% (%s / %s)",
+                       PROGRESS_LABEL_WIDTH,
+                       bar->label,
+                       gauge,
+                       percent,
+                       current_str,
+                       total_str);
+
+    if (bar->rate > 0 && len > 0 && (size_t)len < out_size)
+    {
+        char speed_str[32], eta_str[16];
+        format_file_size((size_t)bar->rate, speed_str, sizeof(speed_str));
+        format_eta((bar->total - bar->current) / bar->rate, eta_str, sizeof(eta_str));
+        len += snprintf(out + len, out_size - len, " - %s/s ETA %s", speed_str, eta_str);
+    }
+
+    if (len < 0)
+        return 0;
+    return (size_t)len < out_size ? (size_t)len : out_size - 1;
+}
+
+/* Redraw every active bar in a single write(); stdio would split a frame across syscalls. */
+static void
+render_frame(void)
+{
+    int active = 0;
+    for (int i = 0; i < bar_capacity; i++)
+    {
+        if (bars[i].active)
+            active++;
+    }
+
+    size_t frame_size = 32 + (size_t)active * (PROGRESS_LINE_MAX + 8);
+    char stack_frame[2048];
+    char *frame = frame_size <= sizeof(stack_frame) ? stack_frame : malloc(frame_size);
+    if (!frame)
+        return;
+
+    size_t len = 0;
+    if (drawn_lines > 0)
+    {
+        len += snprintf(frame + len, frame_size - len, "\033[%dA", drawn_lines);
+    }
+    len += snprintf(frame + len, frame_size - len, "\r\033[J");
+
+    for (int i = 0; i < bar_capacity; i++)
+    {
+        if (!bars[i].active)
+            continue;
+        len += render_bar(&bars[i], frame + len, PROGRESS_LINE_MAX);
+        frame[len++] = '\n';
+    }
+
+    ssize_t written = write(STDERR_FILENO, frame, len);
+    (void)written;
+    drawn_lines = active;
+
+    if (frame != stack_frame)
+        free(frame);
+}
+
+void
+progress_update(int bar_index, int64_t current, int64_t total)
+{
+    if (bar_index < 0 || bar_index >= bar_capacity || !bars[bar_index].active)
+    {
+        return;
+    }
+
+    progress_bar_t *bar = &bars[bar_index];
+    double now = monotonic_ms();
+    bool completed = total > 0 && current == total && bar->current != current;
+
+    bar->current = current;
+    bar->total = total;
+
+    double elapsed = now - bar->sample_ms;
+    if (elapsed >= MIN_PROGRESS_UPDATE_MS)
+    {
+        double instant = (current - bar->sample_bytes) * 1000.0 / elapsed;
+        bar->rate = bar->rate == 0 ? instant
+                                   : PROGRESS_EWMA_ALPHA * instant +
+                                       (1.0 - PROGRESS_EWMA_ALPHA) * bar->rate;
+        bar->sample_ms = now;
+        bar->sample_bytes = current;
+    }
+
+    if (now - last_frame_ms >= MIN_PROGRESS_UPDATE_MS || completed)
+    {
+        last_frame_ms = now;
+        render_frame();
+    }
+}
+
+void
+progress_remove_bar(int bar_index)
+{
+    if (bar_index < 0 || bar_index >= bar_capacity || !bars[bar_index].active)
+    {
+        return;
+    }
+
+    bars[bar_index].active = false;
+    render_frame();
+}
+
+void
+progress_clear(void)
+{
+    if (drawn_lines == 0)
+    {
+        return;
+    }
+
+    char frame[32];
+    int len = snprintf(frame, sizeof(frame), "\033[%dA\r\033[J", drawn_lines);
+    ssize_t written = write(STDERR_FILENO, frame, len);
+    (void)written;
+    drawn_lines = 0;
+}
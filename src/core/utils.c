@@ -1,10 +1,12 @@
 #include "hostman/core/utils.h"
 #include "hostman/core/logging.h"
 #include <math.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef USE_CJSON
@@ -55,17 +57,18 @@ format_file_size(size_t size, char *buffer, size_t buffer_size)
     }
 }
 
-char *
-get_config_dir(void)
+/* $<xdg_variable>/hostman, or $HOME<home_suffix> when the variable is unset. */
+static char *
+resolve_dir(const char *xdg_variable, const char *home_suffix)
 {
-    const char *xdg_config = getenv("XDG_CONFIG_HOME");
-    if (xdg_config && *xdg_config)
+    const char *xdg = getenv(xdg_variable);
+    if (xdg && *xdg)
     {
-        size_t len = strlen(xdg_config) + strlen("/hostman") + 1;
+        size_t len = strlen(xdg) + strlen("/hostman") + 1;
         char *dir = malloc(len);
         if (dir)
         {
-            snprintf(dir, len, "%s/hostman", xdg_config);
+            snprintf(dir, len, "%s/hostman", xdg);
             return dir;
         }
     }
@@ -84,57 +87,53 @@ get_config_dir(void)
         }
     }
 
-    size_t len = strlen(home) + strlen("/.config/hostman") + 1;
+    size_t len = strlen(home) + strlen(home_suffix) + 1;
     char *dir = malloc(len);
     if (dir)
     {
-        snprintf(dir, len, "%s/.config/hostman", home);
+        snprintf(dir, len, "%s%s", home, home_suffix);
     }
 
     return dir;
 }
 
-char *
-get_cache_dir(void)
+static pthread_once_t dirs_once = PTHREAD_ONCE_INIT;
+static char *config_dir = NULL;
+static char *cache_dir = NULL;
+
+static void
+resolve_dirs(void)
 {
-    const char *xdg_cache = getenv("XDG_CACHE_HOME");
-    if (xdg_cache && *xdg_cache)
-    {
-        size_t len = strlen(xdg_cache) + strlen("/hostman") + 1;
-        char *dir = malloc(len);
-        if (dir)
-        {
-            snprintf(dir, len, "%s/hostman", xdg_cache);
-            return dir;
-        }
-    }
+    config_dir = resolve_dir("XDG_CONFIG_HOME", "/.config/hostman");
+    cache_dir = resolve_dir("XDG_CACHE_HOME", "/.cache/hostman");
+}
 
-    const char *home = getenv("HOME");
-    if (!home || !*home)
-    {
-        struct passwd *pwd = getpwuid(getuid());
-        if (pwd)
-        {
-            home = pwd->pw_dir;
-        }
-        else
-        {
-            return NULL;
-        }
-    }
+/* Resolved on first use and kept for the life of the process; callers must not free it. */
+const char *
+get_config_dir(void)
+{
+    pthread_once(&dirs_once, resolve_dirs);
+    return config_dir;
+}
 
-    size_t len = strlen(home) + strlen("/.cache/hostman") + 1;
-    char *dir = malloc(len);
-    if (dir)
-    {
-        snprintf(dir, len, "%s/.cache/hostman", home);
-    }
+const char *
+get_cache_dir(void)
+{
+    pthread_once(&dirs_once, resolve_dirs);
+    return cache_dir;
+}
 
-    return dir;
+double
+monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
 }
 
+/* The string at a dotted path such as "data.url", copied into the arena. */
 char *
-extract_json_string(const char *json, const char *path)
+extract_json_string(arena_t *arena, const char *json, const char *path)
 {
     if (!json || !path)
     {
@@ -151,8 +150,8 @@ extract_json_string(const char *json, const char *path)
         return NULL;
     }
 
-    char *path_copy = strdup(path);
-    char *token = strtok(path_copy, ".");
+    char *path_copy = arena_strdup(arena, path);
+    char *token = path_copy ? strtok(path_copy, ".") : NULL;
     cJSON *current = root;
 
     while (token && current)
@@ -163,10 +162,9 @@ extract_json_string(const char *json, const char *path)
 
     if (current && cJSON_IsString(current))
     {
-        result = strdup(current->valuestring);
+        result = arena_strdup(arena, current->valuestring);
     }
 
-    free(path_copy);
     cJSON_Delete(root);
 #else
     json_error_t error;
@@ -177,8 +175,8 @@ extract_json_string(const char *json, const char *path)
         return NULL;
     }
 
-    char *path_copy = strdup(path);
-    char *token = strtok(path_copy, ".");
+    char *path_copy = arena_strdup(arena, path);
+    char *token = path_copy ? strtok(path_copy, ".") : NULL;
     json_t *current = root;
 
     while (token && current)
@@ -189,102 +187,15 @@ extract_json_string(const char *json, const char *path)
 
     if (current && json_is_string(current))
     {
-        result = strdup(json_string_value(current));
+        result = arena_strdup(arena, json_string_value(current));
     }
 
-    free(path_copy);
     json_decref(root);
 #endif
 
     return result;
 }
 
-static const char *
-detect_clipboard_manager(void)
-{
-    const char *managers[] = {
-        "wl-copy",            // Wayland
-        "xclip",              // X11
-        "xsel",               // X11 alternative
-        "pbcopy",             // macOS
-        "clip.exe",           // Windows (i think wsl too)
-        "fish_clipboard_copy" // Fish shell (im desperate)
-    };
-
-    static char command_found[32] = { 0 };
-
-    if (command_found[0] != '\0')
-    {
-        return command_found;
-    }
-
-    for (size_t i = 0; i < sizeof(managers) / sizeof(managers[0]); i++)
-    {
-        char which_cmd[128];
-        snprintf(which_cmd, sizeof(which_cmd), "which %s >/dev/null 2>&1", managers[i]);
-
-        if (system(which_cmd) == 0)
-        {
-            strncpy(command_found, managers[i], sizeof(command_found) - 1);
-            return command_found;
-        }
-    }
-
-    return NULL;
-}
-
-const char *
-get_clipboard_manager_name(void)
-{
-    return detect_clipboard_manager();
-}
-
-bool
-copy_to_clipboard(const char *text)
-{
-    if (!text)
-        return false;
-
-    const char *clipboard_cmd = detect_clipboard_manager();
-    if (!clipboard_cmd)
-    {
-        return false;
-    }
-
-    char cmd[1024];
-
-    if (strcmp(clipboard_cmd, "wl-copy") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | wl-copy", text);
-    }
-    else if (strcmp(clipboard_cmd, "xclip") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | xclip -selection clipboard", text);
-    }
-    else if (strcmp(clipboard_cmd, "xsel") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | xsel -ib", text);
-    }
-    else if (strcmp(clipboard_cmd, "pbcopy") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | pbcopy", text);
-    }
-    else if (strcmp(clipboard_cmd, "clip.exe") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | clip.exe", text);
-    }
-    else if (strcmp(clipboard_cmd, "fish_clipboard_copy") == 0)
-    {
-        snprintf(cmd, sizeof(cmd), "echo -n '%s' | fish_clipboard_copy", text);
-    }
-    else
-    {
-        return false;
-    }
-
-    return (system(cmd) == 0);
-}
-
 void
 print_version_info(void)
 {
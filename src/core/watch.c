@@ -0,0 +1,223 @@
+#include "hostman/core/watch.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+static volatile sig_atomic_t stop_requested = 0;
+
+#ifdef __linux__
+
+typedef struct
+{
+    char **paths;
+    int count;
+    int capacity;
+} pending_files_t;
+
+static void
+handle_stop_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void
+pending_add(pending_files_t *pending, const char *dir_path, const char *name)
+{
+    /* Editors and downloaders write to hidden temp files first; wait for the real name. */
+    if (name[0] == '.')
+    {
+        return;
+    }
+
+    size_t len = strlen(dir_path) + strlen(name) + 2;
+    char *path = malloc(len);
+    if (!path)
+    {
+        log_error("Failed to allocate memory for watched file path");
+        return;
+    }
+    snprintf(path, len, "%s/%s", dir_path, name);
+
+    /* A file rewritten within one burst is only uploaded once. */
+    for (int i = 0; i < pending->count; i++)
+    {
+        if (strcmp(pending->paths[i], path) == 0)
+        {
+            free(path);
+            return;
+        }
+    }
+
+    if (pending->count >= pending->capacity)
+    {
+        int capacity = pending->capacity == 0 ? 16 : pending->capacity * 2;
+        char **paths = realloc(pending->paths, capacity * sizeof(char *));
+        if (!paths)
+        {
+            log_error("Failed to allocate memory for watched files");
+            free(path);
+            return;
+        }
+        pending->paths = paths;
+        pending->capacity = capacity;
+    }
+
+    pending->paths[pending->count++] = path;
+}
+
+static void
+pending_clear(pending_files_t *pending)
+{
+    for (int i = 0; i < pending->count; i++)
+    {
+        free(pending->paths[i]);
+    }
+    pending->count = 0;
+}
+
+bool
+watch_supported(void)
+{
+    return true;
+}
+
+bool
+watch_directory(const char *dir_path,
+                int debounce_ms,
+                int idle_ms,
+                watch_callback_t callback,
+                void *userdata)
+{
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0)
+    {
+        log_error("Failed to initialize inotify: %s", strerror(errno));
+        return false;
+    }
+
+    if (inotify_add_watch(fd, dir_path, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        log_error("Failed to watch directory %s: %s", dir_path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    struct sigaction action = { 0 };
+    struct sigaction old_int;
+    struct sigaction old_term;
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    stop_requested = 0;
+
+    log_info("Watching %s for new files", dir_path);
+
+    pending_files_t pending = { 0 };
+    double last_event_ms = 0;
+    bool ok = true;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!stop_requested)
+    {
+        /* Tick every idle_ms while idle; once a burst starts, wake up when it has settled. */
+        int timeout_ms = idle_ms > 0 ? idle_ms : -1;
+        if (pending.count > 0)
+        {
+            timeout_ms = debounce_ms - (int)(monotonic_ms() - last_event_ms);
+            if (timeout_ms < 0)
+                timeout_ms = 0;
+        }
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            log_error("Failed to poll inotify descriptor: %s", strerror(errno));
+            ok = false;
+            break;
+        }
+
+        if (ready > 0)
+        {
+            ssize_t len;
+            while ((len = read(fd, events, sizeof(events))) > 0)
+            {
+                for (char *ptr = events; ptr < events + len;)
+                {
+                    struct inotify_event *event = (struct inotify_event *)ptr;
+                    if (event->len > 0 && !(event->mask & IN_ISDIR))
+                    {
+                        pending_add(&pending, dir_path, event->name);
+                    }
+                    ptr += sizeof(struct inotify_event) + event->len;
+                }
+            }
+            last_event_ms = monotonic_ms();
+            continue;
+        }
+
+        /* Written and then renamed within one burst: only the final name still exists. */
+        int kept = 0;
+        for (int i = 0; i < pending.count; i++)
+        {
+            if (access(pending.paths[i], F_OK) == 0)
+                pending.paths[kept++] = pending.paths[i];
+            else
+                free(pending.paths[i]);
+        }
+        pending.count = kept;
+
+        bool keep_going = callback(pending.paths, pending.count, userdata);
+        pending_clear(&pending);
+        if (!keep_going)
+            break;
+    }
+
+    pending_clear(&pending);
+    free(pending.paths);
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    close(fd);
+
+    log_info("Stopped watching %s", dir_path);
+    return ok;
+}
+
+#else
+
+bool
+watch_supported(void)
+{
+    return false;
+}
+
+bool
+watch_directory(const char *dir_path,
+                int debounce_ms,
+                int idle_ms,
+                watch_callback_t callback,
+                void *userdata)
+{
+    (void)debounce_ms;
+    (void)idle_ms;
+    (void)callback;
+    (void)userdata;
+    log_error("Cannot watch %s: directory watching requires inotify (Linux)", dir_path);
+    return false;
+}
+
+#endif
@@ -1,16 +1,26 @@
 #include "hostman/cli/cli.h"
 #include "hostman/core/config.h"
 #include "hostman/core/logging.h"
+#include "hostman/core/output.h"
 #include "hostman/core/utils.h"
 #include "hostman/crypto/encryption.h"
 #include "hostman/network/network.h"
 #include "hostman/storage/database.h"
+#include "hostman/storage/retention.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+/* The config stays cached, so the command that runs next does not parse it again. */
+static size_t
+configured_max_response_bytes(void)
+{
+    hostman_config_t *config = config_load();
+    return config && config->max_response_size > 0 ? (size_t)config->max_response_size : 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -33,7 +43,7 @@ main(int argc, char *argv[])
         return run_setup_wizard();
     }
 
-    if (!encryption_init() || !network_init() || !db_init())
+    if (!encryption_init() || !network_init(configured_max_response_bytes()) || !db_init())
     {
         log_error("Failed to initialize one or more required systems");
         return EXIT_FAILURE;
@@ -43,7 +53,17 @@ main(int argc, char *argv[])
 
     int result = execute_command(&args);
 
+    /* Only commands that add to the history and the queue follow up with a retention pass. */
+    if (args.type == CMD_UPLOAD ||
+        (args.type == CMD_QUEUE && args.command_name && strcmp(args.command_name, "run") == 0))
+    {
+        hostman_config_t *config = config_load();
+        retention_maintain(config);
+        config_free(config);
+    }
+
     free_command_args(&args);
+    output_cleanup();
     encryption_cleanup();
     network_cleanup();
     db_close();
@@ -0,0 +1,92 @@
+#include "hostman/network/buffer.h"
+#include "hostman/core/logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool
+response_buffer_init(response_buffer_t *buffer, size_t initial_capacity, size_t max_size)
+{
+    buffer->size = 0;
+    buffer->max_size = max_size;
+    buffer->overflow = false;
+    buffer->capacity = initial_capacity > 0 ? initial_capacity : RESPONSE_BUFFER_INITIAL_CAPACITY;
+
+    buffer->data = malloc(buffer->capacity);
+    if (!buffer->data)
+    {
+        log_error("Failed to allocate memory for response buffer");
+        buffer->capacity = 0;
+        return false;
+    }
+
+    buffer->data[0] = '\0';
+    return true;
+}
+
+void
+response_buffer_reset(response_buffer_t *buffer)
+{
+    buffer->size = 0;
+    buffer->overflow = false;
+    if (buffer->data)
+    {
+        buffer->data[0] = '\0';
+    }
+}
+
+bool
+response_buffer_append(response_buffer_t *buffer, const void *data, size_t len)
+{
+    size_t needed = buffer->size + len + 1;
+
+    if (buffer->max_size > 0 && buffer->size + len > buffer->max_size)
+    {
+        /* Not logged here: the caller turns this into a proper error for the transfer. */
+        buffer->overflow = true;
+        return false;
+    }
+
+    if (needed > buffer->capacity)
+    {
+        size_t new_capacity = buffer->capacity > 0 ? buffer->capacity : RESPONSE_BUFFER_INITIAL_CAPACITY;
+        while (new_capacity < needed)
+        {
+            new_capacity *= 2;
+        }
+
+        char *ptr = realloc(buffer->data, new_capacity);
+        if (!ptr)
+        {
+            log_error("Failed to allocate memory for response data");
+            return false;
+        }
+
+        buffer->data = ptr;
+        buffer->capacity = new_capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, len);
+    buffer->size += len;
+    buffer->data[buffer->size] = '\0';
+
+    return true;
+}
+
+size_t
+response_buffer_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t real_size = size * nmemb;
+    response_buffer_t *buffer = (response_buffer_t *)userp;
+
+    /* Returning short makes curl abort the transfer with CURLE_WRITE_ERROR. */
+    return response_buffer_append(buffer, contents, real_size) ? real_size : 0;
+}
+
+void
+response_buffer_free(response_buffer_t *buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
@@ -0,0 +1,547 @@
+#include "hostman/network/compress.h"
+#include "hostman/core/logging.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <zlib.h>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * A compressor thread reads the file and pushes compressed bytes into a bounded pipe that
+ * curl's read callback drains, so compression runs alongside the socket writes and memory
+ * stays at COMPRESS_PIPE_SIZE however large the file is.
+ */
+struct compress_stream
+{
+    char *file_path;
+    FILE *file;
+    compress_codec_t codec;
+
+    unsigned char *pipe;
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+    pthread_t thread;
+
+    bool finished;
+    bool failed;
+    bool cancel;
+    bool started_reading;
+    /* Set for streams read from a multi: reads pause instead of blocking and wake it later. */
+    CURLM *multi;
+    bool paused;
+    size_t total_in;
+    size_t bytes_in;
+    size_t bytes_out;
+    double cpu_ms;
+};
+
+/* Leading bytes of formats that are already compressed and would only grow. */
+static const struct
+{
+    size_t offset;
+    size_t length;
+    const char *bytes;
+} compressed_magic[] = {
+    { 0, 2, "\x1f\x8b" },             /* gzip */
+    { 0, 4, "\x28\xb5\x2f\xfd" },     /* zstd */
+    { 0, 4, "PK\x03\x04" },           /* zip, jar, docx, apk */
+    { 0, 6, "\xfd" "7zXZ\x00" },      /* xz */
+    { 0, 3, "BZh" },                  /* bzip2 */
+    { 0, 6, "7z\xbc\xaf\x27\x1c" },   /* 7z */
+    { 0, 8, "\x89PNG\r\n\x1a\n" },    /* png */
+    { 0, 3, "\xff\xd8\xff" },         /* jpeg */
+    { 0, 4, "GIF8" },                 /* gif */
+    { 8, 4, "WEBP" },                 /* webp */
+    { 4, 4, "ftyp" },                 /* mp4, mov, heic, avif */
+    { 0, 4, "\x1a\x45\xdf\xa3" },     /* mkv, webm */
+    { 0, 4, "OggS" },                 /* ogg, opus */
+    { 0, 3, "ID3" },                  /* mp3 */
+    { 0, 4, "fLaC" },                 /* flac */
+    { 0, 4, "%PDF" },                 /* pdf streams are usually deflated */
+};
+
+compress_codec_t
+compress_codec_from_name(const char *name)
+{
+    if (!name)
+    {
+        return COMPRESS_NONE;
+    }
+    if (strcmp(name, "gzip") == 0)
+    {
+        return COMPRESS_GZIP;
+    }
+    if (strcmp(name, "zstd") == 0)
+    {
+        return COMPRESS_ZSTD;
+    }
+    return COMPRESS_NONE;
+}
+
+bool
+compress_codec_available(compress_codec_t codec)
+{
+#ifdef USE_ZSTD
+    (void)codec;
+    return true;
+#else
+    return codec != COMPRESS_ZSTD;
+#endif
+}
+
+const char *
+compress_codec_name(compress_codec_t codec)
+{
+    switch (codec)
+    {
+        case COMPRESS_GZIP:
+            return "gzip";
+        case COMPRESS_ZSTD:
+            return "zstd";
+        default:
+            return "identity";
+    }
+}
+
+const char *
+compress_codec_suffix(compress_codec_t codec)
+{
+    switch (codec)
+    {
+        case COMPRESS_GZIP:
+            return ".gz";
+        case COMPRESS_ZSTD:
+            return ".zst";
+        default:
+            return "";
+    }
+}
+
+const char *
+compress_codec_mime_type(compress_codec_t codec)
+{
+    switch (codec)
+    {
+        case COMPRESS_GZIP:
+            return "application/gzip";
+        case COMPRESS_ZSTD:
+            return "application/zstd";
+        default:
+            return "application/octet-stream";
+    }
+}
+
+bool
+compress_worthwhile(const char *file_path)
+{
+    FILE *file = fopen(file_path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    unsigned char header[16] = { 0 };
+    size_t read = fread(header, 1, sizeof(header), file);
+
+    struct stat file_stat;
+    bool large_enough =
+      fstat(fileno(file), &file_stat) == 0 && file_stat.st_size >= COMPRESS_MIN_FILE_SIZE;
+    fclose(file);
+
+    if (!large_enough)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(compressed_magic) / sizeof(compressed_magic[0]); i++)
+    {
+        if (compressed_magic[i].offset + compressed_magic[i].length <= read &&
+            memcmp(header + compressed_magic[i].offset,
+                   compressed_magic[i].bytes,
+                   compressed_magic[i].length) == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Called with the lock held, after making data available or finishing. */
+static void
+wake_reader(compress_stream_t *stream)
+{
+    if (stream->paused && stream->multi)
+    {
+        curl_multi_wakeup(stream->multi);
+    }
+}
+
+static bool
+pipe_write(compress_stream_t *stream, const unsigned char *data, size_t size)
+{
+    while (size > 0)
+    {
+        pthread_mutex_lock(&stream->lock);
+        while (stream->count == COMPRESS_PIPE_SIZE && !stream->cancel)
+        {
+            pthread_cond_wait(&stream->writable, &stream->lock);
+        }
+        if (stream->cancel)
+        {
+            pthread_mutex_unlock(&stream->lock);
+            return false;
+        }
+
+        size_t tail = (stream->head + stream->count) % COMPRESS_PIPE_SIZE;
+        size_t room = COMPRESS_PIPE_SIZE - stream->count;
+        size_t contiguous = COMPRESS_PIPE_SIZE - tail;
+        size_t n = size < room ? size : room;
+        if (n > contiguous)
+        {
+            n = contiguous;
+        }
+
+        memcpy(stream->pipe + tail, data, n);
+        stream->count += n;
+        stream->bytes_out += n;
+        pthread_cond_signal(&stream->readable);
+        wake_reader(stream);
+        pthread_mutex_unlock(&stream->lock);
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static size_t
+read_input(compress_stream_t *stream, unsigned char *buffer, bool *last, bool *ok)
+{
+    size_t n = fread(buffer, 1, COMPRESS_CHUNK_SIZE, stream->file);
+    if (ferror(stream->file))
+    {
+        log_error("Failed to read %s while compressing", stream->file_path);
+        *ok = false;
+    }
+    *last = n < COMPRESS_CHUNK_SIZE;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->bytes_in += n;
+    pthread_mutex_unlock(&stream->lock);
+
+    return n;
+}
+
+static bool
+compress_gzip(compress_stream_t *stream, unsigned char *in, unsigned char *out)
+{
+    z_stream zs = { 0 };
+    /* 16 added to the window bits selects the gzip wrapper instead of raw zlib. */
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    bool last = false;
+    while (ok && !last)
+    {
+        zs.next_in = in;
+        zs.avail_in = (uInt)read_input(stream, in, &last, &ok);
+        int flush = last ? Z_FINISH : Z_NO_FLUSH;
+
+        do
+        {
+            zs.next_out = out;
+            zs.avail_out = COMPRESS_CHUNK_SIZE;
+            if (deflate(&zs, flush) == Z_STREAM_ERROR)
+            {
+                ok = false;
+                break;
+            }
+            ok = ok && pipe_write(stream, out, COMPRESS_CHUNK_SIZE - zs.avail_out);
+        } while (ok && zs.avail_out == 0);
+    }
+
+    deflateEnd(&zs);
+    return ok;
+}
+
+#ifdef USE_ZSTD
+static bool
+compress_zstd(compress_stream_t *stream, unsigned char *in, unsigned char *out)
+{
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (!cctx)
+    {
+        return false;
+    }
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, COMPRESS_ZSTD_LEVEL);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+    bool ok = true;
+    bool last = false;
+    while (ok && !last)
+    {
+        ZSTD_inBuffer input = { in, read_input(stream, in, &last, &ok), 0 };
+        ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+
+        bool done = false;
+        while (ok && !done)
+        {
+            ZSTD_outBuffer output = { out, COMPRESS_CHUNK_SIZE, 0 };
+            size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining))
+            {
+                log_error("zstd compression failed: %s", ZSTD_getErrorName(remaining));
+                ok = false;
+                break;
+            }
+            ok = pipe_write(stream, out, output.pos);
+            done = last ? remaining == 0 : input.pos == input.size;
+        }
+    }
+
+    ZSTD_freeCCtx(cctx);
+    return ok;
+}
+#endif
+
+static double
+thread_cpu_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void *
+compress_worker(void *arg)
+{
+    compress_stream_t *stream = arg;
+    double cpu_start = thread_cpu_ms();
+
+    unsigned char *in = malloc(COMPRESS_CHUNK_SIZE);
+    unsigned char *out = malloc(COMPRESS_CHUNK_SIZE);
+    bool ok = in && out;
+
+    if (ok)
+    {
+#ifdef USE_ZSTD
+        if (stream->codec == COMPRESS_ZSTD)
+            ok = compress_zstd(stream, in, out);
+        else
+#endif
+            ok = compress_gzip(stream, in, out);
+    }
+
+    free(in);
+    free(out);
+
+    pthread_mutex_lock(&stream->lock);
+    stream->finished = true;
+    stream->failed = !ok;
+    stream->cpu_ms = thread_cpu_ms() - cpu_start;
+    pthread_cond_broadcast(&stream->readable);
+    wake_reader(stream);
+    pthread_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+/* Starts compressing straight away, so the first bytes are ready by the time curl connects. */
+compress_stream_t *
+compress_stream_open(const char *file_path, compress_codec_t codec)
+{
+    if (codec == COMPRESS_NONE || !compress_codec_available(codec))
+    {
+        return NULL;
+    }
+
+    compress_stream_t *stream = calloc(1, sizeof(compress_stream_t));
+    if (!stream)
+    {
+        log_error("Failed to allocate compression stream");
+        return NULL;
+    }
+
+    struct stat file_stat;
+    stream->codec = codec;
+    stream->file_path = strdup(file_path);
+    stream->file = fopen(file_path, "rb");
+    stream->pipe = malloc(COMPRESS_PIPE_SIZE);
+    if (!stream->file_path || !stream->file || !stream->pipe ||
+        fstat(fileno(stream->file), &file_stat) != 0)
+    {
+        log_error("Failed to open %s for compression", file_path);
+        if (stream->file)
+            fclose(stream->file);
+        free(stream->file_path);
+        free(stream->pipe);
+        free(stream);
+        return NULL;
+    }
+    stream->total_in = (size_t)file_stat.st_size;
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->readable, NULL);
+    pthread_cond_init(&stream->writable, NULL);
+
+    if (pthread_create(&stream->thread, NULL, compress_worker, stream) != 0)
+    {
+        log_error("Failed to start compression thread for %s", file_path);
+        pthread_cond_destroy(&stream->writable);
+        pthread_cond_destroy(&stream->readable);
+        pthread_mutex_destroy(&stream->lock);
+        fclose(stream->file);
+        free(stream->file_path);
+        free(stream->pipe);
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+/* Reads on a stream attached to a multi never block the other transfers on it. */
+void
+compress_stream_attach_multi(compress_stream_t *stream, CURLM *multi)
+{
+    pthread_mutex_lock(&stream->lock);
+    stream->multi = multi;
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/* True once a paused read can go on; the caller then unpauses the transfer. */
+bool
+compress_stream_resume(compress_stream_t *stream)
+{
+    pthread_mutex_lock(&stream->lock);
+    bool resume = stream->paused && (stream->count > 0 || stream->finished);
+    if (resume)
+    {
+        stream->paused = false;
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return resume;
+}
+
+/*
+ * curl read callback. While the compressor is behind the socket, which is rare since both gzip
+ * and zstd outrun typical upload links, it pauses the transfer when read from a multi and
+ * blocks otherwise.
+ */
+size_t
+compress_stream_read(char *buffer, size_t size, size_t nitems, void *arg)
+{
+    compress_stream_t *stream = arg;
+    size_t wanted = size * nitems;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->started_reading = true;
+    while (stream->count == 0 && !stream->finished)
+    {
+        if (stream->multi)
+        {
+            stream->paused = true;
+            pthread_mutex_unlock(&stream->lock);
+            return CURL_READFUNC_PAUSE;
+        }
+        pthread_cond_wait(&stream->readable, &stream->lock);
+    }
+
+    if (stream->count == 0)
+    {
+        bool failed = stream->failed;
+        pthread_mutex_unlock(&stream->lock);
+        return failed ? CURL_READFUNC_ABORT : 0;
+    }
+
+    size_t contiguous = COMPRESS_PIPE_SIZE - stream->head;
+    size_t n = stream->count < wanted ? stream->count : wanted;
+    if (n > contiguous)
+    {
+        n = contiguous;
+    }
+
+    memcpy(buffer, stream->pipe + stream->head, n);
+    stream->head = (stream->head + n) % COMPRESS_PIPE_SIZE;
+    stream->count -= n;
+    pthread_cond_signal(&stream->writable);
+    pthread_mutex_unlock(&stream->lock);
+
+    return n;
+}
+
+/* A fresh stream can be "rewound"; once bytes have been handed out it cannot. */
+int
+compress_stream_seek(void *arg, curl_off_t offset, int origin)
+{
+    compress_stream_t *stream = arg;
+
+    pthread_mutex_lock(&stream->lock);
+    bool at_start = !stream->started_reading;
+    pthread_mutex_unlock(&stream->lock);
+
+    return origin == SEEK_SET && offset == 0 && at_start ? CURL_SEEKFUNC_OK
+                                                          : CURL_SEEKFUNC_CANTSEEK;
+}
+
+/* Progress in terms of the source file, since the compressed size is not known up front. */
+void
+compress_stream_progress(compress_stream_t *stream, curl_off_t *done, curl_off_t *total)
+{
+    pthread_mutex_lock(&stream->lock);
+    *total = (curl_off_t)stream->total_in;
+    *done = (curl_off_t)(stream->bytes_in < stream->total_in ? stream->bytes_in
+                                                              : stream->total_in);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/* curl free callback, run when the transfer's MIME form is released. */
+void
+compress_stream_free(void *arg)
+{
+    compress_stream_t *stream = arg;
+    if (!stream)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->cancel = true;
+    pthread_cond_broadcast(&stream->writable);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+
+    if (stream->finished && !stream->failed && stream->count == 0 && stream->bytes_in > 0)
+    {
+        log_info("Compressed %s with %s: %zu -> %zu bytes (%.1f%% saved) using %.1f ms of CPU",
+                 stream->file_path,
+                 compress_codec_name(stream->codec),
+                 stream->bytes_in,
+                 stream->bytes_out,
+                 100.0 - 100.0 * stream->bytes_out / stream->bytes_in,
+                 stream->cpu_ms);
+    }
+
+    pthread_cond_destroy(&stream->writable);
+    pthread_cond_destroy(&stream->readable);
+    pthread_mutex_destroy(&stream->lock);
+    fclose(stream->file);
+    free(stream->file_path);
+    free(stream->pipe);
+    free(stream);
+}
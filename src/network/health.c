@@ -0,0 +1,132 @@
+#include "hostman/network/health.h"
+#include "hostman/core/logging.h"
+#include "hostman/storage/database.h"
+#include <stdio.h>
+#include <string.h>
+
+static host_health_record_t
+load_health(const char *host_name)
+{
+    host_health_record_t record = { 0 };
+    if (!db_get_host_health(host_name, &record))
+    {
+        record.state = HEALTH_CLOSED;
+    }
+    return record;
+}
+
+bool
+health_allow_request(const char *host_name)
+{
+    host_health_record_t record = load_health(host_name);
+    time_t now = time(NULL);
+
+    switch ((health_state_t)record.state)
+    {
+        case HEALTH_CLOSED:
+            return true;
+
+        case HEALTH_OPEN:
+            if (now - record.changed_at < HEALTH_OPEN_SECONDS)
+            {
+                log_warn("Circuit for host %s is open, failing fast", host_name);
+                return false;
+            }
+
+            log_info("Circuit for host %s is half-open, sending probe request", host_name);
+            record.state = HEALTH_HALF_OPEN;
+            record.changed_at = now;
+            db_set_host_health(host_name, &record);
+            return true;
+
+        case HEALTH_HALF_OPEN:
+            /* Only one probe at a time, unless the previous one never reported back. */
+            if (now - record.changed_at < HEALTH_OPEN_SECONDS)
+            {
+                log_warn("Probe to host %s already in flight, failing fast", host_name);
+                return false;
+            }
+
+            record.changed_at = now;
+            db_set_host_health(host_name, &record);
+            return true;
+    }
+
+    return true;
+}
+
+void
+health_record_success(const char *host_name)
+{
+    host_health_record_t record = load_health(host_name);
+
+    if (record.state == HEALTH_CLOSED && record.consecutive_failures == 0)
+    {
+        return;
+    }
+
+    if (record.state != HEALTH_CLOSED)
+    {
+        log_info("Host %s recovered, closing circuit", host_name);
+    }
+
+    record.state = HEALTH_CLOSED;
+    record.consecutive_failures = 0;
+    record.changed_at = time(NULL);
+    db_set_host_health(host_name, &record);
+}
+
+void
+health_record_failure(const char *host_name)
+{
+    host_health_record_t record = load_health(host_name);
+    time_t now = time(NULL);
+
+    record.consecutive_failures++;
+    record.last_failure_at = now;
+
+    if (record.state == HEALTH_HALF_OPEN ||
+        (record.state == HEALTH_CLOSED && record.consecutive_failures >= HEALTH_FAILURE_THRESHOLD))
+    {
+        log_warn("Opening circuit for host %s after %d consecutive failures",
+                 host_name,
+                 record.consecutive_failures);
+        record.state = HEALTH_OPEN;
+        record.changed_at = now;
+    }
+
+    db_set_host_health(host_name, &record);
+}
+
+health_state_t
+health_get_state(const char *host_name, int *consecutive_failures, time_t *retry_at)
+{
+    host_health_record_t record = load_health(host_name);
+
+    if (consecutive_failures)
+    {
+        *consecutive_failures = record.consecutive_failures;
+    }
+    if (retry_at)
+    {
+        *retry_at = record.state == HEALTH_CLOSED ? 0 : record.changed_at + HEALTH_OPEN_SECONDS;
+    }
+
+    return (health_state_t)record.state;
+}
+
+const char *
+health_state_to_string(health_state_t state)
+{
+    switch (state)
+    {
+        case HEALTH_CLOSED:
+            return "closed";
+        case HEALTH_OPEN:
+            return "open";
+        case HEALTH_HALF_OPEN:
+            return "half-open";
+        default:
+            return "unknown";
+    }
+}
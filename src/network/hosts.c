@@ -10,7 +10,7 @@
 #define MAX_INPUT_LENGTH 512
 
 static char *
-read_input(const char *prompt, bool required)
+read_input(arena_t *arena, const char *prompt, bool required)
 {
     char buffer[MAX_INPUT_LENGTH];
     char *result = NULL;
@@ -37,7 +37,7 @@ read_input(const char *prompt, bool required)
             continue;
         }
 
-        result = strdup(buffer);
+        result = arena_strdup(arena, buffer);
         if (!result)
         {
             log_error("Failed to allocate memory for input");
@@ -51,15 +51,15 @@ read_input(const char *prompt, bool required)
 }
 
 static char *
-read_input_default(const char *prompt, const char *default_value)
+read_input_default(arena_t *arena, const char *prompt, const char *default_value)
 {
     char full_prompt[MAX_INPUT_LENGTH * 2];
     snprintf(full_prompt, sizeof(full_prompt), "%s [%s]: ", prompt, default_value);
 
-    char *input = read_input(full_prompt, false);
+    char *input = read_input(arena, full_prompt, false);
     if (!input)
     {
-        return strdup(default_value);
+        return arena_strdup(arena, default_value);
     }
 
     return input;
@@ -70,10 +70,15 @@ hosts_add_interactive(void)
 {
     printf("Adding a new host configuration...\n");
 
-    char *name = read_input("Host name (unique identifier): ", true);
+    /* Everything typed in lives until the host has been saved. */
+    arena_t input;
+    arena_init(&input, 0);
+
+    char *name = read_input(&input, "Host name (unique identifier): ", true);
     if (!name)
     {
         fprintf(stderr, "Error: Failed to read host name\n");
+        arena_destroy(&input);
         return EXIT_FAILURE;
     }
 
@@ -81,15 +86,15 @@ hosts_add_interactive(void)
     if (existing)
     {
         fprintf(stderr, "Error: A host with name '%s' already exists\n", name);
-        free(name);
+        arena_destroy(&input);
         return EXIT_FAILURE;
     }
 
-    char *api_endpoint = read_input("API endpoint URL: ", true);
+    char *api_endpoint = read_input(&input, "API endpoint URL: ", true);
     if (!api_endpoint)
     {
         fprintf(stderr, "Error: Failed to read API endpoint\n");
-        free(name);
+        arena_destroy(&input);
         return EXIT_FAILURE;
     }
 
@@ -99,36 +104,32 @@ hosts_add_interactive(void)
     printf("  3. API key in header (Custom-Header: YOUR_KEY)\n");
     printf("  4. API key in URL parameter (?api_key=YOUR_KEY)\n");
 
-    char *auth_type_input = read_input("Select authentication type [1]: ", false);
-    char *auth_type = NULL;
+    char *auth_type_input = read_input(&input, "Select authentication type [1]: ", false);
+    const char *auth_type = NULL;
 
     if (!auth_type_input || strcmp(auth_type_input, "1") == 0)
     {
-        auth_type = strdup("none");
+        auth_type = "none";
     }
     else if (strcmp(auth_type_input, "2") == 0)
     {
-        auth_type = strdup("bearer");
+        auth_type = "bearer";
     }
     else if (strcmp(auth_type_input, "3") == 0)
     {
-        auth_type = strdup("header");
+        auth_type = "header";
     }
     else if (strcmp(auth_type_input, "4") == 0)
     {
-        auth_type = strdup("param");
+        auth_type = "param";
     }
     else
     {
         fprintf(stderr, "Error: Invalid authentication type\n");
-        free(name);
-        free(api_endpoint);
-        free(auth_type_input);
+        arena_destroy(&input);
         return EXIT_FAILURE;
     }
 
-    free(auth_type_input);
-
     char *api_key_name = NULL;
     char *api_key = NULL;
 
@@ -149,25 +150,24 @@ hosts_add_interactive(void)
             strcpy(default_key_name, "api_key");
         }
 
-        api_key_name = read_input_default("API key header/parameter name", default_key_name);
+        api_key_name =
+          read_input_default(&input, "API key header/parameter name", default_key_name);
 
-        api_key = read_input("API key or token: ", true);
+        api_key = read_input(&input, "API key or token: ", true);
         if (!api_key)
         {
             fprintf(stderr, "Error: Failed to read API key\n");
-            free(name);
-            free(api_endpoint);
-            free(auth_type);
-            free(api_key_name);
+            arena_destroy(&input);
             return EXIT_FAILURE;
         }
     }
 
-    char *request_body_format = read_input_default("Request body format", "multipart");
-    char *file_form_field = read_input_default("File form field name", "file");
-    char *response_url_json_path = read_input_default("JSON path to URL in response", "url");
+    char *request_body_format = read_input_default(&input, "Request body format", "multipart");
+    char *file_form_field = read_input_default(&input, "File form field name", "file");
+    char *response_url_json_path =
+      read_input_default(&input, "JSON path to URL in response", "url");
     char *response_deletion_url_json_path =
-      read_input_default("JSON path to deletion URL in response", "deletion_url");
+      read_input_default(&input, "JSON path to deletion URL in response", "deletion_url");
     char **static_field_names = NULL;
     char **static_field_values = NULL;
     int static_field_count = 0;
@@ -187,35 +187,34 @@ hosts_add_interactive(void)
                 snprintf(
                   field_prompt, sizeof(field_prompt), "Field #%d name: ", static_field_count + 1);
 
-                char *field_name = read_input(field_prompt, false);
+                char *field_name = read_input(&input, field_prompt, false);
                 if (!field_name || strlen(field_name) == 0)
                 {
-                    free(field_name);
                     break;
                 }
 
                 snprintf(
                   field_prompt, sizeof(field_prompt), "Field #%d value: ", static_field_count + 1);
-                char *field_value = read_input(field_prompt, true);
+                char *field_value = read_input(&input, field_prompt, true);
                 if (!field_value)
                 {
-                    free(field_name);
                     break;
                 }
 
-                char **new_names =
-                  realloc(static_field_names, (static_field_count + 1) * sizeof(char *));
-                char **new_values =
-                  realloc(static_field_values, (static_field_count + 1) * sizeof(char *));
+                char **new_names = arena_alloc(&input, (static_field_count + 1) * sizeof(char *));
+                char **new_values = arena_alloc(&input, (static_field_count + 1) * sizeof(char *));
 
                 if (!new_names || !new_values)
                 {
                     log_error("Failed to allocate memory for static fields");
-                    free(field_name);
-                    free(field_value);
                     break;
                 }
 
+                if (static_field_count > 0)
+                {
+                    memcpy(new_names, static_field_names, static_field_count * sizeof(char *));
+                    memcpy(new_values, static_field_values, static_field_count * sizeof(char *));
+                }
                 static_field_names = new_names;
                 static_field_values = new_values;
 
@@ -254,23 +253,7 @@ hosts_add_interactive(void)
         }
     }
 
-    free(name);
-    free(api_endpoint);
-    free(auth_type);
-    free(api_key_name);
-    free(api_key);
-    free(request_body_format);
-    free(file_form_field);
-    free(response_url_json_path);
-    free(response_deletion_url_json_path);
-
-    for (int i = 0; i < static_field_count; i++)
-    {
-        free(static_field_names[i]);
-        free(static_field_values[i]);
-    }
-    free(static_field_names);
-    free(static_field_values);
+    arena_destroy(&input);
 
     if (result)
     {
@@ -330,79 +313,32 @@ hosts_add(const char *name,
         }
     }
 
-    host_config_t *host = calloc(1, sizeof(host_config_t));
-    if (!host)
-    {
-        log_error("Failed to allocate memory for host configuration");
-        free(encrypted_key);
-        return false;
-    }
-
-    host->name = strdup(name);
-    host->api_endpoint = strdup(api_endpoint);
-    host->auth_type = strdup(auth_type);
-    host->api_key_name =
-      (api_key_name && strcmp(auth_type, "none") != 0) ? strdup(api_key_name) : NULL;
-    host->api_key_encrypted = encrypted_key;
-    host->request_body_format = strdup(request_body_format);
-    host->file_form_field = strdup(file_form_field);
-    host->response_url_json_path = strdup(response_url_json_path);
-    host->response_deletion_url_json_path = strdup(response_deletion_url_json_path);
+    /* config_add_host copies the host into the config, so it can point at the arguments. */
+    host_config_t host = {
+        .name = (char *)name,
+        .api_endpoint = (char *)api_endpoint,
+        .auth_type = (char *)auth_type,
+        .api_key_name = strcmp(auth_type, "none") != 0 ? (char *)api_key_name : NULL,
+        .api_key_encrypted = encrypted_key,
+        .request_body_format = (char *)request_body_format,
+        .file_form_field = (char *)file_form_field,
+        .response_url_json_path = (char *)response_url_json_path,
+        .response_deletion_url_json_path = (char *)response_deletion_url_json_path,
+    };
 
     if (static_field_count > 0 && static_field_names && static_field_values)
     {
-        host->static_field_count = static_field_count;
-        host->static_field_names = calloc(static_field_count, sizeof(char *));
-        host->static_field_values = calloc(static_field_count, sizeof(char *));
-
-        if (!host->static_field_names || !host->static_field_values)
-        {
-            log_error("Failed to allocate memory for static fields");
-            free(host->name);
-            free(host->api_endpoint);
-            free(host->auth_type);
-            free(host->api_key_name);
-            free(host->api_key_encrypted);
-            free(host->request_body_format);
-            free(host->file_form_field);
-            free(host->response_url_json_path);
-            free(host->response_deletion_url_json_path);
-            free(host->static_field_names);
-            free(host->static_field_values);
-            free(host);
-            return false;
-        }
-
-        for (int i = 0; i < static_field_count; i++)
-        {
-            host->static_field_names[i] = strdup(static_field_names[i]);
-            host->static_field_values[i] = strdup(static_field_values[i]);
-        }
+        host.static_field_names = static_field_names;
+        host.static_field_values = static_field_values;
+        host.static_field_count = static_field_count;
     }
 
-    bool result = config_add_host(host);
+    bool result = config_add_host(&host);
     if (!result)
     {
         log_error("Failed to add host to configuration");
-        free(host->name);
-        free(host->api_endpoint);
-        free(host->auth_type);
-        free(host->api_key_name);
-        free(host->api_key_encrypted);
-        free(host->request_body_format);
-        free(host->file_form_field);
-        free(host->response_url_json_path);
-        free(host->response_deletion_url_json_path);
-
-        for (int i = 0; i < host->static_field_count; i++)
-        {
-            free(host->static_field_names[i]);
-            free(host->static_field_values[i]);
-        }
-        free(host->static_field_names);
-        free(host->static_field_values);
-        free(host);
     }
+    free(encrypted_key);
 
     return result;
 }
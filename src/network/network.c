@@ -1,49 +1,130 @@
 #include "hostman/network/network.h"
 #include "hostman/core/logging.h"
+#include "hostman/core/progress.h"
 #include "hostman/core/utils.h"
 #include "hostman/crypto/encryption.h"
+#include "hostman/network/health.h"
+#include "hostman/storage/database.h"
 #include <curl/curl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
-#define MIN_PROGRESS_UPDATE_MS 100
-
-static network_config_t global_config = { .timeout_seconds = DEFAULT_TIMEOUT_SECONDS,
+static network_config_t global_config = { .timeouts = { .connect_seconds =
+                                                          DEFAULT_CONNECT_TIMEOUT_SECONDS,
+                                                        .tls_seconds = DEFAULT_TLS_TIMEOUT_SECONDS,
+                                                        .total_seconds = DEFAULT_TIMEOUT_SECONDS,
+                                                        .total_per_mb_seconds =
+                                                          DEFAULT_TIMEOUT_PER_MB_SECONDS,
+                                                        .low_speed_limit = DEFAULT_LOW_SPEED_LIMIT,
+                                                        .low_speed_seconds =
+                                                          DEFAULT_LOW_SPEED_SECONDS,
+                                                        .stall_seconds = DEFAULT_STALL_SECONDS },
                                           .max_retries = DEFAULT_MAX_RETRIES,
                                           .retry_delay_ms = DEFAULT_RETRY_DELAY_MS,
                                           .enable_http2 = true,
                                           .proxy_url = NULL,
-                                          .verbose = false };
+                                          .verbose = false,
+                                          .max_response_bytes = DEFAULT_MAX_RESPONSE_BYTES };
+
+static bool http3_supported = false;
+static char *altsvc_path = NULL;
+static CURLM *batch_multi = NULL;
+
+/*
+ * DNS and TLS sessions shared by every handle, so the pre-connect thread's lookup and handshake
+ * are reused. Connections stay in each handle's or multi's own cache; libcurl cannot share those
+ * across threads.
+ */
+static CURLSH *share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
 
 typedef struct
 {
-    char *data;
-    size_t size;
-} response_data_t;
+    char *url;
+    char *host_name;
+    char *http_version;
+    double start_ms;
+} preconnect_target_t;
+
+static pthread_t preconnect_thread;
+static bool preconnect_running = false;
+static atomic_bool preconnect_cancel = false;
 
-static size_t
-write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+/*
+ * curl only knows one connect deadline covering TCP and TLS together, and its low-speed check
+ * cannot tell "slow" from "nothing at all". Enforce the finer-grained limits here instead;
+ * returning true aborts the transfer with prog->abort_reason set.
+ */
+static bool
+check_deadlines(progress_data_t *prog, curl_off_t ultotal, curl_off_t ulnow)
 {
-    size_t real_size = size * nmemb;
-    response_data_t *resp = (response_data_t *)userp;
+    double now_ms = monotonic_ms();
+    double elapsed_ms = now_ms - prog->start_ms;
 
-    char *ptr = realloc(resp->data, resp->size + real_size + 1);
-    if (!ptr)
+    curl_off_t connect_us = 0;
+    curl_easy_getinfo(prog->curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+    if (connect_us == 0)
     {
-        log_error("Failed to allocate memory for response data");
-        return 0;
+        if (prog->limits.connect_seconds > 0 &&
+            elapsed_ms > prog->limits.connect_seconds * 1000.0)
+        {
+            snprintf(prog->abort_reason,
+                     sizeof(prog->abort_reason),
+                     "Connection timed out after %ld seconds",
+                     prog->limits.connect_seconds);
+            return true;
+        }
+        return false;
+    }
+
+    if (prog->tls)
+    {
+        curl_off_t appconnect_us = 0;
+        curl_easy_getinfo(prog->curl, CURLINFO_APPCONNECT_TIME_T, &appconnect_us);
+        if (appconnect_us == 0)
+        {
+            if (prog->limits.tls_seconds > 0 &&
+                elapsed_ms - connect_us / 1000.0 > prog->limits.tls_seconds * 1000.0)
+            {
+                snprintf(prog->abort_reason,
+                         sizeof(prog->abort_reason),
+                         "TLS handshake timed out after %ld seconds",
+                         prog->limits.tls_seconds);
+                return true;
+            }
+            return false;
+        }
     }
 
-    resp->data = ptr;
-    memcpy(&(resp->data[resp->size]), contents, real_size);
-    resp->size += real_size;
-    resp->data[resp->size] = 0;
+    /* Once the body is fully sent the host is processing, which is not a stall. */
+    if (ultotal > 0 && ulnow < ultotal)
+    {
+        if (ulnow != prog->last_activity_bytes || prog->last_activity_ms == 0)
+        {
+            prog->last_activity_bytes = ulnow;
+            prog->last_activity_ms = now_ms;
+        }
+        else if (prog->limits.stall_seconds > 0 &&
+                 now_ms - prog->last_activity_ms > prog->limits.stall_seconds * 1000.0)
+        {
+            snprintf(prog->abort_reason,
+                     sizeof(prog->abort_reason),
+                     "Upload stalled: no data sent for %ld seconds",
+                     prog->limits.stall_seconds);
+            return true;
+        }
+    }
 
-    return real_size;
+    return false;
 }
 
 static int
@@ -53,67 +134,69 @@ progress_callback(void *clientp,
                   curl_off_t ultotal,
                   curl_off_t ulnow)
 {
-    if (ultotal == 0)
-        return 0;
-
     progress_data_t *prog = (progress_data_t *)clientp;
-    double percent = (double)ulnow / (double)ultotal * 100.0;
 
-    time_t now = time(NULL);
-    if (percent != prog->last_percent &&
-        (difftime(now, prog->last_time) * 1000 >= MIN_PROGRESS_UPDATE_MS || percent == 100.0 ||
-         prog->last_percent == 0.0))
+    /* A compressed body has no known length; follow how far the compressor got instead. */
+    if (prog->source)
     {
+        compress_stream_progress(prog->source, &ulnow, &ultotal);
+    }
 
-        double speed = 0.0;
-        if (difftime(now, prog->last_time) > 0)
-        {
-            speed = (ulnow - prog->last_bytes) / difftime(now, prog->last_time);
-        }
-
-        fprintf(stderr, "\r\033[K");
-        fprintf(stderr, "Uploading: [");
-
-        int bar_width = 30;
-        int pos = bar_width * percent / 100.0;
-
-        for (int i = 0; i < bar_width; i++)
-        {
-            if (i < pos)
-                fprintf(stderr, "=");
-            else if (i == pos)
-                fprintf(stderr, ">");
-            else
-                fprintf(stderr, " ");
-        }
+    if (prog->curl && check_deadlines(prog, ultotal, ulnow))
+    {
+        log_warn("Aborting transfer: %s", prog->abort_reason);
+        return 1;
+    }
 
-        fprintf(stderr, "] %.1f%% ", percent);
+    if (ultotal > 0)
+    {
+        progress_update(prog->bar, ulnow, ultotal);
+    }
 
-        char progress_str[32];
-        format_file_size(ulnow, progress_str, sizeof(progress_str));
+    return 0;
+}
 
-        char total_str[32];
-        format_file_size(ultotal, total_str, sizeof(total_str));
+static void
+share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&share_locks[data]);
+}
 
-        fprintf(stderr, "(%s / %s)", progress_str, total_str);
+static void
+share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&share_locks[data]);
+}
 
-        if (speed > 0)
-        {
-            char speed_str[32];
-            format_file_size(speed, speed_str, sizeof(speed_str));
-            fprintf(stderr, " - %s/s", speed_str);
-        }
+static void
+share_init(void)
+{
+    share = curl_share_init();
+    if (!share)
+    {
+        log_warn("Failed to create shared connection cache, pre-connecting is disabled");
+        return;
+    }
 
-        prog->last_percent = percent;
-        prog->last_bytes = ulnow;
-        prog->last_time = now;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    {
+        pthread_mutex_init(&share_locks[i], NULL);
     }
 
-    return 0;
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
 }
 
+/* max_response_bytes caps every response body; 0 keeps DEFAULT_MAX_RESPONSE_BYTES. */
 bool
-network_init(void)
+network_init(size_t max_response_bytes)
 {
     curl_version_info_data *version_info = curl_version_info(CURLVERSION_NOW);
     if (version_info->features & CURL_VERSION_HTTP2)
@@ -125,7 +208,38 @@ network_init(void)
         log_warn("HTTP/2 not supported by libcurl, falling back to HTTP/1.1");
         global_config.enable_http2 = false;
     }
-    return (curl_global_init(CURL_GLOBAL_ALL) == CURLE_OK);
+
+#ifdef CURL_VERSION_HTTP3
+    http3_supported = (version_info->features & CURL_VERSION_HTTP3) != 0;
+#endif
+    if (http3_supported)
+    {
+        log_info("HTTP/3 support enabled");
+    }
+
+    const char *cache_dir = get_cache_dir();
+    if (cache_dir)
+    {
+        size_t len = strlen(cache_dir) + strlen("/altsvc.txt") + 1;
+        altsvc_path = malloc(len);
+        if (altsvc_path)
+        {
+            snprintf(altsvc_path, len, "%s/altsvc.txt", cache_dir);
+        }
+    }
+
+    if (max_response_bytes > 0)
+    {
+        global_config.max_response_bytes = max_response_bytes;
+    }
+
+    if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK)
+    {
+        return false;
+    }
+
+    share_init();
+    return true;
 }
 
 void
@@ -133,7 +247,7 @@ network_set_config(network_config_t *config)
 {
     if (config)
     {
-        global_config.timeout_seconds = config->timeout_seconds;
+        global_config.timeouts = config->timeouts;
         global_config.max_retries = config->max_retries;
         global_config.retry_delay_ms = config->retry_delay_ms;
         global_config.enable_http2 = config->enable_http2;
@@ -143,19 +257,102 @@ network_set_config(network_config_t *config)
         }
         global_config.proxy_url = config->proxy_url ? strdup(config->proxy_url) : NULL;
         global_config.verbose = config->verbose;
+        if (config->max_response_bytes > 0)
+        {
+            global_config.max_response_bytes = config->max_response_bytes;
+        }
+    }
+}
+
+/*
+ * Pick the HTTP version for a host's uploads. "auto" prefers HTTP/2 over TLS and lets the Alt-Svc
+ * cache upgrade to HTTP/3 once a host has advertised it; an explicit "3" tries QUIC first and
+ * curl falls back to TCP on its own if the handshake fails.
+ */
+static void
+configure_http_version(CURL *curl, const host_config_t *host)
+{
+    const char *wanted = host->http_version ? host->http_version : "auto";
+    long version = global_config.enable_http2 ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1;
+    long altsvc_protocols = 0;
+
+    if (strcmp(wanted, "1.1") == 0)
+    {
+        version = CURL_HTTP_VERSION_1_1;
+    }
+    else if (strcmp(wanted, "2") == 0)
+    {
+        if (!global_config.enable_http2)
+            log_warn("Host %s wants HTTP/2 but libcurl lacks it, using HTTP/1.1", host->name);
+    }
+    else if (strcmp(wanted, "3") == 0)
+    {
+#if LIBCURL_VERSION_NUM >= 0x074200
+        if (http3_supported)
+        {
+            version = CURL_HTTP_VERSION_3;
+            altsvc_protocols = CURLALTSVC_H3;
+        }
+        else
+#endif
+        {
+            log_warn("Host %s wants HTTP/3 but libcurl lacks it, using %s",
+                     host->name,
+                     global_config.enable_http2 ? "HTTP/2" : "HTTP/1.1");
+        }
+    }
+    else
+    {
+        altsvc_protocols = CURLALTSVC_H1 | CURLALTSVC_H2;
+        if (http3_supported)
+            altsvc_protocols |= CURLALTSVC_H3;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, version);
+
+    /* Pinned versions stay pinned; only auto and 3 may be redirected by Alt-Svc. */
+    if (altsvc_path && altsvc_protocols)
+    {
+        curl_easy_setopt(curl, CURLOPT_ALTSVC_CTRL, altsvc_protocols);
+        curl_easy_setopt(curl, CURLOPT_ALTSVC, altsvc_path);
     }
 }
 
+static timeout_config_t
+effective_timeouts(const host_config_t *host)
+{
+    timeout_config_t limits = global_config.timeouts;
+    const timeout_config_t *overrides = &host->timeouts;
+
+    if (overrides->connect_seconds > 0)
+        limits.connect_seconds = overrides->connect_seconds;
+    if (overrides->tls_seconds > 0)
+        limits.tls_seconds = overrides->tls_seconds;
+    if (overrides->total_seconds > 0)
+        limits.total_seconds = overrides->total_seconds;
+    if (overrides->total_per_mb_seconds > 0)
+        limits.total_per_mb_seconds = overrides->total_per_mb_seconds;
+    if (overrides->low_speed_limit > 0)
+        limits.low_speed_limit = overrides->low_speed_limit;
+    if (overrides->low_speed_seconds > 0)
+        limits.low_speed_seconds = overrides->low_speed_seconds;
+    if (overrides->stall_seconds > 0)
+        limits.stall_seconds = overrides->stall_seconds;
+
+    return limits;
+}
+
 static void
 configure_curl_handle(CURL *curl,
                       struct curl_slist *headers,
-                      response_data_t *response_data,
+                      response_buffer_t *response_data,
                       progress_data_t *prog_data,
-                      const char *url)
+                      const char *url,
+                      curl_off_t upload_size)
 {
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_buffer_write_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_data);
     curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
     curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
@@ -163,14 +360,33 @@ configure_curl_handle(CURL *curl,
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
 
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, global_config.timeout_seconds);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, global_config.timeout_seconds);
+    const timeout_config_t *limits = &prog_data->limits;
+
+    /* curl's connect phase includes the TLS handshake; check_deadlines() splits the two. */
+    curl_easy_setopt(
+      curl, CURLOPT_CONNECTTIMEOUT_MS, (limits->connect_seconds + limits->tls_seconds) * 1000L);
 
-    if (global_config.enable_http2)
+    /* A fixed total deadline kills large uploads on slow links, so scale it by size. */
+    if (limits->total_seconds > 0)
     {
-        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+        curl_off_t megabytes = (upload_size + (1024 * 1024 - 1)) / (1024 * 1024);
+        long total_seconds = limits->total_seconds + (long)megabytes * limits->total_per_mb_seconds;
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, total_seconds * 1000L);
     }
 
+    if (limits->low_speed_limit > 0 && limits->low_speed_seconds > 0)
+    {
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, limits->low_speed_limit);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, limits->low_speed_seconds);
+    }
+
+    prog_data->curl = curl;
+    prog_data->tls = strncasecmp(url, "https://", 8) == 0;
+    prog_data->start_ms = monotonic_ms();
+    prog_data->last_activity_ms = 0;
+    prog_data->last_activity_bytes = 0;
+    prog_data->abort_reason[0] = '\0';
+
     if (global_config.proxy_url)
     {
         curl_easy_setopt(curl, CURLOPT_PROXY, global_config.proxy_url);
@@ -180,19 +396,159 @@ configure_curl_handle(CURL *curl,
     {
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
     }
+
+    if (share)
+    {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
 }
 
-upload_response_t *
-network_upload_file(const char *file_path, host_config_t *host)
+/*
+ * Once an upload is waiting, a handshake still in progress after this long is dropped and the
+ * upload connects on its own. A finished handshake returns by itself, so it is never cut short.
+ */
+#define PRECONNECT_GRACE_MS 250
+
+static int
+preconnect_progress(void *clientp,
+                    curl_off_t dltotal,
+                    curl_off_t dlnow,
+                    curl_off_t ultotal,
+                    curl_off_t ulnow)
+{
+    (void)dltotal;
+    (void)dlnow;
+    (void)ultotal;
+    (void)ulnow;
+
+    preconnect_target_t *target = clientp;
+    return atomic_load(&preconnect_cancel) &&
+           monotonic_ms() - target->start_ms >= PRECONNECT_GRACE_MS;
+}
+
+static void *
+preconnect_worker(void *arg)
+{
+    preconnect_target_t *target = arg;
+    host_config_t host = { .name = target->host_name, .http_version = target->http_version };
+
+    CURL *curl = curl_easy_init();
+    if (curl)
+    {
+        /*
+         * Only resolve and handshake, without sending a request the endpoint might reject or
+         * log; the DNS entry and TLS session it leaves in the share are what the upload reuses.
+         */
+        curl_easy_setopt(curl, CURLOPT_URL, target->url);
+        curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 1L);
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, preconnect_progress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, target);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl,
+                         CURLOPT_CONNECTTIMEOUT_MS,
+                         (global_config.timeouts.connect_seconds +
+                          global_config.timeouts.tls_seconds) *
+                           1000L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, global_config.timeouts.total_seconds);
+        if (global_config.proxy_url)
+        {
+            curl_easy_setopt(curl, CURLOPT_PROXY, global_config.proxy_url);
+        }
+        configure_http_version(curl, &host);
+
+        target->start_ms = monotonic_ms();
+        CURLcode res = curl_easy_perform(curl);
+        if (res == CURLE_OK)
+            log_debug("Pre-connected to %s in %.2f ms",
+                      target->host_name,
+                      monotonic_ms() - target->start_ms);
+        else
+            log_debug("Pre-connect to %s failed: %s", target->host_name, curl_easy_strerror(res));
+
+        curl_easy_cleanup(curl);
+    }
+
+    free(target->url);
+    free(target->host_name);
+    free(target->http_version);
+    free(target);
+    return NULL;
+}
+
+/* Every transfer waits here so it picks up whatever the warm-up managed to establish. */
+static void
+preconnect_join(void)
+{
+    if (preconnect_running)
+    {
+        atomic_store(&preconnect_cancel, true);
+        pthread_join(preconnect_thread, NULL);
+        atomic_store(&preconnect_cancel, false);
+        preconnect_running = false;
+    }
+}
+
+void
+network_preconnect(const host_config_t *host)
+{
+    if (!share || !host || !host->api_endpoint || preconnect_running)
+    {
+        return;
+    }
+
+    preconnect_target_t *target = calloc(1, sizeof(preconnect_target_t));
+    if (!target)
+    {
+        return;
+    }
+
+    target->url = strdup(host->api_endpoint);
+    target->host_name = strdup(host->name);
+    target->http_version = host->http_version ? strdup(host->http_version) : NULL;
+
+    if (!target->url || !target->host_name ||
+        pthread_create(&preconnect_thread, NULL, preconnect_worker, target) != 0)
+    {
+        log_debug("Could not start pre-connect to %s", host->name);
+        free(target->url);
+        free(target->host_name);
+        free(target->http_version);
+        free(target);
+        return;
+    }
+
+    preconnect_running = true;
+}
+
+typedef struct
 {
     CURL *curl;
-    CURLcode res;
-    struct curl_slist *headers = NULL;
-    response_data_t response_data = { 0 };
-    progress_data_t prog_data = { 0 };
-    upload_response_t *response = malloc(sizeof(upload_response_t));
-    int retry_count = 0;
+    curl_mime *mime;
+    struct curl_slist *headers;
+    response_buffer_t *response_data;
+    progress_data_t prog_data;
+    host_config_t *host;
+    bool racing;
+    bool done;
+} upload_transfer_t;
+
+/* Enough for a URL, a deletion URL and an error message in one chunk. */
+#define UPLOAD_RESPONSE_ARENA_SIZE 512
+
+/* The response's strings go into its arena, so replacing one never needs a free. */
+static void
+set_error(upload_response_t *response, const char *message)
+{
+    response->error_message = arena_strdup(&response->arena, message);
+}
 
+static upload_response_t *
+upload_response_new(void)
+{
+    upload_response_t *response = malloc(sizeof(upload_response_t));
     if (!response)
     {
         log_error("Failed to allocate memory for upload response");
@@ -206,184 +562,1379 @@ network_upload_file(const char *file_path, host_config_t *host)
     response->request_time_ms = 0.0;
     response->retry_count = 0;
     response->http_code = 0;
+    response->circuit_open = false;
+    arena_init(&response->arena, UPLOAD_RESPONSE_ARENA_SIZE);
 
-    if (access(file_path, R_OK) != 0)
+    return response;
+}
+
+static void
+upload_transfer_cleanup(upload_transfer_t *transfer)
+{
+    if (transfer->curl)
     {
-        response->error_message = strdup("File not found or not readable");
-        return response;
+        curl_easy_cleanup(transfer->curl);
+        transfer->curl = NULL;
     }
+    curl_mime_free(transfer->mime);
+    transfer->mime = NULL;
+    progress_remove_bar(transfer->prog_data.bar);
+    transfer->prog_data.bar = -1;
+    transfer->prog_data.source = NULL;
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = NULL;
+}
 
-    struct stat file_stat;
-    if (stat(file_path, &file_stat) != 0)
+static const char *
+file_label(const char *file_path)
+{
+    const char *slash = strrchr(file_path, '/');
+    return slash ? slash + 1 : file_path;
+}
+
+/*
+ * Stream the file through the host's compress codec. With compress_as "encoding" the part keeps
+ * its name and carries a Content-Encoding header; otherwise the codec's suffix is appended to
+ * the file name. Returns false when the file should be sent as-is.
+ */
+static bool
+attach_compressed_file(curl_mimepart *part,
+                       const char *file_path,
+                       const host_config_t *host,
+                       progress_data_t *prog_data)
+{
+    compress_codec_t codec = compress_codec_from_name(host->compress);
+    if (codec == COMPRESS_NONE)
     {
-        response->error_message = strdup("Failed to get file information");
-        return response;
+        return false;
     }
 
-    do
+    if (!compress_codec_available(codec))
     {
-        if (retry_count > 0)
-        {
-            log_info(
-              "Retrying upload (attempt %d of %d)", retry_count + 1, global_config.max_retries);
-            usleep(global_config.retry_delay_ms * 1000);
-        }
+        log_warn("%s compression is not available in this build, uploading %s uncompressed",
+                 compress_codec_name(codec),
+                 file_path);
+        return false;
+    }
 
-        curl = curl_easy_init();
-        if (!curl)
-        {
-            response->error_message = strdup("Failed to initialize curl");
-            return response;
-        }
+    if (!compress_worthwhile(file_path))
+    {
+        log_debug("Not compressing %s: too small or already compressed", file_path);
+        return false;
+    }
+
+    compress_stream_t *stream = compress_stream_open(file_path, codec);
+    if (!stream)
+    {
+        return false;
+    }
 
-        free(response_data.data);
-        response_data.data = NULL;
-        response_data.size = 0;
+    if (curl_mime_data_cb(part,
+                          -1,
+                          compress_stream_read,
+                          compress_stream_seek,
+                          compress_stream_free,
+                          stream) != CURLE_OK)
+    {
+        compress_stream_free(stream);
+        return false;
+    }
 
-        curl_mime *mime = curl_mime_init(curl);
-        if (!mime)
-        {
-            response->error_message = strdup("Failed to initialize mime form");
-            curl_easy_cleanup(curl);
-            return response;
-        }
+    /* curl copies the name, so neither needs to outlive this call. */
+    const char *filename = file_label(file_path);
+    if (host->compress_as && strcmp(host->compress_as, "encoding") == 0)
+    {
+        char header[64];
+        snprintf(header, sizeof(header), "Content-Encoding: %s", compress_codec_name(codec));
+        curl_mime_headers(part, curl_slist_append(NULL, header), 1);
+        curl_mime_filename(part, filename);
+    }
+    else
+    {
+        char compressed_name[NAME_MAX + 16];
+        snprintf(
+          compressed_name, sizeof(compressed_name), "%s%s", filename, compress_codec_suffix(codec));
+        curl_mime_filename(part, compressed_name);
+        curl_mime_type(part, compress_codec_mime_type(codec));
+    }
+
+    prog_data->source = stream;
+    return true;
+}
+
+/*
+ * The response buffer is owned by the caller so one allocation can serve every retry of a file,
+ * or every file that passes through the same batch slot.
+ */
+static bool
+upload_transfer_setup(upload_transfer_t *transfer,
+                      const char *file_path,
+                      host_config_t *host,
+                      response_buffer_t *response_data,
+                      upload_response_t *response)
+{
+    response_buffer_reset(response_data);
+    transfer->response_data = response_data;
+    transfer->host = host;
+    transfer->done = false;
+    transfer->prog_data.bar = -1;
+    transfer->prog_data.source = NULL;
+
+    struct stat file_stat;
+    if (stat(file_path, &file_stat) != 0)
+    {
+        set_error(response, "Failed to get file information");
+        return false;
+    }
+
+    transfer->curl = curl_easy_init();
+    if (!transfer->curl)
+    {
+        set_error(response, "Failed to initialize curl");
+        return false;
+    }
+
+    transfer->mime = curl_mime_init(transfer->curl);
+    if (!transfer->mime)
+    {
+        set_error(response, "Failed to initialize mime form");
+        upload_transfer_cleanup(transfer);
+        return false;
+    }
 
-        curl_mimepart *part = curl_mime_addpart(mime);
-        curl_mime_name(part, host->file_form_field);
+    curl_mimepart *part = curl_mime_addpart(transfer->mime);
+    curl_mime_name(part, host->file_form_field);
+    if (!attach_compressed_file(part, file_path, host, &transfer->prog_data))
+    {
         curl_mime_filedata(part, file_path);
+    }
+
+    for (int i = 0; i < host->static_field_count; i++)
+    {
+        part = curl_mime_addpart(transfer->mime);
+        curl_mime_name(part, host->static_field_names[i]);
+        curl_mime_data(part, host->static_field_values[i], CURL_ZERO_TERMINATED);
+    }
 
-        for (int i = 0; i < host->static_field_count; i++)
+    if (strcmp(host->auth_type, "none") == 0)
+    {
+        // :3
+    }
+    else if (strcmp(host->auth_type, "bearer") == 0)
+    {
+        char *api_key = encryption_decrypt_api_key(host->api_key_encrypted);
+        if (api_key)
         {
-            part = curl_mime_addpart(mime);
-            curl_mime_name(part, host->static_field_names[i]);
-            curl_mime_data(part, host->static_field_values[i], CURL_ZERO_TERMINATED);
+            char auth_header[1024];
+            snprintf(auth_header, sizeof(auth_header), "%s: Bearer %s", host->api_key_name, api_key);
+            transfer->headers = curl_slist_append(transfer->headers, auth_header);
+            free(api_key);
         }
-
-        if (strcmp(host->auth_type, "none") == 0)
+        else
         {
-            // :3
+            set_error(response, "Failed to decrypt API key");
+            upload_transfer_cleanup(transfer);
+            return false;
         }
-        else if (strcmp(host->auth_type, "bearer") == 0)
+    }
+    else if (strcmp(host->auth_type, "header") == 0)
+    {
+        char *api_key = encryption_decrypt_api_key(host->api_key_encrypted);
+        if (api_key)
         {
-            char *api_key = encryption_decrypt_api_key(host->api_key_encrypted);
-            if (api_key)
-            {
-                char auth_header[1024];
-                snprintf(
-                  auth_header, sizeof(auth_header), "%s: Bearer %s", host->api_key_name, api_key);
-                headers = curl_slist_append(headers, auth_header);
-                free(api_key);
-            }
-            else
-            {
-                response->error_message = strdup("Failed to decrypt API key");
-                curl_easy_cleanup(curl);
-                curl_mime_free(mime);
-                return response;
-            }
+            char auth_header[1024];
+            snprintf(auth_header, sizeof(auth_header), "%s: %s", host->api_key_name, api_key);
+            transfer->headers = curl_slist_append(transfer->headers, auth_header);
+            free(api_key);
         }
-        else if (strcmp(host->auth_type, "header") == 0)
+        else
         {
-            char *api_key = encryption_decrypt_api_key(host->api_key_encrypted);
-            if (api_key)
-            {
-                char auth_header[1024];
-                snprintf(auth_header, sizeof(auth_header), "%s: %s", host->api_key_name, api_key);
-                headers = curl_slist_append(headers, auth_header);
-                free(api_key);
-            }
-            else
-            {
-                response->error_message = strdup("Failed to decrypt API key");
-                curl_easy_cleanup(curl);
-                curl_mime_free(mime);
-                return response;
-            }
+            set_error(response, "Failed to decrypt API key");
+            upload_transfer_cleanup(transfer);
+            return false;
         }
+    }
 
-        configure_curl_handle(curl, headers, &response_data, &prog_data, host->api_endpoint);
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+    transfer->prog_data.limits = effective_timeouts(host);
+    configure_curl_handle(transfer->curl,
+                          transfer->headers,
+                          transfer->response_data,
+                          &transfer->prog_data,
+                          host->api_endpoint,
+                          file_stat.st_size);
+    configure_http_version(transfer->curl, host);
+    curl_easy_setopt(transfer->curl, CURLOPT_MIMEPOST, transfer->mime);
 
-        prog_data.last_time = time(NULL);
+    return true;
+}
 
-        log_info("Connecting to host: %s (attempt %d)", host->api_endpoint, retry_count + 1);
-        struct timespec start_time, end_time;
-        clock_gettime(CLOCK_MONOTONIC, &start_time);
+static void
+upload_transfer_parse(upload_transfer_t *transfer, CURLcode res, upload_response_t *response)
+{
+    host_config_t *host = transfer->host;
 
-        res = curl_easy_perform(curl);
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response->http_code);
 
-        clock_gettime(CLOCK_MONOTONIC, &end_time);
-        double time_taken_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0;
-        time_taken_ms += (end_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
-        response->request_time_ms = time_taken_ms;
+    long connects = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_NUM_CONNECTS, &connects);
+    log_debug("Upload to %s used %s", host->name, connects ? "a new connection" : "a warm connection");
 
-        fprintf(stderr, "\r\033[K");
+    /* 4xx and unparsable bodies still prove the host is up; only transport errors and 5xx count. */
+    bool overflow = res == CURLE_WRITE_ERROR && transfer->response_data->overflow;
 
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->http_code);
+    /* An oversized answer trips our own cap, not the host, so it does not count either. */
+    if ((res != CURLE_OK && !overflow) || response->http_code >= 500)
+    {
+        health_record_failure(host->name);
+    }
+    else
+    {
+        health_record_success(host->name);
+    }
 
-        if (res != CURLE_OK)
+    if (res != CURLE_OK)
+    {
+        if (overflow)
         {
-            free(response->error_message);
-            response->error_message = strdup(curl_easy_strerror(res));
-            log_error("Upload failed: %s", response->error_message);
+            char error[96];
+            snprintf(error,
+                     sizeof(error),
+                     "Response exceeded the maximum size of %zu bytes",
+                     transfer->response_data->max_size);
+            set_error(response, error);
         }
-        else if (response->http_code >= 200 && response->http_code < 300)
+        else
         {
-            char *url = extract_json_string(response_data.data, host->response_url_json_path);
-            if (url)
-            {
-                response->success = true;
-                response->url = url;
-                log_info("Upload successful, URL: %s", url);
+            set_error(response,
+                      res == CURLE_ABORTED_BY_CALLBACK && transfer->prog_data.abort_reason[0]
+                        ? transfer->prog_data.abort_reason
+                        : curl_easy_strerror(res));
+        }
+        if (transfer->racing)
+            log_warn("Upload to %s failed: %s", host->name, response->error_message);
+        else
+            log_error("Upload to %s failed: %s", host->name, response->error_message);
+    }
+    else if (response->http_code >= 200 && response->http_code < 300)
+    {
+        char *url = extract_json_string(
+          &response->arena, transfer->response_data->data, host->response_url_json_path);
+        if (url)
+        {
+            response->success = true;
+            response->url = url;
+            log_info("Upload successful, URL: %s", url);
 
-                if (host->response_deletion_url_json_path &&
-                    strlen(host->response_deletion_url_json_path) > 0)
+            if (host->response_deletion_url_json_path &&
+                strlen(host->response_deletion_url_json_path) > 0)
+            {
+                char *deletion_url = extract_json_string(&response->arena,
+                                                         transfer->response_data->data,
+                                                         host->response_deletion_url_json_path);
+                if (deletion_url)
                 {
-                    char *deletion_url = extract_json_string(response_data.data,
-                                                             host->response_deletion_url_json_path);
-                    if (deletion_url)
-                    {
-                        response->deletion_url = deletion_url;
-                        log_info("Deletion URL extracted: %s", deletion_url);
-                    }
-                    else
-                    {
-                        log_warn("Could not extract deletion URL using path: %s",
-                                 host->response_deletion_url_json_path);
-                    }
+                    response->deletion_url = deletion_url;
+                    log_info("Deletion URL extracted: %s", deletion_url);
+                }
+                else
+                {
+                    log_warn("Could not extract deletion URL using path: %s",
+                             host->response_deletion_url_json_path);
                 }
-                break;
-            }
-            else
-            {
-                free(response->error_message);
-                response->error_message = strdup("Failed to extract URL from response");
-                log_error("Failed to extract URL from response: %s", response_data.data);
             }
         }
-
-        curl_easy_cleanup(curl);
-        curl_mime_free(mime);
-        curl_slist_free_all(headers);
-        headers = NULL;
-
+        else
+        {
+            set_error(response, "Failed to extract URL from response");
+            log_error("Failed to extract URL from response: %s", transfer->response_data->data);
+        }
+    }
+    else
+    {
+        char error[64];
+        snprintf(error, sizeof(error), "Host returned HTTP %ld", response->http_code);
+        set_error(response, error);
+        if (transfer->racing)
+            log_warn("Upload to %s failed: %s", host->name, error);
+        else
+            log_error("Upload to %s failed: %s", host->name, error);
+    }
+
+    if (!response->success)
+    {
+        db_record_upload_failure(host->name);
+    }
+}
+
+static upload_response_t *
+upload_file(const char *file_path, host_config_t *host)
+{
+    CURLcode res;
+    upload_transfer_t transfer = { 0 };
+    upload_response_t *response = upload_response_new();
+    int retry_count = 0;
+
+    if (!response)
+    {
+        return NULL;
+    }
+
+    if (access(file_path, R_OK) != 0)
+    {
+        set_error(response, "File not found or not readable");
+        return response;
+    }
+
+    struct stat file_stat;
+    if (stat(file_path, &file_stat) != 0)
+    {
+        set_error(response, "Failed to get file information");
+        return response;
+    }
+
+    response_buffer_t response_data;
+    if (!response_buffer_init(
+          &response_data, RESPONSE_BUFFER_INITIAL_CAPACITY, global_config.max_response_bytes))
+    {
+        set_error(response, "Failed to allocate response buffer");
+        return response;
+    }
+
+    do
+    {
+        if (!health_allow_request(host->name))
+        {
+            set_error(response, "Host is unhealthy (circuit open), failing fast");
+            response->circuit_open = true;
+            break;
+        }
+
+        if (retry_count > 0)
+        {
+            log_info(
+              "Retrying upload (attempt %d of %d)", retry_count + 1, global_config.max_retries);
+            usleep(global_config.retry_delay_ms * 1000);
+        }
+
+        if (!upload_transfer_setup(
+              &transfer, file_path, host, &response_data, response))
+        {
+            break;
+        }
+
+        transfer.prog_data.bar = progress_add_bar(file_label(file_path));
+
+        preconnect_join();
+        log_info("Connecting to host: %s (attempt %d)", host->api_endpoint, retry_count + 1);
+        double start_ms = monotonic_ms();
+
+        res = curl_easy_perform(transfer.curl);
+
+        response->request_time_ms = monotonic_ms() - start_ms;
+
+        upload_transfer_parse(&transfer, res, response);
+        upload_transfer_cleanup(&transfer);
+
         retry_count++;
     } while (retry_count < global_config.max_retries && !response->success);
 
+    response_buffer_free(&response_data);
     response->retry_count = retry_count;
-    free(response_data.data);
 
     return response;
 }
 
+upload_response_t *
+network_upload_file(const char *file_path, host_config_t *host)
+{
+    log_context_t context = log_push_context(host->name, 0);
+    upload_response_t *response = upload_file(file_path, host);
+    log_pop_context(context);
+    return response;
+}
+
+/* Deletion URLs of copies left behind by losing race entrants; see network_delete_redundant. */
+static char **redundant_urls = NULL;
+static int redundant_count = 0;
+
+static void
+add_redundant_copy(const char *deletion_url)
+{
+    char **urls = realloc(redundant_urls, (redundant_count + 1) * sizeof(char *));
+    char *url = strdup(deletion_url);
+    if (!urls || !url)
+    {
+        log_error("Failed to remember redundant copy %s", deletion_url);
+        free(url);
+        if (urls)
+            redundant_urls = urls;
+        return;
+    }
+    redundant_urls = urls;
+    redundant_urls[redundant_count++] = url;
+}
+
+typedef struct
+{
+    CURLM *multi;
+    upload_transfer_t *transfers;
+    upload_response_t **responses;
+    response_buffer_t *buffers;
+    int host_count;
+    double start_ms;
+    double drain_until_ms;
+    int winner;
+} race_state_t;
+
+/* A decided race whose losers are still answering; network_delete_redundant finishes it. */
+static race_state_t *unfinished_race = NULL;
+
+static void
+race_read_results(race_state_t *race)
+{
+    CURLMsg *msg;
+    int queued;
+    while ((msg = curl_multi_info_read(race->multi, &queued)))
+    {
+        if (msg->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+
+        upload_transfer_t *transfer = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+        int index = (int)(transfer - race->transfers);
+
+        upload_response_t *response = race->responses[index];
+        response->request_time_ms = monotonic_ms() - race->start_ms;
+        response->retry_count = 1;
+        upload_transfer_parse(transfer, msg->data.result, response);
+        transfer->done = true;
+        curl_multi_remove_handle(race->multi, transfer->curl);
+
+        if (!response->success)
+        {
+            continue;
+        }
+
+        if (race->winner < 0)
+        {
+            race->winner = index;
+            log_info("Host %s won the race in %.2f ms",
+                     transfer->host->name,
+                     response->request_time_ms);
+        }
+        else if (response->deletion_url)
+        {
+            add_redundant_copy(response->deletion_url);
+        }
+        else
+        {
+            log_warn("Host %s kept a redundant copy without a deletion URL: %s",
+                     transfer->host->name,
+                     response->url);
+        }
+    }
+}
+
+/* Add a transfer to a multi, where its compressor must pause rather than block a read. */
+static void
+upload_transfer_add(upload_transfer_t *transfer, CURLM *multi)
+{
+    if (transfer->prog_data.source)
+    {
+        compress_stream_attach_multi(transfer->prog_data.source, multi);
+    }
+    curl_multi_add_handle(multi, transfer->curl);
+}
+
+/* Unpause a transfer whose compressor has caught up since its read paused it. */
+static void
+upload_transfer_resume(upload_transfer_t *transfer)
+{
+    if (transfer->curl && transfer->prog_data.source &&
+        compress_stream_resume(transfer->prog_data.source))
+    {
+        curl_easy_pause(transfer->curl, CURLPAUSE_CONT);
+    }
+}
+
+/* One round of transfers; false when the multi handle fails. */
+static bool
+race_step(race_state_t *race, int timeout_ms, int *running)
+{
+    CURLMcode mc = curl_multi_perform(race->multi, running);
+    if (mc == CURLM_OK && *running > 0)
+    {
+        mc = curl_multi_poll(race->multi, NULL, 0, timeout_ms, NULL);
+    }
+    if (mc != CURLM_OK)
+    {
+        log_error("Race aborted: %s", curl_multi_strerror(mc));
+        return false;
+    }
+
+    for (int i = 0; i < race->host_count; i++)
+    {
+        if (!race->transfers[i].done)
+        {
+            upload_transfer_resume(&race->transfers[i]);
+        }
+    }
+    race_read_results(race);
+    return true;
+}
+
+/* A streamed body has no known length, so it may have arrived and counts as sent. */
+static bool
+upload_fully_sent(CURL *curl)
+{
+    curl_off_t total = -1;
+    curl_off_t sent = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_UPLOAD_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &sent);
+    return total < 0 || sent >= total;
+}
+
+/* Abort the losers that have not sent the whole file; returns how many are still running. */
+static int
+race_abort_unsent(race_state_t *race)
+{
+    int remaining = 0;
+    for (int i = 0; i < race->host_count; i++)
+    {
+        upload_transfer_t *transfer = &race->transfers[i];
+        if (!transfer->curl || transfer->done)
+        {
+            continue;
+        }
+        if (upload_fully_sent(transfer->curl))
+        {
+            remaining++;
+            continue;
+        }
+
+        log_info("Aborting losing upload to host: %s", transfer->host->name);
+        curl_multi_remove_handle(race->multi, transfer->curl);
+        transfer->done = true;
+    }
+    return remaining;
+}
+
+static void
+race_free(race_state_t *race)
+{
+    for (int i = 0; i < race->host_count; i++)
+    {
+        if (race->transfers[i].curl && !race->transfers[i].done)
+        {
+            log_warn("Gave up waiting for host %s, which may keep a redundant copy",
+                     race->transfers[i].host->name);
+            curl_multi_remove_handle(race->multi, race->transfers[i].curl);
+        }
+        upload_transfer_cleanup(&race->transfers[i]);
+        network_free_response(race->responses[i]);
+        response_buffer_free(&race->buffers[i]);
+    }
+    curl_multi_cleanup(race->multi);
+    free(race->responses);
+    free(race->buffers);
+    free(race->transfers);
+    free(race);
+}
+
+/*
+ * Losers still sending were aborted, so their hosts never got a whole file. One that had sent
+ * everything may already have stored it; give it until the deadline to answer so its copy can
+ * be deleted too.
+ */
+static void
+race_drain(race_state_t *race)
+{
+    int running = 1;
+    while (race_abort_unsent(race) > 0 && monotonic_ms() < race->drain_until_ms)
+    {
+        if (!race_step(race, 100, &running))
+        {
+            break;
+        }
+    }
+    race_free(race);
+}
+
+upload_response_t *
+network_upload_race(const char *file_path,
+                    host_config_t **hosts,
+                    int host_count,
+                    int *winner_index)
+{
+    *winner_index = -1;
+
+    upload_response_t *result = upload_response_new();
+    if (!result)
+    {
+        return NULL;
+    }
+
+    if (host_count <= 0)
+    {
+        set_error(result, "No hosts available to race");
+        return result;
+    }
+
+    if (access(file_path, R_OK) != 0)
+    {
+        set_error(result, "File not found or not readable");
+        return result;
+    }
+
+    /* An earlier race on this process must not keep its losers running alongside this one. */
+    network_delete_redundant();
+
+    race_state_t *race = calloc(1, sizeof(race_state_t));
+    upload_transfer_t *transfers = calloc(host_count, sizeof(upload_transfer_t));
+    upload_response_t **responses = calloc(host_count, sizeof(upload_response_t *));
+    response_buffer_t *buffers = calloc(host_count, sizeof(response_buffer_t));
+    CURLM *multi = curl_multi_init();
+
+    if (!race || !transfers || !responses || !buffers || !multi)
+    {
+        log_error("Failed to allocate race state");
+        free(race);
+        free(transfers);
+        free(responses);
+        free(buffers);
+        if (multi)
+            curl_multi_cleanup(multi);
+        set_error(result, "Failed to allocate race state");
+        return result;
+    }
+
+    int started = 0;
+    for (int i = 0; i < host_count; i++)
+    {
+        /* Hosts skipped below never get a bar, and must not remove someone else's bar 0. */
+        transfers[i].prog_data.bar = -1;
+        responses[i] = upload_response_new();
+        if (!responses[i])
+        {
+            continue;
+        }
+
+        if (!health_allow_request(hosts[i]->name))
+        {
+            log_warn("Skipping host %s in race: circuit open", hosts[i]->name);
+            transfers[i].done = true;
+            continue;
+        }
+
+        if (!response_buffer_init(
+              &buffers[i], RESPONSE_BUFFER_INITIAL_CAPACITY, global_config.max_response_bytes) ||
+            !upload_transfer_setup(
+              &transfers[i], file_path, hosts[i], &buffers[i], responses[i]))
+        {
+            log_warn("Skipping host %s in race: %s", hosts[i]->name, responses[i]->error_message);
+            transfers[i].done = true;
+            continue;
+        }
+
+        transfers[i].racing = true;
+        transfers[i].prog_data.bar = progress_add_bar(hosts[i]->name);
+        curl_easy_setopt(transfers[i].curl, CURLOPT_PRIVATE, &transfers[i]);
+        upload_transfer_add(&transfers[i], multi);
+        started++;
+        log_info("Racing upload to host: %s", hosts[i]->name);
+    }
+
+    preconnect_join();
+    *race = (race_state_t){
+        .multi = multi,
+        .transfers = transfers,
+        .responses = responses,
+        .buffers = buffers,
+        .host_count = host_count,
+        .start_ms = monotonic_ms(),
+        .winner = -1,
+    };
+
+    int running = started;
+    while (running > 0 && race->winner < 0)
+    {
+        if (!race_step(race, 1000, &running))
+        {
+            break;
+        }
+    }
+
+    int winner = race->winner;
+    if (winner >= 0)
+    {
+        network_free_response(result);
+        result = responses[winner];
+        responses[winner] = NULL;
+        *winner_index = winner;
+    }
+    else
+    {
+        set_error(result, "All hosts in the race failed");
+        for (int i = 0; i < host_count; i++)
+        {
+            if (responses[i] && responses[i]->error_message)
+            {
+                log_error("Race candidate %s failed: %s", hosts[i]->name, responses[i]->error_message);
+            }
+        }
+    }
+
+    /* Losers worth waiting for finish after the caller has shown the winner. */
+    if (winner >= 0 && race_abort_unsent(race) > 0)
+    {
+        for (int i = 0; i < host_count; i++)
+        {
+            progress_remove_bar(transfers[i].prog_data.bar);
+            transfers[i].prog_data.bar = -1;
+        }
+        race->drain_until_ms = monotonic_ms() + DEFAULT_RACE_DRAIN_MS;
+        unfinished_race = race;
+    }
+    else
+    {
+        race_free(race);
+    }
+
+    return result;
+}
+
+#define BATCH_PREPARE_POLL_MS 20
+
+typedef enum
+{
+    BATCH_PENDING,
+    BATCH_RUNNING,
+    BATCH_DONE
+} batch_state_t;
+
+typedef struct
+{
+    upload_transfer_t transfer;
+    upload_response_t *response;
+    const char *upload_path;
+    batch_state_t state;
+    int attempts;
+    double started_ms;
+    double retry_at_ms;
+} batch_item_t;
+
+static void
+batch_finish_item(batch_item_t *item,
+                  int index,
+                  char **file_paths,
+                  upload_batch_callback_t callback,
+                  void *userdata)
+{
+    item->state = BATCH_DONE;
+    item->response->retry_count = item->attempts;
+    upload_transfer_cleanup(&item->transfer);
+
+    if (callback)
+    {
+        /* Results are printed by the caller; get the bars out of the way first. */
+        progress_clear();
+        callback(index, file_paths[index], item->response, userdata);
+    }
+
+    network_free_response(item->response);
+    item->response = NULL;
+}
+
+static bool
+batch_start_item(CURLM *multi,
+                 batch_item_t *item,
+                 const char *file_path,
+                 host_config_t *host,
+                 response_buffer_t *response_data)
+{
+    if (!item->response)
+    {
+        item->response = upload_response_new();
+        if (!item->response)
+        {
+            return false;
+        }
+    }
+
+    if (!health_allow_request(host->name))
+    {
+        set_error(item->response, "Host is unhealthy (circuit open), failing fast");
+        item->response->circuit_open = true;
+        return false;
+    }
+
+    item->response->error_message = NULL;
+
+    if (access(file_path, R_OK) != 0)
+    {
+        set_error(item->response, "File not found or not readable");
+        return false;
+    }
+
+    if (!upload_transfer_setup(&item->transfer, file_path, host, response_data, item->response))
+    {
+        return false;
+    }
+
+    item->transfer.prog_data.bar = progress_add_bar(file_label(file_path));
+    /* Wait for a connection that may multiplex rather than racing to open another one. */
+    curl_easy_setopt(item->transfer.curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(item->transfer.curl, CURLOPT_PRIVATE, item);
+    upload_transfer_add(&item->transfer, multi);
+
+    item->state = BATCH_RUNNING;
+    item->attempts++;
+    item->started_ms = monotonic_ms();
+    log_info("Uploading %s to %s (attempt %d)", file_path, host->name, item->attempts);
+
+    return true;
+}
+
+static int
+upload_batch(char **file_paths,
+             int file_count,
+             host_config_t *host,
+             int concurrency,
+             upload_prepare_callback_t prepare,
+             upload_batch_callback_t callback,
+             void *userdata,
+             upload_batch_stats_t *stats)
+{
+    if (file_count <= 0)
+    {
+        return 0;
+    }
+
+    if (concurrency < 1)
+    {
+        concurrency = DEFAULT_BATCH_CONCURRENCY;
+    }
+
+    /*
+     * The multi handle owns the connection cache, so keeping one for the whole process lets
+     * successive batches (queue claims, watch bursts) reuse connections that are still open.
+     */
+    if (!batch_multi)
+    {
+        batch_multi = curl_multi_init();
+        if (batch_multi)
+        {
+            curl_multi_setopt(batch_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        }
+    }
+    CURLM *multi = batch_multi;
+
+    batch_item_t *items = calloc(file_count, sizeof(batch_item_t));
+    response_buffer_t *buffers = calloc(concurrency, sizeof(response_buffer_t));
+    response_buffer_t **free_buffers = calloc(concurrency, sizeof(response_buffer_t *));
+    if (!items || !buffers || !free_buffers || !multi)
+    {
+        log_error("Failed to allocate batch upload state");
+        free(items);
+        free(buffers);
+        free(free_buffers);
+        return 0;
+    }
+
+    /* Items that fail before getting a bar must not remove someone else's bar 0. */
+    for (int i = 0; i < file_count; i++)
+    {
+        items[i].transfer.prog_data.bar = -1;
+    }
+
+    /*
+     * HTTP/2 hosts carry every upload as a stream on one connection; HTTP/1.1 hosts still get
+     * one connection per concurrent upload, which is also the cap here.
+     */
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)concurrency);
+
+    /* One response buffer per slot, handed from each finished transfer to the next one. */
+    int buffer_count = concurrency;
+    int free_buffer_count = 0;
+    for (int i = 0; i < buffer_count; i++)
+    {
+        if (response_buffer_init(
+              &buffers[i], RESPONSE_BUFFER_INITIAL_CAPACITY, global_config.max_response_bytes))
+        {
+            free_buffers[free_buffer_count++] = &buffers[i];
+        }
+    }
+    if (free_buffer_count == 0)
+    {
+        free(items);
+        free(buffers);
+        free(free_buffers);
+        return 0;
+    }
+    concurrency = free_buffer_count;
+
+    preconnect_join();
+
+    int next_new = 0;
+    int running = 0;
+    int waiting_retries = 0;
+    int finished = 0;
+    int succeeded = 0;
+
+    while (finished < file_count)
+    {
+        double now = monotonic_ms();
+
+        /* Retries first so a flaky file is not starved by the rest of the batch. */
+        for (int i = 0; i < next_new && waiting_retries > 0 && running < concurrency; i++)
+        {
+            batch_item_t *item = &items[i];
+            if (item->state != BATCH_PENDING || item->retry_at_ms > now)
+                continue;
+
+            waiting_retries--;
+            response_buffer_t *buffer = free_buffers[--free_buffer_count];
+            if (batch_start_item(multi, item, item->upload_path, host, buffer))
+            {
+                running++;
+            }
+            else
+            {
+                free_buffers[free_buffer_count++] = buffer;
+                batch_finish_item(item, i, file_paths, callback, userdata);
+                finished++;
+            }
+        }
+
+        bool preparing = false;
+        while (next_new < file_count && running < concurrency)
+        {
+            int i = next_new;
+            items[i].upload_path = prepare ? prepare(i, userdata) : file_paths[i];
+            if (!items[i].upload_path)
+            {
+                preparing = true;
+                break;
+            }
+
+            next_new++;
+            response_buffer_t *buffer = free_buffers[--free_buffer_count];
+            if (batch_start_item(multi, &items[i], items[i].upload_path, host, buffer))
+            {
+                running++;
+                continue;
+            }
+
+            free_buffers[free_buffer_count++] = buffer;
+            if (items[i].response)
+            {
+                batch_finish_item(&items[i], i, file_paths, callback, userdata);
+                finished++;
+            }
+            else
+            {
+                finished++;
+            }
+        }
+
+        if (running == 0 && waiting_retries == 0 && !preparing)
+        {
+            continue;
+        }
+
+        int still_running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc == CURLM_OK)
+        {
+            int timeout_ms = 1000;
+            if (preparing)
+            {
+                /* Check back soon for the file being prepared. */
+                timeout_ms = BATCH_PREPARE_POLL_MS;
+            }
+            else if (running == 0)
+            {
+                /* Nothing in flight, just sleep until the next retry is due. */
+                timeout_ms = (int)global_config.retry_delay_ms;
+            }
+            mc = curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+        }
+        if (mc != CURLM_OK)
+        {
+            log_error("Batch upload aborted: %s", curl_multi_strerror(mc));
+            break;
+        }
+
+        for (int i = 0; i < next_new; i++)
+        {
+            if (items[i].state == BATCH_RUNNING)
+            {
+                upload_transfer_resume(&items[i].transfer);
+            }
+        }
+
+        CURLMsg *msg;
+        int queued;
+        while ((msg = curl_multi_info_read(multi, &queued)))
+        {
+            if (msg->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+
+            batch_item_t *item = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&item);
+            int index = (int)(item - items);
+
+            item->response->request_time_ms = monotonic_ms() - item->started_ms;
+            upload_transfer_parse(&item->transfer, msg->data.result, item->response);
+
+            if (stats)
+            {
+                long connects = 0;
+                curl_easy_getinfo(item->transfer.curl, CURLINFO_NUM_CONNECTS, &connects);
+                stats->transfers++;
+                stats->connections += connects;
+                if (item->transfer.prog_data.tls)
+                    stats->tls_handshakes += connects;
+            }
+            curl_multi_remove_handle(multi, item->transfer.curl);
+            free_buffers[free_buffer_count++] = item->transfer.response_data;
+            running--;
+
+            if (item->response->success || item->attempts >= global_config.max_retries)
+            {
+                if (item->response->success)
+                    succeeded++;
+                batch_finish_item(item, index, file_paths, callback, userdata);
+                finished++;
+            }
+            else
+            {
+                upload_transfer_cleanup(&item->transfer);
+                item->state = BATCH_PENDING;
+                item->retry_at_ms = monotonic_ms() + global_config.retry_delay_ms;
+                waiting_retries++;
+            }
+        }
+    }
+
+    for (int i = 0; i < file_count; i++)
+    {
+        if (items[i].state == BATCH_RUNNING)
+        {
+            curl_multi_remove_handle(multi, items[i].transfer.curl);
+        }
+        upload_transfer_cleanup(&items[i].transfer);
+        network_free_response(items[i].response);
+    }
+    progress_clear();
+    for (int i = 0; i < buffer_count; i++)
+    {
+        response_buffer_free(&buffers[i]);
+    }
+    free(buffers);
+    free(free_buffers);
+    free(items);
+
+    return succeeded;
+}
+
+int
+network_upload_batch(char **file_paths,
+                     int file_count,
+                     host_config_t *host,
+                     int concurrency,
+                     upload_prepare_callback_t prepare,
+                     upload_batch_callback_t callback,
+                     void *userdata,
+                     upload_batch_stats_t *stats)
+{
+    log_context_t context = log_push_context(host->name, 0);
+    int result =
+      upload_batch(file_paths, file_count, host, concurrency, prepare, callback, userdata, stats);
+    log_pop_context(context);
+    return result;
+}
+
+static void
+delete_handle_setup(CURL *curl, const char *deletion_url, response_buffer_t *response_data)
+{
+    curl_easy_setopt(curl, CURLOPT_URL, deletion_url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, global_config.timeouts.connect_seconds);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, global_config.timeouts.total_seconds);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_buffer_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_data);
+    if (share)
+    {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+}
+
+static bool
+delete_handle_result(CURL *curl,
+                     CURLcode res,
+                     response_buffer_t *response_data,
+                     long *http_code,
+                     char **error_message)
+{
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
+
+    /* A 2xx whose body was too large to keep still means the file is gone. */
+    bool success = (res == CURLE_OK || (res == CURLE_WRITE_ERROR && response_data->overflow)) &&
+                   *http_code >= 200 && *http_code < 300;
+
+    if (!success && error_message)
+    {
+        *error_message = strdup(res == CURLE_OK || response_data->overflow
+                                  ? "Host rejected the deletion request"
+                                  : curl_easy_strerror(res));
+    }
+    if (response_data->size > 0)
+    {
+        log_debug("Deletion response (HTTP %ld): %s", *http_code, response_data->data);
+    }
+
+    return success;
+}
+
+bool
+network_delete_file(const char *deletion_url, long *http_code, char **error_message)
+{
+    *http_code = 0;
+    if (error_message)
+        *error_message = NULL;
+
+    CURL *curl = curl_easy_init();
+    if (!curl)
+    {
+        if (error_message)
+            *error_message = strdup("Failed to initialize curl");
+        return false;
+    }
+
+    /* Deletion endpoints usually answer with a short page; keep it for the debug log only. */
+    response_buffer_t response_data;
+    if (!response_buffer_init(
+          &response_data, RESPONSE_BUFFER_INITIAL_CAPACITY, global_config.max_response_bytes))
+    {
+        curl_easy_cleanup(curl);
+        if (error_message)
+            *error_message = strdup("Failed to allocate response buffer");
+        return false;
+    }
+
+    delete_handle_setup(curl, deletion_url, &response_data);
+    CURLcode res = curl_easy_perform(curl);
+    bool success = delete_handle_result(curl, res, &response_data, http_code, error_message);
+
+    curl_easy_cleanup(curl);
+    response_buffer_free(&response_data);
+    return success;
+}
+
+typedef struct
+{
+    CURL *curl;
+    int index;
+    response_buffer_t response_data;
+} delete_slot_t;
+
+int
+network_delete_batch(char **deletion_urls,
+                     int url_count,
+                     int max_per_host,
+                     delete_batch_callback_t callback,
+                     void *userdata)
+{
+    if (url_count <= 0)
+    {
+        return 0;
+    }
+
+    if (max_per_host < 1)
+    {
+        max_per_host = DEFAULT_DELETE_HOST_CONNECTIONS;
+    }
+
+    /*
+     * curl queues handles beyond the per-host connection cap itself; the slot count only bounds
+     * how many easy handles and buffers exist at once.
+     */
+    int slot_count = url_count < DEFAULT_DELETE_CONCURRENCY ? url_count : DEFAULT_DELETE_CONCURRENCY;
+    delete_slot_t *slots = calloc(slot_count, sizeof(delete_slot_t));
+    delete_slot_t **free_slots = calloc(slot_count, sizeof(delete_slot_t *));
+    CURLM *multi = curl_multi_init();
+    if (!slots || !free_slots || !multi)
+    {
+        log_error("Failed to allocate deletion batch state");
+        free(slots);
+        free(free_slots);
+        if (multi)
+            curl_multi_cleanup(multi);
+        return 0;
+    }
+
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_per_host);
+
+    int free_count = 0;
+    for (int i = 0; i < slot_count; i++)
+    {
+        slots[i].curl = curl_easy_init();
+        if (slots[i].curl &&
+            response_buffer_init(&slots[i].response_data,
+                                 RESPONSE_BUFFER_INITIAL_CAPACITY,
+                                 global_config.max_response_bytes))
+        {
+            free_slots[free_count++] = &slots[i];
+        }
+    }
+
+    int next = 0;
+    int running = 0;
+    int finished = 0;
+    int succeeded = 0;
+
+    while (finished < url_count)
+    {
+        while (next < url_count && free_count > 0)
+        {
+            delete_slot_t *slot = free_slots[--free_count];
+            slot->index = next++;
+            response_buffer_reset(&slot->response_data);
+            curl_easy_reset(slot->curl);
+            delete_handle_setup(slot->curl, deletion_urls[slot->index], &slot->response_data);
+            curl_easy_setopt(slot->curl, CURLOPT_PRIVATE, slot);
+            curl_multi_add_handle(multi, slot->curl);
+            running++;
+        }
+
+        if (running == 0)
+        {
+            log_error("No deletion handles available");
+            break;
+        }
+
+        int still_running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc == CURLM_OK)
+        {
+            mc = curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+        if (mc != CURLM_OK)
+        {
+            log_error("Deletion batch aborted: %s", curl_multi_strerror(mc));
+            break;
+        }
+
+        CURLMsg *msg;
+        int queued;
+        while ((msg = curl_multi_info_read(multi, &queued)))
+        {
+            if (msg->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+
+            delete_slot_t *slot = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&slot);
+
+            long http_code = 0;
+            char *error_message = NULL;
+            bool success = delete_handle_result(
+              slot->curl, msg->data.result, &slot->response_data, &http_code, &error_message);
+            curl_multi_remove_handle(multi, slot->curl);
+            free_slots[free_count++] = slot;
+            running--;
+            finished++;
+
+            if (success)
+                succeeded++;
+            if (callback)
+                callback(slot->index, success, http_code, error_message, userdata);
+            free(error_message);
+        }
+    }
+
+    for (int i = 0; i < slot_count; i++)
+    {
+        if (slots[i].curl)
+        {
+            curl_multi_remove_handle(multi, slots[i].curl);
+            curl_easy_cleanup(slots[i].curl);
+        }
+        response_buffer_free(&slots[i].response_data);
+    }
+    curl_multi_cleanup(multi);
+    free(free_slots);
+    free(slots);
+
+    return succeeded;
+}
+
+static void
+on_redundant_deleted(int index,
+                     bool success,
+                     long http_code,
+                     const char *error_message,
+                     void *userdata)
+{
+    (void)userdata;
+    if (!success)
+    {
+        log_warn("Failed to delete redundant copy %s: %s",
+                 redundant_urls[index],
+                 http_code > 0 ? "unexpected HTTP status" : error_message);
+    }
+}
+
+/*
+ * Wait a bounded time for losing race entrants that sent the whole file, then delete the copies
+ * they left behind. Callers run this once the result is shown, so the cleanup never delays it;
+ * network_cleanup runs it for anything still pending.
+ */
+void
+network_delete_redundant(void)
+{
+    if (unfinished_race)
+    {
+        race_state_t *race = unfinished_race;
+        unfinished_race = NULL;
+        race_drain(race);
+    }
+
+    if (redundant_count == 0)
+    {
+        return;
+    }
+
+    log_info("Deleting %d redundant remote copies", redundant_count);
+    network_delete_batch(redundant_urls,
+                         redundant_count,
+                         DEFAULT_DELETE_HOST_CONNECTIONS,
+                         on_redundant_deleted,
+                         NULL);
+
+    for (int i = 0; i < redundant_count; i++)
+    {
+        free(redundant_urls[i]);
+    }
+    free(redundant_urls);
+    redundant_urls = NULL;
+    redundant_count = 0;
+}
+
 void
 network_free_response(upload_response_t *response)
 {
     if (response)
     {
-        free(response->url);
-        free(response->deletion_url);
-        free(response->error_message);
+        arena_destroy(&response->arena);
         free(response);
     }
 }
@@ -391,10 +1942,28 @@ network_free_response(upload_response_t *response)
 void
 network_cleanup(void)
 {
+    network_delete_redundant();
+    preconnect_join();
     if (global_config.proxy_url)
     {
         free(global_config.proxy_url);
         global_config.proxy_url = NULL;
     }
+    free(altsvc_path);
+    altsvc_path = NULL;
+    if (batch_multi)
+    {
+        curl_multi_cleanup(batch_multi);
+        batch_multi = NULL;
+    }
+    if (share)
+    {
+        curl_share_cleanup(share);
+        share = NULL;
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        {
+            pthread_mutex_destroy(&share_locks[i]);
+        }
+    }
     curl_global_cleanup();
 }
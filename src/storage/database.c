@@ -2,6 +2,8 @@
 #include "hostman/core/logging.h"
 #include "hostman/core/utils.h"
 #include <errno.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,13 +11,15 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#define DB_BUSY_TIMEOUT_MS 5000
+#define DB_AUTO_VACUUM_INCREMENTAL 2
+
 static sqlite3 *db = NULL;
-static bool has_deletion_url_column = false;
 
 static char *
 db_get_path(void)
 {
-    char *cache_dir = get_cache_dir();
+    const char *cache_dir = get_cache_dir();
     if (!cache_dir)
     {
         return NULL;
@@ -25,60 +29,352 @@ db_get_path(void)
     char *path = malloc(len);
     if (!path)
     {
-        free(cache_dir);
         return NULL;
     }
 
     snprintf(path, len, "%s/history.db", cache_dir);
-    free(cache_dir);
 
     return path;
 }
 
-static bool
-check_deletion_url_column()
+/* Calendar day, in local time, that rollup rows are keyed by. */
+#define STATS_DAY(ts) "date(" ts ", 'unixepoch', 'localtime')"
+
+/*
+ * Latency histogram bucket: the time in whole milliseconds with everything after its first two
+ * digits zeroed, so 1234 ms lands in 1200. That keeps every bucket within 10% of its values
+ * using only string functions, which every SQLite build has.
+ */
+#define LATENCY_BUCKET(ms)                                                                         \
+    "(CASE WHEN length(CAST(CAST(" ms " AS INTEGER) AS TEXT)) <= 2 THEN CAST(" ms " AS INTEGER) " \
+    "ELSE CAST(substr(CAST(CAST(" ms " AS INTEGER) AS TEXT), 1, 2) || "                           \
+    "substr('0000000000000000', 1, length(CAST(CAST(" ms " AS INTEGER) AS TEXT)) - 2) "           \
+    "AS INTEGER) END)"
+
+/* Recompute the upload columns of the rollups from uploads; failures only live in the rollup. */
+#define STATS_REBUILD_SQL                                                                          \
+    "UPDATE upload_stats_daily SET uploads = 0, bytes = 0, optimized = 0, "                        \
+    "optimized_original_bytes = 0, optimized_bytes = 0, timed = 0, time_total_ms = 0;"             \
+    "DELETE FROM upload_latency_daily;"                                                            \
+    "INSERT INTO upload_stats_daily (host_name, day, uploads, bytes, optimized, "                  \
+    "optimized_original_bytes, optimized_bytes, timed, time_total_ms) "                            \
+    "SELECT host_name, " STATS_DAY("timestamp") ", COUNT(*), SUM(size), COUNT(original_size), "    \
+    "COALESCE(SUM(original_size), 0), "                                                            \
+    "COALESCE(SUM(CASE WHEN original_size IS NOT NULL THEN size END), 0), "                        \
+    "COUNT(request_time_ms), COALESCE(SUM(request_time_ms), 0) "                                   \
+    "FROM uploads WHERE true GROUP BY 1, 2 "                                                       \
+    "ON CONFLICT (host_name, day) DO UPDATE SET uploads = excluded.uploads, "                      \
+    "bytes = excluded.bytes, optimized = excluded.optimized, "                                     \
+    "optimized_original_bytes = excluded.optimized_original_bytes, "                               \
+    "optimized_bytes = excluded.optimized_bytes, timed = excluded.timed, "                         \
+    "time_total_ms = excluded.time_total_ms;"                                                      \
+    "INSERT INTO upload_latency_daily (host_name, day, bucket_ms, count) "                         \
+    "SELECT host_name, " STATS_DAY("timestamp") ", " LATENCY_BUCKET("request_time_ms") ", "        \
+    "COUNT(*) FROM uploads WHERE request_time_ms IS NOT NULL GROUP BY 1, 2, 3;"                    \
+    "DELETE FROM upload_stats_daily WHERE uploads = 0 AND failures = 0;"
+
+/*
+ * Schema migrations, applied in order. PRAGMA user_version records the last one applied, so an
+ * up-to-date database costs a single pragma read at startup. Append new steps at the end and
+ * never edit one that has shipped.
+ */
+typedef struct
 {
-    if (!db)
-        return false;
+    const char *description;
+    const char *sql;
+    /*
+     * Set for steps that add a column which databases from before versioning may already have
+     * been given on the fly; such a step is skipped when the column is present.
+     */
+    const char *added_column;
+    /* Optional steps are skipped, with a warning, when SQLite lacks what they need. */
+    bool optional;
+} migration_t;
+
+static const migration_t migrations[] = {
+    { "create tables",
+      "CREATE TABLE IF NOT EXISTS uploads ("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+      "timestamp INTEGER NOT NULL,"
+      "host_name TEXT NOT NULL,"
+      "local_path TEXT NOT NULL,"
+      "remote_url TEXT UNIQUE NOT NULL,"
+      "filename TEXT NOT NULL,"
+      "size INTEGER NOT NULL"
+      ");"
+      "CREATE TABLE IF NOT EXISTS host_health ("
+      "host_name TEXT PRIMARY KEY,"
+      "state INTEGER NOT NULL,"
+      "consecutive_failures INTEGER NOT NULL,"
+      "changed_at INTEGER NOT NULL,"
+      "last_failure_at INTEGER"
+      ");"
+      "CREATE TABLE IF NOT EXISTS upload_queue ("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+      "file_path TEXT NOT NULL,"
+      "host_name TEXT NOT NULL,"
+      "state INTEGER NOT NULL DEFAULT 0,"
+      "attempts INTEGER NOT NULL DEFAULT 0,"
+      "last_error TEXT,"
+      "claimed_by INTEGER,"
+      "created_at INTEGER NOT NULL,"
+      "updated_at INTEGER NOT NULL"
+      ");"
+      "CREATE INDEX IF NOT EXISTS upload_queue_state ON upload_queue (state, id);",
+      NULL,
+      false },
+    { "add deletion URLs",
+      "ALTER TABLE uploads ADD COLUMN deletion_url TEXT;",
+      "deletion_url",
+      false },
+    { "add request times",
+      "ALTER TABLE uploads ADD COLUMN request_time_ms REAL;",
+      "request_time_ms",
+      false },
+    { "add original sizes",
+      "ALTER TABLE uploads ADD COLUMN original_size INTEGER;",
+      "original_size",
+      false },
+    /*
+     * External-content FTS5 index over the searchable columns; the text lives only in uploads
+     * and triggers keep the index in step. The prefix indexes make "screen*" lookups as cheap as
+     * whole-word ones.
+     */
+    { "create search index",
+      "CREATE VIRTUAL TABLE IF NOT EXISTS uploads_fts USING fts5("
+      "filename, local_path, remote_url, host_name, "
+      "content='uploads', content_rowid='id', prefix='2 3');"
+      "CREATE TRIGGER IF NOT EXISTS uploads_fts_insert AFTER INSERT ON uploads BEGIN "
+      "INSERT INTO uploads_fts (rowid, filename, local_path, remote_url, host_name) "
+      "VALUES (new.id, new.filename, new.local_path, new.remote_url, new.host_name); END;"
+      "CREATE TRIGGER IF NOT EXISTS uploads_fts_delete AFTER DELETE ON uploads BEGIN "
+      "INSERT INTO uploads_fts (uploads_fts, rowid, filename, local_path, remote_url, host_name) "
+      "VALUES ('delete', old.id, old.filename, old.local_path, old.remote_url, old.host_name); "
+      "END;"
+      "CREATE TRIGGER IF NOT EXISTS uploads_fts_update "
+      "AFTER UPDATE OF filename, local_path, remote_url, host_name ON uploads BEGIN "
+      "INSERT INTO uploads_fts (uploads_fts, rowid, filename, local_path, remote_url, host_name) "
+      "VALUES ('delete', old.id, old.filename, old.local_path, old.remote_url, old.host_name); "
+      "INSERT INTO uploads_fts (rowid, filename, local_path, remote_url, host_name) "
+      "VALUES (new.id, new.filename, new.local_path, new.remote_url, new.host_name); END;"
+      "INSERT INTO uploads_fts (uploads_fts) VALUES ('rebuild');",
+      NULL,
+      true },
+    { "index upload dates",
+      "CREATE INDEX IF NOT EXISTS uploads_timestamp ON uploads (timestamp);"
+      "CREATE INDEX IF NOT EXISTS uploads_host_timestamp ON uploads (host_name, timestamp);",
+      NULL,
+      false },
+    /*
+     * Per host and day rollups for stats, kept current by triggers so reading them costs
+     * O(hosts x days) however long the history is.
+     */
+    { "add statistics rollups",
+      "CREATE TABLE upload_stats_daily ("
+      "host_name TEXT NOT NULL,"
+      "day TEXT NOT NULL,"
+      "uploads INTEGER NOT NULL DEFAULT 0,"
+      "failures INTEGER NOT NULL DEFAULT 0,"
+      "bytes INTEGER NOT NULL DEFAULT 0,"
+      "optimized INTEGER NOT NULL DEFAULT 0,"
+      "optimized_original_bytes INTEGER NOT NULL DEFAULT 0,"
+      "optimized_bytes INTEGER NOT NULL DEFAULT 0,"
+      "timed INTEGER NOT NULL DEFAULT 0,"
+      "time_total_ms REAL NOT NULL DEFAULT 0,"
+      "PRIMARY KEY (host_name, day)"
+      ") WITHOUT ROWID;"
+      "CREATE TABLE upload_latency_daily ("
+      "host_name TEXT NOT NULL,"
+      "day TEXT NOT NULL,"
+      "bucket_ms INTEGER NOT NULL,"
+      "count INTEGER NOT NULL,"
+      "PRIMARY KEY (host_name, day, bucket_ms)"
+      ") WITHOUT ROWID;"
+      "CREATE TRIGGER uploads_stats_insert AFTER INSERT ON uploads BEGIN "
+      "INSERT INTO upload_stats_daily (host_name, day, uploads, bytes, optimized, "
+      "optimized_original_bytes, optimized_bytes, timed, time_total_ms) "
+      "VALUES (new.host_name, " STATS_DAY("new.timestamp") ", 1, new.size, "
+      "new.original_size IS NOT NULL, COALESCE(new.original_size, 0), "
+      "CASE WHEN new.original_size IS NOT NULL THEN new.size ELSE 0 END, "
+      "new.request_time_ms IS NOT NULL, COALESCE(new.request_time_ms, 0)) "
+      "ON CONFLICT (host_name, day) DO UPDATE SET uploads = uploads + 1, "
+      "bytes = bytes + excluded.bytes, optimized = optimized + excluded.optimized, "
+      "optimized_original_bytes = optimized_original_bytes + excluded.optimized_original_bytes, "
+      "optimized_bytes = optimized_bytes + excluded.optimized_bytes, "
+      "timed = timed + excluded.timed, time_total_ms = time_total_ms + excluded.time_total_ms;"
+      "INSERT INTO upload_latency_daily (host_name, day, bucket_ms, count) "
+      "SELECT new.host_name, " STATS_DAY("new.timestamp") ", "
+      LATENCY_BUCKET("new.request_time_ms") ", 1 WHERE new.request_time_ms IS NOT NULL "
+      "ON CONFLICT (host_name, day, bucket_ms) DO UPDATE SET count = count + 1; END;"
+      "CREATE TRIGGER uploads_stats_delete AFTER DELETE ON uploads BEGIN "
+      "UPDATE upload_stats_daily SET uploads = uploads - 1, bytes = bytes - old.size, "
+      "optimized = optimized - (old.original_size IS NOT NULL), "
+      "optimized_original_bytes = optimized_original_bytes - COALESCE(old.original_size, 0), "
+      "optimized_bytes = optimized_bytes - "
+      "CASE WHEN old.original_size IS NOT NULL THEN old.size ELSE 0 END, "
+      "timed = timed - (old.request_time_ms IS NOT NULL), "
+      "time_total_ms = time_total_ms - COALESCE(old.request_time_ms, 0) "
+      "WHERE host_name = old.host_name AND day = " STATS_DAY("old.timestamp") ";"
+      "DELETE FROM upload_stats_daily WHERE host_name = old.host_name "
+      "AND day = " STATS_DAY("old.timestamp") " AND uploads <= 0 AND failures = 0;"
+      "UPDATE upload_latency_daily SET count = count - 1 WHERE host_name = old.host_name "
+      "AND day = " STATS_DAY("old.timestamp") " "
+      "AND bucket_ms = " LATENCY_BUCKET("old.request_time_ms") ";"
+      "DELETE FROM upload_latency_daily WHERE host_name = old.host_name "
+      "AND day = " STATS_DAY("old.timestamp") " AND count <= 0; END;" STATS_REBUILD_SQL,
+      NULL,
+      false },
+    /* When a claim was made or last renewed; see DEFAULT_QUEUE_LEASE_SECONDS. */
+    { "add queue claim leases",
+      "ALTER TABLE upload_queue ADD COLUMN claimed_at INTEGER;"
+      "UPDATE upload_queue SET claimed_at = updated_at WHERE state = 1;",
+      NULL,
+      false },
+};
 
+#define SCHEMA_VERSION ((int)(sizeof(migrations) / sizeof(migrations[0])))
+
+/* Value of a pragma that returns a single integer, or -1 if it cannot be read. */
+static sqlite3_int64
+read_pragma(const char *sql)
+{
     sqlite3_stmt *stmt;
-    const char *sql = "PRAGMA table_info(uploads);";
-    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    sqlite3_int64 value = -1;
 
-    if (result != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK)
     {
-        log_error("Failed to prepare statement to check schema: %s", sqlite3_errmsg(db));
-        return false;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
     }
 
+    return value;
+}
+
+static int
+read_schema_version(void)
+{
+    return (int)read_pragma("PRAGMA user_version;");
+}
+
+static bool
+column_exists(const char *column)
+{
+    sqlite3_stmt *stmt;
     bool found = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+
+    if (sqlite3_prepare_v2(db, "PRAGMA table_info(uploads);", -1, &stmt, NULL) != SQLITE_OK)
     {
-        const char *column_name = (const char *)sqlite3_column_text(stmt, 1);
-        if (column_name && strcmp(column_name, "deletion_url") == 0)
-        {
-            found = true;
-            break;
-        }
+        return false;
+    }
+
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char *name = (const char *)sqlite3_column_text(stmt, 1);
+        found = name && strcmp(name, column) == 0;
     }
 
     sqlite3_finalize(stmt);
+    return found;
+}
+
+static bool
+apply_migration(const migration_t *migration, int version)
+{
+    char *error_msg = NULL;
 
-    if (!found)
+    if (!migration->optional)
     {
-        log_info("Deletion URL column not found in database schema");
-        const char *alter_sql = "ALTER TABLE uploads ADD COLUMN deletion_url TEXT;";
-        result = sqlite3_exec(db, alter_sql, NULL, NULL, NULL);
-        if (result != SQLITE_OK)
+        if (sqlite3_exec(db, migration->sql, NULL, NULL, &error_msg) != SQLITE_OK)
         {
-            log_warn("Failed to add deletion_url column: %s", sqlite3_errmsg(db));
+            log_error("Database migration %d (%s) failed: %s",
+                      version,
+                      migration->description,
+                      error_msg);
+            sqlite3_free(error_msg);
             return false;
         }
-        log_info("Added deletion_url column to database schema");
-        found = true;
+        return true;
     }
 
-    return found;
+    sqlite3_exec(db, "SAVEPOINT optional_migration;", NULL, NULL, NULL);
+    if (sqlite3_exec(db, migration->sql, NULL, NULL, &error_msg) != SQLITE_OK)
+    {
+        log_warn("Skipping database migration %d (%s): %s",
+                 version,
+                 migration->description,
+                 error_msg);
+        sqlite3_free(error_msg);
+        sqlite3_exec(db, "ROLLBACK TO optional_migration;", NULL, NULL, NULL);
+    }
+    sqlite3_exec(db, "RELEASE optional_migration;", NULL, NULL, NULL);
+    return true;
+}
+
+/* Bring the schema up to SCHEMA_VERSION in one transaction; a failed step leaves it untouched. */
+static bool
+migrate_schema(void)
+{
+    int version = read_schema_version();
+    if (version < 0)
+    {
+        log_error("Failed to read database schema version: %s", sqlite3_errmsg(db));
+        return false;
+    }
+    if (version >= SCHEMA_VERSION)
+    {
+        return true;
+    }
+
+    /*
+     * Only takes effect before the first table is created; older databases are converted by
+     * db_incremental_vacuum or db_vacuum.
+     */
+    if (version == 0)
+    {
+        sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL;", NULL, NULL, NULL);
+    }
+
+    /* IMMEDIATE takes the write lock first, so two processes never migrate at once. */
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to start database migration: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    version = read_schema_version();
+    bool legacy = version == 0;
+    bool ok = version >= 0;
+
+    for (int i = version; ok && i < SCHEMA_VERSION; i++)
+    {
+        const migration_t *migration = &migrations[i];
+        if (legacy && migration->added_column && column_exists(migration->added_column))
+        {
+            continue;
+        }
+
+        log_info("Applying database migration %d: %s", i + 1, migration->description);
+        ok = apply_migration(migration, i + 1);
+    }
+
+    if (ok)
+    {
+        char pragma[64];
+        snprintf(pragma, sizeof(pragma), "PRAGMA user_version = %d;", SCHEMA_VERSION);
+        ok = sqlite3_exec(db, pragma, NULL, NULL, NULL) == SQLITE_OK &&
+             sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK;
+    }
+
+    if (!ok)
+    {
+        log_error("Database schema was left at version %d", version);
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+
+    return ok;
 }
 
 bool
@@ -96,7 +392,7 @@ db_init(void)
         return false;
     }
 
-    char *cache_dir = get_cache_dir();
+    const char *cache_dir = get_cache_dir();
     if (!cache_dir)
     {
         free(db_path);
@@ -108,12 +404,10 @@ db_init(void)
         if (mkdir(cache_dir, 0755) != 0)
         {
             log_error("Failed to create cache directory: %s", cache_dir);
-            free(cache_dir);
             free(db_path);
             return false;
         }
     }
-    free(cache_dir);
 
     int result = sqlite3_open(db_path, &db);
     if (result != SQLITE_OK)
@@ -127,48 +421,32 @@ db_init(void)
 
     free(db_path);
 
-    const char *create_table_sql = "CREATE TABLE IF NOT EXISTS uploads ("
-                                   "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                                   "timestamp INTEGER NOT NULL,"
-                                   "host_name TEXT NOT NULL,"
-                                   "local_path TEXT NOT NULL,"
-                                   "remote_url TEXT UNIQUE NOT NULL,"
-                                   "filename TEXT NOT NULL,"
-                                   "size INTEGER NOT NULL"
-                                   ");";
+    /* watch and queue runners may share the database with another hostman process. */
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
 
-    char *error_msg = NULL;
-    result = sqlite3_exec(db, create_table_sql, NULL, NULL, &error_msg);
-    if (result != SQLITE_OK)
+    if (!migrate_schema())
     {
-        log_error("Failed to create table: %s", error_msg);
-        sqlite3_free(error_msg);
         sqlite3_close(db);
         db = NULL;
         return false;
     }
 
-    has_deletion_url_column = check_deletion_url_column();
-
     return true;
 }
 
-bool
-db_add_upload(const char *host_name,
+static bool
+insert_upload(const char *host_name,
               const char *local_path,
               const char *remote_url,
               const char *deletion_url,
               const char *filename,
-              size_t size)
+              size_t size,
+              size_t original_size,
+              double request_time_ms)
 {
-    if (!db && !db_init())
-    {
-        return false;
-    }
-
     const char *sql = "INSERT INTO uploads (timestamp, host_name, local_path, remote_url, "
-                      "deletion_url, filename, size) "
-                      "VALUES (?, ?, ?, ?, ?, ?, ?);";
+                      "deletion_url, filename, size, request_time_ms, original_size) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
 
     sqlite3_stmt *stmt;
     int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
@@ -187,6 +465,15 @@ db_add_upload(const char *host_name,
     sqlite3_bind_text(stmt, 5, deletion_url, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 6, filename, -1, SQLITE_STATIC);
     sqlite3_bind_int64(stmt, 7, size);
+    if (request_time_ms > 0)
+        sqlite3_bind_double(stmt, 8, request_time_ms);
+    else
+        sqlite3_bind_null(stmt, 8);
+    /* Only set when the file was rewritten before upload; size is then the bytes sent. */
+    if (original_size > 0)
+        sqlite3_bind_int64(stmt, 9, original_size);
+    else
+        sqlite3_bind_null(stmt, 9);
 
     result = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -205,236 +492,1722 @@ db_add_upload(const char *host_name,
         }
     }
 
+    log_context_t context = log_push_context(host_name, sqlite3_last_insert_rowid(db));
     log_info("Added upload to database: %s", remote_url);
+    log_pop_context(context);
     return true;
 }
 
-upload_record_t **
-db_get_uploads(const char *host_name, int page, int limit, int *count)
+bool
+db_add_upload(const char *host_name,
+              const char *local_path,
+              const char *remote_url,
+              const char *deletion_url,
+              const char *filename,
+              size_t size,
+              size_t original_size,
+              double request_time_ms)
 {
-    *count = 0;
-
     if (!db && !db_init())
     {
-        return NULL;
+        return false;
     }
 
-    const char *sql;
+    return insert_upload(host_name,
+                         local_path,
+                         remote_url,
+                         deletion_url,
+                         filename,
+                         size,
+                         original_size,
+                         request_time_ms);
+}
+
+struct db_cursor
+{
     sqlite3_stmt *stmt;
-    int result;
+    upload_row_t row;
+    bool failed;
+};
+
+static void
+append_fts_string(sqlite3_str *match, const char *text, size_t length)
+{
+    sqlite3_str_appendchar(match, 1, '"');
+    for (size_t i = 0; i < length; i++)
+    {
+        /* A quote inside an FTS5 string is written twice. */
+        sqlite3_str_appendchar(match, text[i] == '"' ? 2 : 1, text[i]);
+    }
+    sqlite3_str_appendchar(match, 1, '"');
+}
+
+/*
+ * Turn free text into an FTS5 query: every word must match, as a prefix, in any indexed column.
+ * Words are quoted so that punctuation such as the dot in "shot.png" is not read as query
+ * syntax; the tokenizer still splits them into the same terms the index holds. A host filter
+ * is added as a host_name column match so the index narrows the rows before they are joined.
+ */
+static char *
+build_match_expression(const char *text, const char *host_name)
+{
+    sqlite3_str *match = sqlite3_str_new(db);
+    const char *p = text;
+
+    while (*p)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        size_t word = strcspn(p, " \t");
+        if (word == 0)
+            break;
+
+        if (sqlite3_str_length(match) > 0)
+            sqlite3_str_appendchar(match, 1, ' ');
+        append_fts_string(match, p, word);
+        sqlite3_str_appendchar(match, 1, '*');
+        p += word;
+    }
+
+    if (sqlite3_str_length(match) == 0)
+    {
+        sqlite3_free(sqlite3_str_finish(match));
+        log_error("Search query is empty");
+        return NULL;
+    }
 
     if (host_name)
     {
-        if (has_deletion_url_column)
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, deletion_url, "
-                  "filename, size "
-                  "FROM uploads WHERE host_name = ? "
-                  "ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
-        else
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, filename, size "
-                  "FROM uploads WHERE host_name = ? "
-                  "ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
+        sqlite3_str_appendall(match, " host_name : ");
+        append_fts_string(match, host_name, strlen(host_name));
+    }
 
-        result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (result != SQLITE_OK)
+    return sqlite3_str_finish(match);
+}
+
+/*
+ * Open a query over the upload history. Rows are read one at a time from the statement and the
+ * strings in each row borrow SQLite's column buffers, so a query costs one allocation however
+ * many rows it returns.
+ */
+db_cursor_t *
+db_cursor_open(const db_query_t *query)
+{
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    /* Ids are plain integers, so they are inlined rather than bound one placeholder at a time. */
+    size_t sql_size = 1024 + (size_t)query->id_count * 12;
+    char *sql = malloc(sql_size);
+    if (!sql)
+    {
+        log_error("Failed to allocate memory for history query");
+        return NULL;
+    }
+
+    /*
+     * Scoring every match dominates broad searches, so without filters that need the uploads
+     * row the top hits are picked inside the index and only those few rows are joined.
+     * bm25 weights: a filename hit counts most, then the URL, then the path and host.
+     */
+    bool rank_in_index = query->search && !query->since && !query->before &&
+                         !query->deletable_only && query->id_count == 0;
+    char from[256] = "uploads";
+    if (query->search)
+    {
+        snprintf(from,
+                 sizeof(from),
+                 "(SELECT rowid, bm25(uploads_fts, 10.0, 2.0, 4.0, 1.0) AS score FROM uploads_fts "
+                 "WHERE uploads_fts MATCH ?6%s) AS hits JOIN uploads ON uploads.id = hits.rowid",
+                 rank_in_index ? " ORDER BY score LIMIT ?3 OFFSET ?4" : "");
+    }
+
+    int len = snprintf(sql,
+                       sql_size,
+                       "SELECT uploads.id, uploads.timestamp, uploads.host_name, "
+                       "uploads.local_path, uploads.remote_url, uploads.deletion_url, "
+                       "uploads.filename, uploads.size, uploads.request_time_ms, "
+                       "uploads.original_size FROM %s "
+                       "WHERE (?1 IS NULL OR uploads.host_name = ?1) "
+                       "AND (?2 = 0 OR uploads.timestamp < ?2) "
+                       "AND (?5 = 0 OR uploads.timestamp >= ?5)",
+                       from);
+    if (query->deletable_only)
+    {
+        len += snprintf(sql + len,
+                        sql_size - len,
+                        " AND uploads.deletion_url IS NOT NULL AND uploads.deletion_url != ''");
+    }
+    if (query->id_count > 0)
+    {
+        len += snprintf(sql + len, sql_size - len, " AND uploads.id IN (");
+        for (int i = 0; i < query->id_count; i++)
         {
-            log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
-            return NULL;
+            len += snprintf(sql + len, sql_size - len, "%s%d", i > 0 ? "," : "", query->ids[i]);
         }
+        len += snprintf(sql + len, sql_size - len, ")");
+    }
+    /* Row values let SQLite seek the (timestamp, rowid) index instead of skipping an offset. */
+    bool backwards = query->newest_first && query->backwards;
+    if (query->newest_first && query->after)
+    {
+        len += snprintf(sql + len,
+                        sql_size - len,
+                        " AND (uploads.timestamp, uploads.id) %s (?7, ?8)",
+                        backwards ? ">" : "<");
+    }
 
-        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 2, limit);
-        sqlite3_bind_int(stmt, 3, (page - 1) * limit);
+    const char *order = query->search         ? "hits.score, uploads.id DESC"
+                        : backwards           ? "uploads.timestamp, uploads.id"
+                        : query->newest_first ? "uploads.timestamp DESC, uploads.id DESC"
+                                              : "uploads.id";
+    snprintf(sql + len,
+             sql_size - len,
+             " ORDER BY %s%s;",
+             order,
+             rank_in_index ? "" : " LIMIT ?3 OFFSET ?4");
+
+    char *match = NULL;
+    if (query->search && !(match = build_match_expression(query->search, query->host_name)))
+    {
+        free(sql);
+        return NULL;
+    }
+
+    db_cursor_t *cursor = calloc(1, sizeof(db_cursor_t));
+    if (!cursor)
+    {
+        log_error("Failed to allocate memory for history cursor");
+        sqlite3_free(match);
+        free(sql);
+        return NULL;
+    }
+
+    int result = sqlite3_prepare_v2(db, sql, -1, &cursor->stmt, NULL);
+    free(sql);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_free(match);
+        free(cursor);
+        return NULL;
     }
+
+    if (query->host_name)
+        sqlite3_bind_text(cursor->stmt, 1, query->host_name, -1, SQLITE_STATIC);
     else
+        sqlite3_bind_null(cursor->stmt, 1);
+    sqlite3_bind_int64(cursor->stmt, 2, (sqlite3_int64)query->before);
+    sqlite3_bind_int(cursor->stmt, 3, query->limit > 0 ? query->limit : -1);
+    sqlite3_bind_int(cursor->stmt, 4, query->offset);
+    sqlite3_bind_int64(cursor->stmt, 5, (sqlite3_int64)query->since);
+    if (match)
     {
-        if (has_deletion_url_column)
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, deletion_url, "
-                  "filename, size "
-                  "FROM uploads ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
-        else
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, filename, size "
-                  "FROM uploads ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
+        sqlite3_bind_text(cursor->stmt, 6, match, -1, sqlite3_free);
+    }
+    if (query->newest_first && query->after)
+    {
+        sqlite3_bind_int64(cursor->stmt, 7, (sqlite3_int64)query->after->timestamp);
+        sqlite3_bind_int64(cursor->stmt, 8, query->after->id);
+    }
+
+    return cursor;
+}
+
+/*
+ * Step to the next row. The returned row, and the strings in it, stay valid until the next call
+ * or until the cursor is closed. Returns NULL at the end of the results or on error.
+ */
+const upload_row_t *
+db_cursor_next(db_cursor_t *cursor)
+{
+    if (!cursor || cursor->failed)
+    {
+        return NULL;
+    }
 
-        result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (result != SQLITE_OK)
+    int result = sqlite3_step(cursor->stmt);
+    if (result != SQLITE_ROW)
+    {
+        if (result != SQLITE_DONE)
         {
-            log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
-            return NULL;
+            log_error("Failed to read upload history: %s", sqlite3_errmsg(db));
+            cursor->failed = true;
         }
+        return NULL;
+    }
+
+    sqlite3_stmt *stmt = cursor->stmt;
+    cursor->row = (upload_row_t){
+        .id = sqlite3_column_int64(stmt, 0),
+        .timestamp = (time_t)sqlite3_column_int64(stmt, 1),
+        .host_name = (const char *)sqlite3_column_text(stmt, 2),
+        .local_path = (const char *)sqlite3_column_text(stmt, 3),
+        .remote_url = (const char *)sqlite3_column_text(stmt, 4),
+        .deletion_url = (const char *)sqlite3_column_text(stmt, 5),
+        .filename = (const char *)sqlite3_column_text(stmt, 6),
+        .size = sqlite3_column_int64(stmt, 7),
+        .request_time_ms = sqlite3_column_double(stmt, 8),
+        .original_size = sqlite3_column_int64(stmt, 9),
+    };
+
+    return &cursor->row;
+}
+
+/* Returns false if reading stopped because of an error rather than the end of the results. */
+bool
+db_cursor_close(db_cursor_t *cursor)
+{
+    if (!cursor)
+    {
+        return false;
+    }
+
+    bool ok = !cursor->failed;
+    sqlite3_finalize(cursor->stmt);
+    free(cursor);
+    return ok;
+}
+
+/*
+ * Bulk deletion keeps the rows across network requests, so these are copied out of the cursor
+ * into the caller's arena; they are released with it.
+ */
+upload_record_t *
+db_get_deletion_targets(arena_t *arena,
+                        const char *host_name,
+                        time_t before,
+                        const int *ids,
+                        int id_count,
+                        int *count)
+{
+    *count = 0;
 
-        sqlite3_bind_int(stmt, 1, limit);
-        sqlite3_bind_int(stmt, 2, (page - 1) * limit);
+    db_query_t query = {
+        .host_name = host_name,
+        .before = before,
+        .ids = ids,
+        .id_count = id_count,
+        .deletable_only = true,
+    };
+    db_cursor_t *cursor = db_cursor_open(&query);
+    if (!cursor)
+    {
+        return NULL;
     }
 
-    upload_record_t **records = NULL;
+    upload_record_t *records = NULL;
     int capacity = 0;
+    bool ok = true;
+    const upload_row_t *row;
 
-    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    while ((row = db_cursor_next(cursor)))
     {
         if (*count >= capacity)
         {
-            capacity = capacity == 0 ? 10 : capacity * 2;
-            upload_record_t **new_records = realloc(records, capacity * sizeof(upload_record_t *));
+            /* Outgrown arrays stay in the arena; together they are smaller than the last one. */
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            upload_record_t *new_records = arena_alloc(arena, capacity * sizeof(upload_record_t));
             if (!new_records)
             {
-                log_error("Failed to allocate memory for upload records");
-                for (int i = 0; i < *count; i++)
-                {
-                    free(records[i]->host_name);
-                    free(records[i]->local_path);
-                    free(records[i]->remote_url);
-                    if (records[i]->deletion_url)
-                        free(records[i]->deletion_url);
-                    free(records[i]->filename);
-                    free(records[i]);
-                }
-                free(records);
-                sqlite3_finalize(stmt);
-                return NULL;
+                ok = false;
+                break;
             }
-            records = new_records;
-        }
-
-        upload_record_t *record = malloc(sizeof(upload_record_t));
-        if (!record)
-        {
-            log_error("Failed to allocate memory for upload record");
-            for (int i = 0; i < *count; i++)
+            if (*count > 0)
             {
-                free(records[i]->host_name);
-                free(records[i]->local_path);
-                free(records[i]->remote_url);
-                if (records[i]->deletion_url)
-                    free(records[i]->deletion_url);
-                free(records[i]->filename);
-                free(records[i]);
+                memcpy(new_records, records, *count * sizeof(upload_record_t));
             }
-            free(records);
-            sqlite3_finalize(stmt);
-            return NULL;
-        }
-
-        int col_offset = 0;
-        record->id = sqlite3_column_int(stmt, 0);
-        record->timestamp = sqlite3_column_int64(stmt, 1);
-        record->host_name = strdup((const char *)sqlite3_column_text(stmt, 2));
-        record->local_path = strdup((const char *)sqlite3_column_text(stmt, 3));
-        record->remote_url = strdup((const char *)sqlite3_column_text(stmt, 4));
-
-        if (has_deletion_url_column)
-        {
-            const unsigned char *deletion_url_text = sqlite3_column_text(stmt, 5);
-            record->deletion_url =
-              deletion_url_text ? strdup((const char *)deletion_url_text) : NULL;
-            col_offset = 1;
-        }
-        else
-        {
-            record->deletion_url = NULL;
+            records = new_records;
         }
 
-        record->filename = strdup((const char *)sqlite3_column_text(stmt, 5 + col_offset));
-        record->size = sqlite3_column_int64(stmt, 6 + col_offset);
-
-        records[*count] = record;
-        (*count)++;
+        upload_record_t *record = &records[(*count)++];
+        record->id = (int)row->id;
+        record->timestamp = row->timestamp;
+        record->host_name = arena_strdup(arena, row->host_name);
+        record->local_path = arena_strdup(arena, row->local_path);
+        record->remote_url = arena_strdup(arena, row->remote_url);
+        record->deletion_url = arena_strdup(arena, row->deletion_url);
+        record->filename = arena_strdup(arena, row->filename);
+        record->size = (size_t)row->size;
     }
 
-    sqlite3_finalize(stmt);
-
-    if (result != SQLITE_DONE)
+    if (!db_cursor_close(cursor) || !ok)
     {
-        log_error("Error retrieving uploads: %s", sqlite3_errmsg(db));
-        for (int i = 0; i < *count; i++)
-        {
-            free(records[i]->host_name);
-            free(records[i]->local_path);
-            free(records[i]->remote_url);
-            if (records[i]->deletion_url)
-                free(records[i]->deletion_url);
-            free(records[i]->filename);
-            free(records[i]);
-        }
-        free(records);
+        *count = 0;
         return NULL;
     }
 
     return records;
 }
 
-void
-db_free_records(upload_record_t **records, int count)
+struct db_importer
 {
-    if (!records)
-    {
-        return;
-    }
+    sqlite3_stmt *insert;
+    int pending;
+    int pending_imported;
+    int imported;
+    int skipped;
+};
 
-    for (int i = 0; i < count; i++)
+static bool
+import_commit(db_importer_t *importer)
+{
+    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
     {
-        if (records[i])
-        {
-            free(records[i]->host_name);
-            free(records[i]->local_path);
-            free(records[i]->remote_url);
-            free(records[i]->deletion_url);
-            free(records[i]->filename);
-            free(records[i]);
-        }
+        log_error("Failed to commit imported uploads: %s", sqlite3_errmsg(db));
+        return false;
     }
-
-    free(records);
+    importer->imported += importer->pending_imported;
+    importer->skipped += importer->pending - importer->pending_imported;
+    importer->pending = 0;
+    importer->pending_imported = 0;
+    return true;
 }
 
-bool
-db_delete_upload(int id)
+/*
+ * Bulk import: one prepared statement reused for every row, committed every
+ * DB_IMPORT_BATCH_ROWS rows. Rows whose remote_url is already known are skipped.
+ */
+db_importer_t *
+db_import_begin(void)
 {
     if (!db && !db_init())
     {
-        return false;
+        return NULL;
     }
 
-    const char *sql = "DELETE FROM uploads WHERE id = ?;";
+    db_importer_t *importer = calloc(1, sizeof(db_importer_t));
+    if (!importer)
+    {
+        log_error("Failed to allocate importer");
+        return NULL;
+    }
 
-    sqlite3_stmt *stmt;
-    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (result != SQLITE_OK)
+    const char *sql = "INSERT OR IGNORE INTO uploads (timestamp, host_name, local_path, "
+                      "remote_url, deletion_url, filename, size, request_time_ms, original_size) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
+    if (sqlite3_prepare_v2(db, sql, -1, &importer->insert, NULL) != SQLITE_OK)
     {
         log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        free(importer);
+        return NULL;
+    }
+
+    return importer;
+}
+
+bool
+db_import_row(db_importer_t *importer, const upload_row_t *row)
+{
+    if (importer->pending == 0 && sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin transaction: %s", sqlite3_errmsg(db));
         return false;
     }
 
-    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_stmt *stmt = importer->insert;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
 
-    result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_bind_int64(stmt, 1, row->timestamp);
+    sqlite3_bind_text(stmt, 2, row->host_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, row->local_path ? row->local_path : "", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, row->remote_url, -1, SQLITE_STATIC);
+    if (row->deletion_url && *row->deletion_url)
+        sqlite3_bind_text(stmt, 5, row->deletion_url, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, row->filename ? row->filename : "", -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 7, row->size);
+    if (row->request_time_ms > 0)
+        sqlite3_bind_double(stmt, 8, row->request_time_ms);
+    if (row->original_size > 0)
+        sqlite3_bind_int64(stmt, 9, row->original_size);
 
-    if (result != SQLITE_DONE)
+    if (sqlite3_step(stmt) != SQLITE_DONE)
     {
-        log_error("Failed to delete upload: %s", sqlite3_errmsg(db));
+        log_error("Failed to import upload %s: %s", row->remote_url, sqlite3_errmsg(db));
         return false;
     }
 
-    int changes = sqlite3_changes(db);
+    if (sqlite3_changes(db) > 0)
+    {
+        importer->pending_imported++;
+    }
+
+    if (++importer->pending >= DB_IMPORT_BATCH_ROWS)
+    {
+        return import_commit(importer);
+    }
+    return true;
+}
+
+/*
+ * Commits or rolls back the open batch and frees the importer. Batches committed earlier are
+ * kept either way; the counts only include committed rows.
+ */
+bool
+db_import_finish(db_importer_t *importer, bool commit, int *imported, int *skipped)
+{
+    if (!importer)
+    {
+        return false;
+    }
+
+    sqlite3_finalize(importer->insert);
+
+    bool ok = true;
+    if (importer->pending > 0)
+    {
+        if (commit)
+        {
+            ok = import_commit(importer);
+        }
+        else
+        {
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        }
+    }
+
+    if (imported)
+        *imported = importer->imported;
+    if (skipped)
+        *skipped = importer->skipped;
+
+    free(importer);
+    return ok;
+}
+
+char **
+db_get_fastest_hosts(int limit, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    const char *sql = "SELECT host_name, AVG(request_time_ms) AS avg_ms "
+                      "FROM uploads WHERE request_time_ms IS NOT NULL "
+                      "GROUP BY host_name ORDER BY avg_ms ASC LIMIT ?;";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    sqlite3_bind_int(stmt, 1, limit);
+
+    char **names = calloc(limit > 0 ? limit : 1, sizeof(char *));
+    if (!names)
+    {
+        log_error("Failed to allocate memory for host names");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW && *count < limit)
+    {
+        names[*count] = strdup((const char *)sqlite3_column_text(stmt, 0));
+        log_debug("Host %s averages %.2f ms", names[*count], sqlite3_column_double(stmt, 1));
+        (*count)++;
+    }
+
+    sqlite3_finalize(stmt);
+
+    return names;
+}
+
+/* Totals over uploads that were optimized before sending, optionally for one host. */
+int
+db_get_optimization_savings(const char *host_name, size_t *original_bytes, size_t *sent_bytes)
+{
+    *original_bytes = 0;
+    *sent_bytes = 0;
+
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    const char *sql = "SELECT COALESCE(SUM(optimized), 0), "
+                      "COALESCE(SUM(optimized_original_bytes), 0), "
+                      "COALESCE(SUM(optimized_bytes), 0) FROM upload_stats_daily "
+                      "WHERE ?1 IS NULL OR host_name = ?1;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    if (host_name)
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 1);
+
+    int count = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        count = sqlite3_column_int(stmt, 0);
+        *original_bytes = (size_t)sqlite3_column_int64(stmt, 1);
+        *sent_bytes = (size_t)sqlite3_column_int64(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+
+    return count;
+}
+
+/* Count a failed upload attempt against today's rollup for the host. */
+bool
+db_record_upload_failure(const char *host_name)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "INSERT INTO upload_stats_daily (host_name, day, failures) "
+                      "VALUES (?, date('now', 'localtime'), 1) "
+                      "ON CONFLICT (host_name, day) DO UPDATE SET failures = failures + 1;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!ok)
+    {
+        log_error("Failed to record upload failure: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+
+    return ok;
+}
+
+/*
+ * Estimate a percentile from the latency histogram, interpolating inside the bucket it falls
+ * in. Buckets below 100 ms are 1 ms wide; above that they span the last digits that
+ * LATENCY_BUCKET zeroed.
+ */
+static double
+histogram_percentile(const sqlite3_int64 *buckets,
+                     const sqlite3_int64 *counts,
+                     int bucket_count,
+                     sqlite3_int64 total,
+                     double percentile)
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    double rank = percentile * (double)total;
+    sqlite3_int64 seen = 0;
+
+    for (int i = 0; i < bucket_count; i++)
+    {
+        if ((double)(seen + counts[i]) >= rank || i == bucket_count - 1)
+        {
+            double width = 1;
+            for (sqlite3_int64 lower = buckets[i]; lower >= 100; lower /= 10)
+            {
+                width *= 10;
+            }
+            double within = counts[i] > 0 ? (rank - (double)seen) / (double)counts[i] : 0;
+            if (within < 0)
+                within = 0;
+            if (within > 1)
+                within = 1;
+            return (double)buckets[i] + width * within;
+        }
+        seen += counts[i];
+    }
+
+    return 0;
+}
+
+static void
+fill_percentiles(upload_stats_t *stats,
+                 const sqlite3_int64 *buckets,
+                 const sqlite3_int64 *counts,
+                 int bucket_count)
+{
+    sqlite3_int64 total = 0;
+    for (int i = 0; i < bucket_count; i++)
+    {
+        total += counts[i];
+    }
+
+    stats->p50_ms = histogram_percentile(buckets, counts, bucket_count, total, 0.50);
+    stats->p95_ms = histogram_percentile(buckets, counts, bucket_count, total, 0.95);
+    stats->p99_ms = histogram_percentile(buckets, counts, bucket_count, total, 0.99);
+}
+
+/* Attach latency percentiles from the histogram rollup to each group in stats. */
+static bool
+load_percentiles(stats_grouping_t grouping,
+                 const char *host_name,
+                 int days,
+                 upload_stats_t *stats,
+                 int count)
+{
+    const char *column = grouping == STATS_BY_DAY ? "day" : "host_name";
+    char sql[512];
+    snprintf(sql,
+             sizeof(sql),
+             "SELECT %s, bucket_ms, SUM(count) FROM upload_latency_daily "
+             "WHERE (?1 IS NULL OR host_name = ?1) "
+             "AND (?2 <= 0 OR day >= date('now', 'localtime', printf('-%%d days', ?2 - 1))) "
+             "GROUP BY 1, 2 ORDER BY 1, 2;",
+             column);
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    if (host_name)
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 1);
+    sqlite3_bind_int(stmt, 2, days);
+
+    /* Rows arrive grouped by key; each group's histogram is collected, then summarised. */
+    sqlite3_int64 *buckets = NULL;
+    sqlite3_int64 *counts = NULL;
+    int bucket_count = 0;
+    int capacity = 0;
+    upload_stats_t *current = NULL;
+    bool ok = true;
+    int result;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        const char *key = (const char *)sqlite3_column_text(stmt, 0);
+        if (!current || strcmp(current->key, key) != 0)
+        {
+            if (current)
+                fill_percentiles(current, buckets, counts, bucket_count);
+            bucket_count = 0;
+            current = NULL;
+            for (int i = 0; i < count && !current; i++)
+            {
+                if (strcmp(stats[i].key, key) == 0)
+                    current = &stats[i];
+            }
+            if (!current)
+                continue;
+        }
+
+        if (bucket_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            sqlite3_int64 *new_buckets = realloc(buckets, capacity * sizeof(sqlite3_int64));
+            if (new_buckets)
+                buckets = new_buckets;
+            sqlite3_int64 *new_counts = realloc(counts, capacity * sizeof(sqlite3_int64));
+            if (new_counts)
+                counts = new_counts;
+            if (!new_buckets || !new_counts)
+            {
+                log_error("Failed to allocate memory for latency histogram");
+                ok = false;
+                break;
+            }
+        }
+        buckets[bucket_count] = sqlite3_column_int64(stmt, 1);
+        counts[bucket_count] = sqlite3_column_int64(stmt, 2);
+        bucket_count++;
+    }
+
+    if (ok && current)
+    {
+        fill_percentiles(current, buckets, counts, bucket_count);
+    }
+    if (ok && result != SQLITE_DONE)
+    {
+        log_error("Failed to read latency histogram: %s", sqlite3_errmsg(db));
+        ok = false;
+    }
+
+    sqlite3_finalize(stmt);
+    free(buckets);
+    free(counts);
+    return ok;
+}
+
+/*
+ * Upload totals and latency percentiles per host or per day, read from the rollup tables.
+ * days limits the result to the last that many days, including today; 0 means all time.
+ */
+upload_stats_t *
+db_get_stats(stats_grouping_t grouping, const char *host_name, int days, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    const char *column = grouping == STATS_BY_DAY ? "day" : "host_name";
+    char sql[768];
+    snprintf(sql,
+             sizeof(sql),
+             "SELECT %s, SUM(uploads), SUM(failures), SUM(bytes), SUM(optimized), "
+             "SUM(optimized_original_bytes), SUM(optimized_bytes), SUM(timed), "
+             "SUM(time_total_ms) FROM upload_stats_daily "
+             "WHERE (?1 IS NULL OR host_name = ?1) "
+             "AND (?2 <= 0 OR day >= date('now', 'localtime', printf('-%%d days', ?2 - 1))) "
+             "GROUP BY 1 ORDER BY %s;",
+             column,
+             grouping == STATS_BY_DAY ? "1 DESC" : "2 DESC, 1");
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    if (host_name)
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 1);
+    sqlite3_bind_int(stmt, 2, days);
+
+    upload_stats_t *stats = NULL;
+    int capacity = 0;
+    bool ok = true;
+    int result;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            upload_stats_t *new_stats = realloc(stats, capacity * sizeof(upload_stats_t));
+            if (!new_stats)
+            {
+                log_error("Failed to allocate memory for statistics");
+                ok = false;
+                break;
+            }
+            stats = new_stats;
+        }
+
+        upload_stats_t *entry = &stats[(*count)++];
+        *entry = (upload_stats_t){
+            .key = strdup((const char *)sqlite3_column_text(stmt, 0)),
+            .uploads = sqlite3_column_int64(stmt, 1),
+            .failures = sqlite3_column_int64(stmt, 2),
+            .bytes = sqlite3_column_int64(stmt, 3),
+            .optimized = sqlite3_column_int64(stmt, 4),
+            .optimized_original_bytes = sqlite3_column_int64(stmt, 5),
+            .optimized_bytes = sqlite3_column_int64(stmt, 6),
+            .timed = sqlite3_column_int64(stmt, 7),
+            .time_total_ms = sqlite3_column_double(stmt, 8),
+        };
+        if (!entry->key)
+        {
+            log_error("Failed to allocate memory for statistics");
+            ok = false;
+            break;
+        }
+    }
+
+    if (ok && result != SQLITE_DONE)
+    {
+        log_error("Failed to read statistics: %s", sqlite3_errmsg(db));
+        ok = false;
+    }
+    sqlite3_finalize(stmt);
+
+    if (ok)
+    {
+        ok = load_percentiles(grouping, host_name, days, stats, *count);
+    }
+
+    if (!ok)
+    {
+        db_free_stats(stats, *count);
+        *count = 0;
+        return NULL;
+    }
+
+    return stats;
+}
+
+void
+db_free_stats(upload_stats_t *stats, int count)
+{
+    if (!stats)
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        free(stats[i].key);
+    }
+    free(stats);
+}
+
+/* Recompute the rollups from the uploads table, e.g. after editing history.db by hand. */
+bool
+db_rebuild_stats(void)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    char *error_msg = NULL;
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;" STATS_REBUILD_SQL "COMMIT;", NULL, NULL, &error_msg) !=
+        SQLITE_OK)
+    {
+        log_error("Failed to rebuild statistics: %s", error_msg);
+        sqlite3_free(error_msg);
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_get_host_health(const char *host_name, host_health_record_t *record)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "SELECT state, consecutive_failures, changed_at, last_failure_at "
+                      "FROM host_health WHERE host_name = ?;";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        record->state = sqlite3_column_int(stmt, 0);
+        record->consecutive_failures = sqlite3_column_int(stmt, 1);
+        record->changed_at = sqlite3_column_int64(stmt, 2);
+        record->last_failure_at = sqlite3_column_int64(stmt, 3);
+        found = true;
+    }
+
+    sqlite3_finalize(stmt);
+
+    return found;
+}
+
+bool
+db_set_host_health(const char *host_name, const host_health_record_t *record)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "INSERT OR REPLACE INTO host_health "
+                      "(host_name, state, consecutive_failures, changed_at, last_failure_at) "
+                      "VALUES (?, ?, ?, ?, ?);";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, record->state);
+    sqlite3_bind_int(stmt, 3, record->consecutive_failures);
+    sqlite3_bind_int64(stmt, 4, record->changed_at);
+    sqlite3_bind_int64(stmt, 5, record->last_failure_at);
+
+    result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to update host health: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_delete_upload(int id)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "DELETE FROM uploads WHERE id = ?;";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to delete upload: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    int changes = sqlite3_changes(db);
     if (changes == 0)
     {
-        log_warn("No upload record found with ID: %d", id);
+        log_warn("No upload record found with ID: %d", id);
+        return false;
+    }
+
+    log_info("Deleted upload record with ID: %d", id);
+    return true;
+}
+
+int
+db_delete_uploads(const int *ids, int count)
+{
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM uploads WHERE id = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return -1;
+    }
+
+    int deleted = 0;
+    for (int i = 0; i < count; i++)
+    {
+        sqlite3_bind_int(stmt, 1, ids[i]);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            log_error("Failed to delete upload %d: %s", ids[i], sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return -1;
+        }
+        deleted += sqlite3_changes(db);
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to commit deletions: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return -1;
+    }
+
+    log_info("Deleted %d upload records", deleted);
+    return deleted;
+}
+
+/*
+ * Delete one batch of history rows outside a retention limit: the oldest rows from before
+ * `before` when it is set, otherwise the rows after the keep_newest most recent ones. Every
+ * batch commits on its own, so the write lock is only held briefly. Returns the number of rows
+ * deleted, or -1 on error.
+ */
+int
+db_prune_uploads(const char *host_name, time_t before, long keep_newest, int limit)
+{
+    /* Separate statements per shape keep the host and timestamp indexes usable. */
+    static const char *const statements[2][2] = {
+        { "DELETE FROM uploads WHERE id IN (SELECT id FROM uploads WHERE timestamp < ?2 "
+          "ORDER BY timestamp LIMIT ?3);",
+          "DELETE FROM uploads WHERE id IN (SELECT id FROM uploads "
+          "ORDER BY timestamp DESC, id DESC LIMIT ?3 OFFSET ?2);" },
+        { "DELETE FROM uploads WHERE id IN (SELECT id FROM uploads WHERE host_name = ?1 "
+          "AND timestamp < ?2 ORDER BY timestamp LIMIT ?3);",
+          "DELETE FROM uploads WHERE id IN (SELECT id FROM uploads WHERE host_name = ?1 "
+          "ORDER BY timestamp DESC, id DESC LIMIT ?3 OFFSET ?2);" },
+    };
+
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *sql = statements[host_name != NULL][before == 0];
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    if (host_name)
+    {
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(stmt, 2, before ? (sqlite3_int64)before : keep_newest);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    int deleted = -1;
+    if (sqlite3_step(stmt) == SQLITE_DONE)
+    {
+        deleted = sqlite3_changes(db);
+    }
+    else
+    {
+        log_error("Failed to prune upload history: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+
+    return deleted;
+}
+
+/*
+ * Hand up to max_pages free pages (all of them when max_pages <= 0) back to the filesystem.
+ * A database that predates incremental auto-vacuum is left alone; only db_vacuum converts it.
+ * Returns the number of bytes released, or -1 on error.
+ */
+sqlite3_int64
+db_incremental_vacuum(int max_pages)
+{
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    sqlite3_int64 page_size = read_pragma("PRAGMA page_size;");
+    sqlite3_int64 pages_before = read_pragma("PRAGMA page_count;");
+
+    if (read_pragma("PRAGMA auto_vacuum;") != DB_AUTO_VACUUM_INCREMENTAL)
+    {
+        log_debug("History database predates incremental vacuum; run 'history prune --vacuum'");
+        return 0;
+    }
+
+    if (read_pragma("PRAGMA freelist_count;") > 0)
+    {
+        char sql[64];
+        if (max_pages > 0)
+        {
+            snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d);", max_pages);
+        }
+        else
+        {
+            snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum;");
+        }
+
+        char *error_msg = NULL;
+        if (sqlite3_exec(db, sql, NULL, NULL, &error_msg) != SQLITE_OK)
+        {
+            log_error("Incremental vacuum failed: %s", error_msg);
+            sqlite3_free(error_msg);
+            return -1;
+        }
+    }
+
+    sqlite3_int64 pages_after = read_pragma("PRAGMA page_count;");
+    return pages_before > pages_after ? (pages_before - pages_after) * page_size : 0;
+}
+
+/* Rewrite the whole file, switching it to incremental auto-vacuum on the way. */
+bool
+db_vacuum(void)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    char *error_msg = NULL;
+    if (sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, NULL, &error_msg) !=
+        SQLITE_OK)
+    {
+        log_error("Failed to vacuum the history database: %s", error_msg);
+        sqlite3_free(error_msg);
+        return false;
+    }
+
+    log_info("History database rewritten with incremental auto-vacuum");
+    return true;
+}
+
+/*
+ * Returns the id of the first job, or 0 on failure. One transaction inserts them all, so the
+ * jobs hold the consecutive ids [first, first + count).
+ */
+sqlite3_int64
+db_queue_add(char **file_paths, int count, const char *host_name)
+{
+    if (!db && !db_init())
+    {
+        return 0;
+    }
+
+    if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return 0;
+    }
+
+    const char *sql = "INSERT INTO upload_queue (file_path, host_name, state, created_at, updated_at) "
+                      "VALUES (?, ?, 0, ?, ?);";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return 0;
+    }
+
+    time_t now = time(NULL);
+    sqlite3_int64 first_id = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        sqlite3_bind_text(stmt, 1, file_paths[i], -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 3, now);
+        sqlite3_bind_int64(stmt, 4, now);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            log_error("Failed to queue %s: %s", file_paths[i], sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return 0;
+        }
+        if (i == 0)
+        {
+            first_id = sqlite3_last_insert_rowid(db);
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to commit queued uploads: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return 0;
+    }
+
+    log_info("Queued %d uploads for %s", count, host_name);
+    return first_id;
+}
+
+static queue_job_t *
+queue_job_from_row(sqlite3_stmt *stmt)
+{
+    queue_job_t *job = malloc(sizeof(queue_job_t));
+    if (!job)
+    {
+        log_error("Failed to allocate memory for queue job");
+        return NULL;
+    }
+
+    const unsigned char *last_error = sqlite3_column_text(stmt, 5);
+
+    job->id = sqlite3_column_int64(stmt, 0);
+    job->file_path = strdup((const char *)sqlite3_column_text(stmt, 1));
+    job->host_name = strdup((const char *)sqlite3_column_text(stmt, 2));
+    job->state = sqlite3_column_int(stmt, 3);
+    job->attempts = sqlite3_column_int(stmt, 4);
+    job->last_error = last_error ? strdup((const char *)last_error) : NULL;
+    job->updated_at = sqlite3_column_int64(stmt, 6);
+
+    return job;
+}
+
+static queue_job_t **
+queue_collect_jobs(sqlite3_stmt *stmt, int limit, int *count)
+{
+    queue_job_t **jobs = calloc(limit > 0 ? limit : 1, sizeof(queue_job_t *));
+    if (!jobs)
+    {
+        log_error("Failed to allocate memory for queue jobs");
+        return NULL;
+    }
+
+    while (*count < limit && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        queue_job_t *job = queue_job_from_row(stmt);
+        if (!job)
+        {
+            break;
+        }
+        jobs[(*count)++] = job;
+    }
+
+    return jobs;
+}
+
+/* Claim pending jobs with min_id <= id < end_id; an end_id of 0 leaves the range open. */
+queue_job_t **
+db_queue_claim(sqlite3_int64 min_id, sqlite3_int64 end_id, int limit, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    /* IMMEDIATE takes the write lock up front so two runners never claim the same job. */
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    /* One host per claim, so a claimed batch can go straight to the batch upload engine. */
+    const char *sql = "SELECT id, file_path, host_name, state, attempts, last_error, updated_at "
+                      "FROM upload_queue WHERE state = 0 AND id >= ?1 AND id < ?3 AND host_name = "
+                      "(SELECT host_name FROM upload_queue WHERE state = 0 AND id >= ?1 "
+                      "AND id < ?3 ORDER BY id LIMIT 1) "
+                      "ORDER BY id LIMIT ?2;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return NULL;
+    }
+
+    sqlite3_bind_int64(stmt, 1, min_id);
+    sqlite3_bind_int(stmt, 2, limit);
+    sqlite3_bind_int64(stmt, 3, end_id > 0 ? end_id : INT64_MAX);
+
+    queue_job_t **jobs = queue_collect_jobs(stmt, limit, count);
+    sqlite3_finalize(stmt);
+
+    if (!jobs || *count == 0)
+    {
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        free(jobs);
+        *count = 0;
+        return NULL;
+    }
+
+    sql = "UPDATE upload_queue SET state = 1, attempts = attempts + 1, claimed_by = ?1, "
+          "claimed_at = ?2, updated_at = ?2 WHERE id = ?3;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        db_queue_free_jobs(jobs, *count);
+        *count = 0;
+        return NULL;
+    }
+
+    time_t now = time(NULL);
+    bool ok = true;
+    for (int i = 0; i < *count && ok; i++)
+    {
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)getpid());
+        sqlite3_bind_int64(stmt, 2, now);
+        sqlite3_bind_int64(stmt, 3, jobs[i]->id);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+
+        jobs[i]->state = QUEUE_IN_FLIGHT;
+        jobs[i]->attempts++;
+    }
+    sqlite3_finalize(stmt);
+
+    if (!ok || sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to claim queued uploads: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        db_queue_free_jobs(jobs, *count);
+        *count = 0;
+        return NULL;
+    }
+
+    return jobs;
+}
+
+/* Each finished job renews the lease on the rest of this process's claims. */
+static bool
+renew_claims(void)
+{
+    sqlite3_stmt *stmt;
+    const char *sql = "UPDATE upload_queue SET claimed_at = ? WHERE state = 1 AND claimed_by = ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
         return false;
     }
 
-    log_info("Deleted upload record with ID: %d", id);
+    sqlite3_bind_int64(stmt, 1, time(NULL));
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)getpid());
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool
+db_queue_complete(const queue_job_t *job,
+                  const char *remote_url,
+                  const char *deletion_url,
+                  const char *filename,
+                  size_t size,
+                  size_t original_size,
+                  double request_time_ms)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    bool ok = insert_upload(job->host_name,
+                            job->file_path,
+                            remote_url,
+                            deletion_url,
+                            filename,
+                            size,
+                            original_size,
+                            request_time_ms);
+
+    sqlite3_stmt *stmt = NULL;
+    if (ok)
+    {
+        const char *sql = "UPDATE upload_queue SET state = 2, last_error = NULL, claimed_by = NULL, "
+                          "claimed_at = NULL, updated_at = ? WHERE id = ?;";
+        ok = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK;
+    }
+    if (ok)
+    {
+        sqlite3_bind_int64(stmt, 1, time(NULL));
+        sqlite3_bind_int64(stmt, 2, job->id);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && renew_claims();
+
+    if (!ok || sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to record completed upload %lld: %s", job->id, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_queue_fail(const queue_job_t *job, const char *error_message)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "UPDATE upload_queue SET state = 3, last_error = ?, claimed_by = NULL, "
+                      "claimed_at = NULL, updated_at = ? WHERE id = ?;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, error_message, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, time(NULL));
+    sqlite3_bind_int64(stmt, 3, job->id);
+
+    int result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to mark queued upload %lld as failed: %s", job->id, sqlite3_errmsg(db));
+        return false;
+    }
+
+    renew_claims();
+    return true;
+}
+
+int
+db_queue_recover(void)
+{
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    /*
+     * A claim whose lease ran out is given up whoever holds it: after a crash its pid may have
+     * been reused by an unrelated process, which would otherwise keep the jobs in flight forever.
+     */
+    sqlite3_stmt *stmt;
+    const char *sql = "UPDATE upload_queue SET state = 0, claimed_by = NULL, claimed_at = NULL, "
+                      "updated_at = ?1 WHERE state = 1 AND COALESCE(claimed_at, 0) < ?1 - ?2;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, time(NULL));
+    sqlite3_bind_int64(stmt, 2, DEFAULT_QUEUE_LEASE_SECONDS);
+    int recovered = sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(db) : 0;
+    sqlite3_finalize(stmt);
+
+    sql = "SELECT DISTINCT claimed_by FROM upload_queue WHERE state = 1;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_stmt *reset;
+    sql = "UPDATE upload_queue SET state = 0, claimed_by = NULL, claimed_at = NULL, updated_at = ? "
+          "WHERE state = 1 AND claimed_by IS ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &reset, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        /* A claim only stays in flight while the process that made it is alive. */
+        bool owner_alive = false;
+        if (sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            pid_t pid = (pid_t)sqlite3_column_int64(stmt, 0);
+            owner_alive = pid == getpid() || kill(pid, 0) == 0 || errno != ESRCH;
+        }
+        if (owner_alive)
+        {
+            continue;
+        }
+
+        sqlite3_bind_int64(reset, 1, time(NULL));
+        sqlite3_bind_value(reset, 2, sqlite3_column_value(stmt, 0));
+        if (sqlite3_step(reset) == SQLITE_DONE)
+        {
+            recovered += sqlite3_changes(db);
+        }
+        sqlite3_reset(reset);
+    }
+
+    sqlite3_finalize(reset);
+    sqlite3_finalize(stmt);
+
+    if (recovered > 0)
+    {
+        log_info("Recovered %d interrupted uploads", recovered);
+    }
+    return recovered;
+}
+
+int
+db_queue_retry(void)
+{
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *sql = "UPDATE upload_queue SET state = 0, attempts = 0, last_error = NULL, "
+                      "updated_at = ? WHERE state = 3;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, time(NULL));
+    int result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to requeue failed uploads: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    return sqlite3_changes(db);
+}
+
+/*
+ * Delete up to limit queue jobs in the given finished state that last changed before `before`,
+ * oldest first. Returns the number of rows deleted, or -1 on error.
+ */
+int
+db_queue_prune(queue_state_t state, time_t before, int limit)
+{
+    if (!db && !db_init())
+    {
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *sql = "DELETE FROM upload_queue WHERE id IN (SELECT id FROM upload_queue "
+                      "WHERE state = ?1 AND updated_at < ?2 ORDER BY id LIMIT ?3);";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_int(stmt, 1, state);
+    sqlite3_bind_int64(stmt, 2, before);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    int deleted = -1;
+    if (sqlite3_step(stmt) == SQLITE_DONE)
+    {
+        deleted = sqlite3_changes(db);
+    }
+    else
+    {
+        log_error("Failed to prune the upload queue: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+
+    return deleted;
+}
+
+bool
+db_queue_counts(int counts[QUEUE_STATE_COUNT])
+{
+    for (int i = 0; i < QUEUE_STATE_COUNT; i++)
+    {
+        counts[i] = 0;
+    }
+
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT state, COUNT(*) FROM upload_queue GROUP BY state;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int state = sqlite3_column_int(stmt, 0);
+        if (state >= 0 && state < QUEUE_STATE_COUNT)
+        {
+            counts[state] = sqlite3_column_int(stmt, 1);
+        }
+    }
+
+    sqlite3_finalize(stmt);
     return true;
 }
 
+queue_job_t **
+db_queue_get_jobs(queue_state_t state, int limit, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT id, file_path, host_name, state, attempts, last_error, updated_at "
+                      "FROM upload_queue WHERE state = ? ORDER BY id LIMIT ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    sqlite3_bind_int(stmt, 1, state);
+    sqlite3_bind_int(stmt, 2, limit);
+
+    queue_job_t **jobs = queue_collect_jobs(stmt, limit, count);
+    sqlite3_finalize(stmt);
+
+    return jobs;
+}
+
+void
+db_queue_free_jobs(queue_job_t **jobs, int count)
+{
+    if (!jobs)
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (jobs[i])
+        {
+            free(jobs[i]->file_path);
+            free(jobs[i]->host_name);
+            free(jobs[i]->last_error);
+            free(jobs[i]);
+        }
+    }
+    free(jobs);
+}
+
 void
 db_close(void)
 {
@@ -0,0 +1,657 @@
+#include "hostman/storage/history.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/output.h"
+#include "hostman/storage/database.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef USE_CJSON
+#include <cjson/cJSON.h>
+#else
+#include <jansson.h>
+#endif
+
+typedef enum
+{
+    FIELD_TIMESTAMP,
+    FIELD_HOST_NAME,
+    FIELD_LOCAL_PATH,
+    FIELD_REMOTE_URL,
+    FIELD_DELETION_URL,
+    FIELD_FILENAME,
+    FIELD_SIZE,
+    FIELD_REQUEST_TIME_MS,
+    FIELD_ORIGINAL_SIZE,
+    FIELD_COUNT
+} history_field_t;
+
+/* Column order for CSV and key names for JSON lines. */
+static const char *const field_names[FIELD_COUNT] = {
+    "timestamp", "host_name", "local_path",      "remote_url",    "deletion_url",
+    "filename",  "size",      "request_time_ms", "original_size",
+};
+
+/* Rows are formatted into one large block and handed to stdio a block at a time. */
+typedef struct
+{
+    FILE *out;
+    char *data;
+    size_t size;
+    bool failed;
+} history_writer_t;
+
+typedef struct
+{
+    history_writer_t writer;
+    history_format_t format;
+    long count;
+} export_context_t;
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t *starts;
+    int count;
+    int capacity_fields;
+} csv_record_t;
+
+bool
+history_parse_format(const char *name, history_format_t *format)
+{
+    if (strcmp(name, "jsonl") == 0 || strcmp(name, "json") == 0)
+    {
+        *format = HISTORY_FORMAT_JSONL;
+        return true;
+    }
+    if (strcmp(name, "csv") == 0)
+    {
+        *format = HISTORY_FORMAT_CSV;
+        return true;
+    }
+    return false;
+}
+
+history_format_t
+history_format_for_path(const char *path)
+{
+    const char *dot = path ? strrchr(path, '.') : NULL;
+    return dot && strcmp(dot, ".csv") == 0 ? HISTORY_FORMAT_CSV : HISTORY_FORMAT_JSONL;
+}
+
+static void
+writer_flush(history_writer_t *writer)
+{
+    if (writer->size > 0 && fwrite(writer->data, 1, writer->size, writer->out) != writer->size)
+    {
+        writer->failed = true;
+    }
+    writer->size = 0;
+}
+
+static void
+writer_write(history_writer_t *writer, const char *data, size_t size)
+{
+    if (size > HISTORY_WRITE_BUFFER_SIZE - writer->size)
+    {
+        writer_flush(writer);
+        if (size > HISTORY_WRITE_BUFFER_SIZE)
+        {
+            writer->failed |= fwrite(data, 1, size, writer->out) != size;
+            return;
+        }
+    }
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+
+static void
+writer_puts(history_writer_t *writer, const char *text)
+{
+    writer_write(writer, text, strlen(text));
+}
+
+static void
+writer_putc(history_writer_t *writer, char c)
+{
+    if (writer->size == HISTORY_WRITE_BUFFER_SIZE)
+    {
+        writer_flush(writer);
+    }
+    writer->data[writer->size++] = c;
+}
+
+static void
+writer_int(history_writer_t *writer, long long value)
+{
+    char number[32];
+    int len = snprintf(number, sizeof(number), "%lld", value);
+    writer_write(writer, number, (size_t)len);
+}
+
+static void
+write_json_string(history_writer_t *writer, const char *value)
+{
+    if (!value)
+    {
+        writer_puts(writer, "null");
+        return;
+    }
+
+    writer_putc(writer, '"');
+    for (const char *p = value; *p; p++)
+    {
+        char buffer[8];
+        const char *escape = json_escape((unsigned char)*p, buffer);
+        if (escape)
+            writer_puts(writer, escape);
+        else
+            writer_putc(writer, *p);
+    }
+    writer_putc(writer, '"');
+}
+
+static void
+write_csv_field(history_writer_t *writer, const char *value)
+{
+    if (!value)
+    {
+        return;
+    }
+
+    if (!strpbrk(value, ",\"\r\n"))
+    {
+        writer_puts(writer, value);
+        return;
+    }
+
+    writer_putc(writer, '"');
+    for (const char *p = value; *p; p++)
+    {
+        if (*p == '"')
+        {
+            writer_putc(writer, '"');
+        }
+        writer_putc(writer, *p);
+    }
+    writer_putc(writer, '"');
+}
+
+static bool
+export_row(export_context_t *ctx, const upload_row_t *row)
+{
+    history_writer_t *writer = &ctx->writer;
+
+    const char *text[FIELD_COUNT] = {
+        [FIELD_HOST_NAME] = row->host_name,       [FIELD_LOCAL_PATH] = row->local_path,
+        [FIELD_REMOTE_URL] = row->remote_url,     [FIELD_DELETION_URL] = row->deletion_url,
+        [FIELD_FILENAME] = row->filename,
+    };
+
+    char request_time[32] = "";
+    if (row->request_time_ms > 0)
+    {
+        snprintf(request_time, sizeof(request_time), "%.3f", row->request_time_ms);
+    }
+
+    for (int i = 0; i < FIELD_COUNT; i++)
+    {
+        if (ctx->format == HISTORY_FORMAT_JSONL)
+        {
+            writer_puts(writer, i == 0 ? "{\"" : ",\"");
+            writer_puts(writer, field_names[i]);
+            writer_puts(writer, "\":");
+        }
+        else if (i > 0)
+        {
+            writer_putc(writer, ',');
+        }
+
+        switch (i)
+        {
+            case FIELD_TIMESTAMP:
+                writer_int(writer, (long long)row->timestamp);
+                break;
+            case FIELD_SIZE:
+                writer_int(writer, row->size);
+                break;
+            case FIELD_ORIGINAL_SIZE:
+                if (row->original_size > 0)
+                    writer_int(writer, row->original_size);
+                else if (ctx->format == HISTORY_FORMAT_JSONL)
+                    writer_puts(writer, "null");
+                break;
+            case FIELD_REQUEST_TIME_MS:
+                if (request_time[0])
+                    writer_puts(writer, request_time);
+                else if (ctx->format == HISTORY_FORMAT_JSONL)
+                    writer_puts(writer, "null");
+                break;
+            default:
+                if (ctx->format == HISTORY_FORMAT_JSONL)
+                    write_json_string(writer, text[i]);
+                else
+                    write_csv_field(writer, text[i]);
+                break;
+        }
+    }
+
+    writer_puts(writer, ctx->format == HISTORY_FORMAT_JSONL ? "}\n" : "\n");
+    ctx->count++;
+
+    return !writer->failed;
+}
+
+/*
+ * Stream the history to out straight from the database cursor, so memory use does not depend
+ * on how many uploads there are.
+ */
+bool
+history_export(FILE *out, history_format_t format, const char *host_name, long *count)
+{
+    export_context_t ctx = { .writer = { .out = out }, .format = format };
+    ctx.writer.data = malloc(HISTORY_WRITE_BUFFER_SIZE);
+    if (!ctx.writer.data)
+    {
+        log_error("Failed to allocate export buffer");
+        return false;
+    }
+
+    if (format == HISTORY_FORMAT_CSV)
+    {
+        for (int i = 0; i < FIELD_COUNT; i++)
+        {
+            if (i > 0)
+            {
+                writer_putc(&ctx.writer, ',');
+            }
+            writer_puts(&ctx.writer, field_names[i]);
+        }
+        writer_putc(&ctx.writer, '\n');
+    }
+
+    db_query_t query = { .host_name = host_name };
+    db_cursor_t *cursor = db_cursor_open(&query);
+    bool ok = cursor != NULL;
+    const upload_row_t *row;
+    while (ok && (row = db_cursor_next(cursor)))
+    {
+        ok = export_row(&ctx, row);
+    }
+    if (cursor && !db_cursor_close(cursor))
+    {
+        ok = false;
+    }
+
+    writer_flush(&ctx.writer);
+    ok = ok && !ctx.writer.failed && fflush(out) == 0;
+    if (!ok && ctx.writer.failed)
+    {
+        log_error("Failed to write exported history");
+    }
+
+    free(ctx.writer.data);
+    if (count)
+    {
+        *count = ctx.count;
+    }
+    return ok;
+}
+
+/* Fill in what an imported row may leave out, and reject rows that cannot be stored. */
+static bool
+complete_row(upload_row_t *row)
+{
+    if (!row->host_name || !*row->host_name || !row->remote_url || !*row->remote_url)
+    {
+        return false;
+    }
+
+    if (!row->filename || !*row->filename)
+    {
+        const char *slash = strrchr(row->remote_url, '/');
+        row->filename = slash && slash[1] ? slash + 1 : row->remote_url;
+    }
+
+    if (row->timestamp <= 0)
+    {
+        row->timestamp = time(NULL);
+    }
+
+    return true;
+}
+
+static bool
+import_row(db_importer_t *importer, upload_row_t *row, history_import_stats_t *stats, long line)
+{
+    if (!complete_row(row))
+    {
+        log_warn("Skipping record %ld: host_name and remote_url are required", line);
+        stats->invalid++;
+        return true;
+    }
+
+    return db_import_row(importer, row);
+}
+
+#ifdef USE_CJSON
+static const char *
+json_text(const cJSON *root, const char *key)
+{
+    cJSON *item = cJSON_GetObjectItem(root, key);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+static double
+json_number(const cJSON *root, const char *key)
+{
+    cJSON *item = cJSON_GetObjectItem(root, key);
+    return cJSON_IsNumber(item) ? item->valuedouble : 0;
+}
+#else
+static const char *
+json_text(const json_t *root, const char *key)
+{
+    return json_string_value(json_object_get(root, key));
+}
+
+static double
+json_number(const json_t *root, const char *key)
+{
+    return json_number_value(json_object_get(root, key));
+}
+#endif
+
+static bool
+import_jsonl(FILE *in, db_importer_t *importer, history_import_stats_t *stats)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    long line_number = 0;
+    bool ok = true;
+
+    while (ok && getline(&line, &capacity, in) != -1)
+    {
+        line_number++;
+        if (line[strspn(line, " \t\r\n")] == '\0')
+        {
+            continue;
+        }
+
+#ifdef USE_CJSON
+        cJSON *root = cJSON_Parse(line);
+        if (!root || !cJSON_IsObject(root))
+        {
+            cJSON_Delete(root);
+#else
+        json_error_t error;
+        json_t *root = json_loads(line, 0, &error);
+        if (!root || !json_is_object(root))
+        {
+            json_decref(root);
+#endif
+            log_warn("Skipping line %ld: not a JSON object", line_number);
+            stats->invalid++;
+            continue;
+        }
+
+        upload_row_t row = {
+            .timestamp = (time_t)json_number(root, "timestamp"),
+            .host_name = json_text(root, "host_name"),
+            .local_path = json_text(root, "local_path"),
+            .remote_url = json_text(root, "remote_url"),
+            .deletion_url = json_text(root, "deletion_url"),
+            .filename = json_text(root, "filename"),
+            .size = (sqlite3_int64)json_number(root, "size"),
+            .request_time_ms = json_number(root, "request_time_ms"),
+            .original_size = (sqlite3_int64)json_number(root, "original_size"),
+        };
+        ok = import_row(importer, &row, stats, line_number);
+
+#ifdef USE_CJSON
+        cJSON_Delete(root);
+#else
+        json_decref(root);
+#endif
+    }
+
+    free(line);
+    return ok;
+}
+
+static bool
+csv_push(csv_record_t *record, char c)
+{
+    if (record->size == record->capacity)
+    {
+        size_t capacity = record->capacity ? record->capacity * 2 : 1024;
+        char *data = realloc(record->data, capacity);
+        if (!data)
+        {
+            return false;
+        }
+        record->data = data;
+        record->capacity = capacity;
+    }
+    record->data[record->size++] = c;
+    return true;
+}
+
+static bool
+csv_end_field(csv_record_t *record, size_t start)
+{
+    if (record->count == record->capacity_fields)
+    {
+        int capacity = record->capacity_fields ? record->capacity_fields * 2 : 16;
+        size_t *starts = realloc(record->starts, capacity * sizeof(size_t));
+        if (!starts)
+        {
+            return false;
+        }
+        record->starts = starts;
+        record->capacity_fields = capacity;
+    }
+    record->starts[record->count++] = start;
+    return csv_push(record, '\0');
+}
+
+/*
+ * Read one RFC 4180 record; quoted fields may contain commas, doubled quotes and newlines.
+ * Returns 1 for a record, 0 at end of input and -1 on an unterminated quote or out of memory.
+ */
+static int
+csv_read_record(FILE *in, csv_record_t *record)
+{
+    record->size = 0;
+    record->count = 0;
+
+    int c = getc(in);
+    if (c == EOF)
+    {
+        return 0;
+    }
+
+    size_t start = 0;
+    bool quoted = false;
+    for (;;)
+    {
+        bool ok = true;
+        if (quoted)
+        {
+            if (c == EOF)
+            {
+                return -1;
+            }
+            if (c == '"')
+            {
+                c = getc(in);
+                if (c != '"')
+                {
+                    quoted = false;
+                    continue;
+                }
+            }
+            ok = csv_push(record, (char)c);
+        }
+        else if (c == '"' && record->size == start)
+        {
+            quoted = true;
+        }
+        else if (c == ',')
+        {
+            ok = csv_end_field(record, start);
+            start = record->size;
+        }
+        else if (c == '\n' || c == EOF)
+        {
+            return csv_end_field(record, start) ? 1 : -1;
+        }
+        else if (c != '\r')
+        {
+            ok = csv_push(record, (char)c);
+        }
+
+        if (!ok)
+        {
+            return -1;
+        }
+        c = getc(in);
+    }
+}
+
+static bool
+import_csv(FILE *in, db_importer_t *importer, history_import_stats_t *stats)
+{
+    csv_record_t record = { 0 };
+    int columns[FIELD_COUNT];
+    int column_count = 0;
+    long record_number = 0;
+    bool ok = true;
+
+    if (csv_read_record(in, &record) != 1)
+    {
+        log_error("CSV input has no header row");
+        free(record.data);
+        free(record.starts);
+        return false;
+    }
+
+    /* Map header names to fields so columns may come in any order, or be missing. */
+    int *field_of_column = calloc(record.count, sizeof(int));
+    if (!field_of_column)
+    {
+        free(record.data);
+        free(record.starts);
+        return false;
+    }
+    for (int i = 0; i < FIELD_COUNT; i++)
+    {
+        columns[i] = -1;
+    }
+    for (int col = 0; col < record.count; col++)
+    {
+        field_of_column[col] = -1;
+        for (int i = 0; i < FIELD_COUNT; i++)
+        {
+            if (strcmp(record.data + record.starts[col], field_names[i]) == 0)
+            {
+                field_of_column[col] = i;
+                columns[i] = col;
+            }
+        }
+    }
+    column_count = record.count;
+
+    if (columns[FIELD_REMOTE_URL] < 0 || columns[FIELD_HOST_NAME] < 0)
+    {
+        log_error("CSV header must include host_name and remote_url");
+        free(field_of_column);
+        free(record.data);
+        free(record.starts);
+        return false;
+    }
+
+    int status;
+    while (ok && (status = csv_read_record(in, &record)) == 1)
+    {
+        record_number++;
+        if (record.count == 1 && record.data[0] == '\0')
+        {
+            continue;
+        }
+
+        upload_row_t row = { 0 };
+        for (int col = 0; col < record.count && col < column_count; col++)
+        {
+            const char *value = record.data + record.starts[col];
+            switch (field_of_column[col])
+            {
+                case FIELD_TIMESTAMP:
+                    row.timestamp = (time_t)strtoll(value, NULL, 10);
+                    break;
+                case FIELD_HOST_NAME:
+                    row.host_name = value;
+                    break;
+                case FIELD_LOCAL_PATH:
+                    row.local_path = value;
+                    break;
+                case FIELD_REMOTE_URL:
+                    row.remote_url = value;
+                    break;
+                case FIELD_DELETION_URL:
+                    row.deletion_url = value;
+                    break;
+                case FIELD_FILENAME:
+                    row.filename = value;
+                    break;
+                case FIELD_SIZE:
+                    row.size = strtoll(value, NULL, 10);
+                    break;
+                case FIELD_REQUEST_TIME_MS:
+                    row.request_time_ms = strtod(value, NULL);
+                    break;
+                case FIELD_ORIGINAL_SIZE:
+                    row.original_size = strtoll(value, NULL, 10);
+                    break;
+                default:
+                    break;
+            }
+        }
+        ok = import_row(importer, &row, stats, record_number);
+    }
+
+    if (ok && status < 0)
+    {
+        log_error("Malformed CSV after record %ld", record_number);
+        ok = false;
+    }
+
+    free(field_of_column);
+    free(record.data);
+    free(record.starts);
+    return ok;
+}
+
+/*
+ * Merge exported history into the local database. Uploads whose remote_url is already present
+ * are skipped, so importing the same file twice is harmless.
+ */
+bool
+history_import(FILE *in, history_format_t format, history_import_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    db_importer_t *importer = db_import_begin();
+    if (!importer)
+    {
+        return false;
+    }
+
+    bool ok = format == HISTORY_FORMAT_CSV ? import_csv(in, importer, stats)
+                                           : import_jsonl(in, importer, stats);
+
+    ok = db_import_finish(importer, ok, &stats->imported, &stats->skipped) && ok;
+    return ok;
+}
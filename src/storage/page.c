@@ -0,0 +1,411 @@
+#include "hostman/storage/page.h"
+#include "hostman/core/logging.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    union
+    {
+        sqlite3_int64 number;
+        double real;
+        const char *text;
+    } key;
+    int row;
+} sort_entry_t;
+
+static bool
+grow_column(void **column, size_t element_size, int capacity)
+{
+    void *ptr = realloc(*column, element_size * (size_t)capacity);
+    if (!ptr)
+    {
+        return false;
+    }
+    *column = ptr;
+    return true;
+}
+
+static bool
+grow_rows(history_page_t *page)
+{
+    int capacity = page->capacity > 0 ? page->capacity * 2 : HISTORY_PAGE_INITIAL_ROWS;
+
+    if (!grow_column((void **)&page->ids, sizeof(*page->ids), capacity) ||
+        !grow_column((void **)&page->timestamps, sizeof(*page->timestamps), capacity) ||
+        !grow_column((void **)&page->sizes, sizeof(*page->sizes), capacity) ||
+        !grow_column((void **)&page->original_sizes, sizeof(*page->original_sizes), capacity) ||
+        !grow_column((void **)&page->request_time_ms, sizeof(*page->request_time_ms), capacity) ||
+        !grow_column((void **)&page->host_names, sizeof(*page->host_names), capacity) ||
+        !grow_column((void **)&page->filenames, sizeof(*page->filenames), capacity) ||
+        !grow_column((void **)&page->local_paths, sizeof(*page->local_paths), capacity) ||
+        !grow_column((void **)&page->remote_urls, sizeof(*page->remote_urls), capacity) ||
+        !grow_column((void **)&page->deletion_urls, sizeof(*page->deletion_urls), capacity))
+    {
+        log_error("Failed to allocate memory for history page");
+        return false;
+    }
+
+    page->capacity = capacity;
+    return true;
+}
+
+static bool
+reserve_pool(history_page_t *page, size_t needed)
+{
+    if (needed > UINT32_MAX)
+    {
+        log_error("History page string pool is full");
+        return false;
+    }
+    if (needed <= page->pool_capacity)
+    {
+        return true;
+    }
+
+    size_t new_capacity = page->pool_capacity > 0 ? page->pool_capacity : HISTORY_PAGE_INITIAL_POOL;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+
+    char *ptr = realloc(page->pool, new_capacity);
+    if (!ptr)
+    {
+        log_error("Failed to allocate memory for history page strings");
+        return false;
+    }
+
+    page->pool = ptr;
+    page->pool_capacity = new_capacity;
+    return true;
+}
+
+/* Offset 0 always holds an empty string, shared by every NULL or empty column. */
+static bool
+pool_append(history_page_t *page, const char *text, history_str_t *str)
+{
+    size_t length = text ? strlen(text) : 0;
+    if (length == 0)
+    {
+        *str = (history_str_t){ 0 };
+        return true;
+    }
+
+    size_t needed = page->pool_size + length + 1;
+    if (!reserve_pool(page, needed))
+    {
+        return false;
+    }
+
+    str->offset = (uint32_t)page->pool_size;
+    str->length = (uint32_t)length;
+    memcpy(page->pool + page->pool_size, text, length + 1);
+    page->pool_size = needed;
+    return true;
+}
+
+static bool
+find_host(const history_page_t *page, const char *host_name, history_str_t *str)
+{
+    size_t length = strlen(host_name);
+    for (int i = 0; i < page->host_count; i++)
+    {
+        if (page->hosts[i].length == length &&
+            memcmp(history_page_str(page, page->hosts[i]), host_name, length) == 0)
+        {
+            *str = page->hosts[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+intern_host(history_page_t *page, const char *host_name, history_str_t *str)
+{
+    if (!host_name || !*host_name)
+    {
+        *str = (history_str_t){ 0 };
+        return true;
+    }
+    if (find_host(page, host_name, str))
+    {
+        return true;
+    }
+
+    if (page->host_count == page->host_capacity)
+    {
+        int capacity = page->host_capacity > 0 ? page->host_capacity * 2 : 8;
+        if (!grow_column((void **)&page->hosts, sizeof(*page->hosts), capacity))
+        {
+            log_error("Failed to allocate memory for history page hosts");
+            return false;
+        }
+        page->host_capacity = capacity;
+    }
+
+    if (!pool_append(page, host_name, str))
+    {
+        return false;
+    }
+    page->hosts[page->host_count++] = *str;
+    return true;
+}
+
+static bool
+append_row(history_page_t *page, const upload_row_t *row)
+{
+    if (page->count == page->capacity && !grow_rows(page))
+    {
+        return false;
+    }
+
+    int i = page->count;
+    if (!intern_host(page, row->host_name, &page->host_names[i]) ||
+        !pool_append(page, row->filename, &page->filenames[i]) ||
+        !pool_append(page, row->local_path, &page->local_paths[i]) ||
+        !pool_append(page, row->remote_url, &page->remote_urls[i]) ||
+        !pool_append(page, row->deletion_url, &page->deletion_urls[i]))
+    {
+        return false;
+    }
+
+    page->ids[i] = row->id;
+    page->timestamps[i] = row->timestamp;
+    page->sizes[i] = row->size;
+    page->original_sizes[i] = row->original_size;
+    page->request_time_ms[i] = row->request_time_ms;
+    page->count++;
+    return true;
+}
+
+void
+history_page_clear(history_page_t *page)
+{
+    page->count = 0;
+    page->host_count = 0;
+    page->pool_size = page->pool ? 1 : 0;
+}
+
+bool
+history_page_load(history_page_t *page, const db_query_t *query)
+{
+    history_page_clear(page);
+    if (!reserve_pool(page, 1))
+    {
+        return false;
+    }
+    page->pool[0] = '\0';
+    page->pool_size = 1;
+
+    db_cursor_t *cursor = db_cursor_open(query);
+    if (!cursor)
+    {
+        return false;
+    }
+
+    const upload_row_t *row;
+    while ((row = db_cursor_next(cursor)))
+    {
+        if (!append_row(page, row))
+        {
+            db_cursor_close(cursor);
+            history_page_clear(page);
+            return false;
+        }
+    }
+
+    if (!db_cursor_close(cursor))
+    {
+        history_page_clear(page);
+        return false;
+    }
+    return true;
+}
+
+static bool
+contains_ignoring_case(const history_page_t *page,
+                       history_str_t str,
+                       const char *text,
+                       size_t length)
+{
+    if (str.length < length)
+    {
+        return false;
+    }
+
+    const char *haystack = history_page_str(page, str);
+    for (size_t start = 0; start + length <= str.length; start++)
+    {
+        size_t i = 0;
+        while (i < length && tolower((unsigned char)haystack[start + i]) ==
+                               tolower((unsigned char)text[i]))
+        {
+            i++;
+        }
+        if (i == length)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Write the indices of the rows from host_name whose file name, local path or URL contains text
+ * (ignoring case) to rows, which must have room for page->count entries. NULL or empty filters
+ * match everything. Returns the number of matching rows.
+ */
+int
+history_page_filter(const history_page_t *page, const char *host_name, const char *text, int *rows)
+{
+    bool by_host = host_name && *host_name;
+    history_str_t host = { 0 };
+    if (by_host && !find_host(page, host_name, &host))
+    {
+        return 0;
+    }
+
+    size_t text_length = text ? strlen(text) : 0;
+    int matched = 0;
+    for (int i = 0; i < page->count; i++)
+    {
+        /* Interned, so comparing offsets is enough. */
+        if (by_host && page->host_names[i].offset != host.offset)
+        {
+            continue;
+        }
+        if (text_length > 0 &&
+            !contains_ignoring_case(page, page->filenames[i], text, text_length) &&
+            !contains_ignoring_case(page, page->local_paths[i], text, text_length) &&
+            !contains_ignoring_case(page, page->remote_urls[i], text, text_length))
+        {
+            continue;
+        }
+        rows[matched++] = i;
+    }
+    return matched;
+}
+
+/* Ties keep page order, whichever the direction. */
+static int
+compare_rows(const sort_entry_t *a, const sort_entry_t *b)
+{
+    return (a->row > b->row) - (a->row < b->row);
+}
+
+static int
+compare_number(const void *a, const void *b)
+{
+    const sort_entry_t *x = a;
+    const sort_entry_t *y = b;
+    int result = (x->key.number > y->key.number) - (x->key.number < y->key.number);
+    return result ? result : compare_rows(x, y);
+}
+
+static int
+compare_real(const void *a, const void *b)
+{
+    const sort_entry_t *x = a;
+    const sort_entry_t *y = b;
+    int result = (x->key.real > y->key.real) - (x->key.real < y->key.real);
+    return result ? result : compare_rows(x, y);
+}
+
+static int
+compare_text(const void *a, const void *b)
+{
+    const sort_entry_t *x = a;
+    const sort_entry_t *y = b;
+    int result = strcmp(x->key.text, y->key.text);
+    return result ? result : compare_rows(x, y);
+}
+
+static int
+compare_text_descending(const void *a, const void *b)
+{
+    const sort_entry_t *x = a;
+    const sort_entry_t *y = b;
+    int result = strcmp(y->key.text, x->key.text);
+    return result ? result : compare_rows(x, y);
+}
+
+/* Reorder rows, a list of row indices such as history_page_filter produces, by key. */
+bool
+history_page_sort(const history_page_t *page,
+                  history_sort_t key,
+                  bool descending,
+                  int *rows,
+                  int count)
+{
+    if (count < 2)
+    {
+        return true;
+    }
+
+    sort_entry_t *entries = malloc(sizeof(*entries) * (size_t)count);
+    if (!entries)
+    {
+        log_error("Failed to allocate memory for sorting history");
+        return false;
+    }
+
+    /* Numeric keys are negated for a descending sort so ties still compare by row. */
+    sqlite3_int64 sign = descending ? -1 : 1;
+    int (*compare)(const void *, const void *) = compare_number;
+    for (int i = 0; i < count; i++)
+    {
+        int row = rows[i];
+        entries[i].row = row;
+        switch (key)
+        {
+            case HISTORY_SORT_DATE:
+                entries[i].key.number = sign * (sqlite3_int64)page->timestamps[row];
+                break;
+            case HISTORY_SORT_SIZE:
+                entries[i].key.number = sign * page->sizes[row];
+                break;
+            case HISTORY_SORT_LATENCY:
+                entries[i].key.real = (double)sign * page->request_time_ms[row];
+                compare = compare_real;
+                break;
+            case HISTORY_SORT_HOST:
+                entries[i].key.text = history_page_str(page, page->host_names[row]);
+                compare = descending ? compare_text_descending : compare_text;
+                break;
+            case HISTORY_SORT_FILENAME:
+                entries[i].key.text = history_page_str(page, page->filenames[row]);
+                compare = descending ? compare_text_descending : compare_text;
+                break;
+        }
+    }
+
+    qsort(entries, (size_t)count, sizeof(*entries), compare);
+    for (int i = 0; i < count; i++)
+    {
+        rows[i] = entries[i].row;
+    }
+
+    free(entries);
+    return true;
+}
+
+void
+history_page_free(history_page_t *page)
+{
+    free(page->ids);
+    free(page->timestamps);
+    free(page->sizes);
+    free(page->original_sizes);
+    free(page->request_time_ms);
+    free(page->host_names);
+    free(page->filenames);
+    free(page->local_paths);
+    free(page->remote_urls);
+    free(page->deletion_urls);
+    free(page->pool);
+    free(page->hosts);
+    *page = (history_page_t){ 0 };
+}
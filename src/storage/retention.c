@@ -0,0 +1,153 @@
+#include "hostman/storage/retention.h"
+#include "hostman/core/logging.h"
+#include "hostman/storage/database.h"
+#include <string.h>
+#include <time.h>
+
+#define SECONDS_PER_DAY 86400
+
+/* Delete batches until the limit holds or the budget runs out; a negative budget is unlimited. */
+static bool
+prune(const char *host_name,
+      time_t before,
+      long keep_newest,
+      int *batches_left,
+      retention_result_t *result)
+{
+    while (*batches_left != 0)
+    {
+        int deleted = db_prune_uploads(host_name, before, keep_newest, RETENTION_BATCH_ROWS);
+        if (deleted < 0)
+        {
+            return false;
+        }
+
+        result->deleted += deleted;
+        if (*batches_left > 0)
+        {
+            (*batches_left)--;
+        }
+        if (deleted < RETENTION_BATCH_ROWS)
+        {
+            return true;
+        }
+    }
+
+    result->incomplete = true;
+    return true;
+}
+
+static bool
+prune_queue(queue_state_t state, long keep_days, int *batches_left, retention_result_t *result)
+{
+    time_t before = time(NULL) - (time_t)keep_days * SECONDS_PER_DAY;
+    while (*batches_left != 0)
+    {
+        int deleted = db_queue_prune(state, before, RETENTION_BATCH_ROWS);
+        if (deleted < 0)
+        {
+            return false;
+        }
+
+        result->queue_deleted += deleted;
+        if (*batches_left > 0)
+        {
+            (*batches_left)--;
+        }
+        if (deleted < RETENTION_BATCH_ROWS)
+        {
+            return true;
+        }
+    }
+
+    result->incomplete = true;
+    return true;
+}
+
+static bool
+apply_limits(const char *host_name,
+             const retention_config_t *limits,
+             int *batches_left,
+             retention_result_t *result)
+{
+    if (limits->max_age_days > 0)
+    {
+        time_t before = time(NULL) - (time_t)limits->max_age_days * SECONDS_PER_DAY;
+        if (!prune(host_name, before, 0, batches_left, result))
+        {
+            return false;
+        }
+    }
+
+    if (limits->max_rows > 0 && !prune(host_name, 0, limits->max_rows, batches_left, result))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Apply the global limits to the whole history and each host's limits to its own uploads, and
+ * drop old finished queue jobs, deleting at most max_batches batches (0 for no limit), then
+ * release up to vacuum_pages free pages (0 for all of them).
+ */
+bool
+retention_enforce(const hostman_config_t *config,
+                  int max_batches,
+                  int vacuum_pages,
+                  retention_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    int batches_left = max_batches > 0 ? max_batches : -1;
+    bool ok = apply_limits(NULL, &config->retention, &batches_left, result);
+
+    for (int i = 0; ok && i < config->host_count; i++)
+    {
+        const host_config_t *host = config->hosts[i];
+        if (host && host->name)
+        {
+            ok = apply_limits(host->name, &host->retention, &batches_left, result);
+        }
+    }
+
+    ok = ok && prune_queue(QUEUE_DONE, RETENTION_QUEUE_DONE_DAYS, &batches_left, result) &&
+         prune_queue(QUEUE_FAILED, RETENTION_QUEUE_FAILED_DAYS, &batches_left, result);
+
+    if (result->deleted > 0)
+    {
+        log_info("Retention removed %ld uploads from the history", result->deleted);
+    }
+    if (result->queue_deleted > 0)
+    {
+        log_info("Retention removed %ld finished jobs from the upload queue", result->queue_deleted);
+    }
+
+    sqlite3_int64 bytes = db_incremental_vacuum(vacuum_pages);
+    if (bytes < 0)
+    {
+        return false;
+    }
+    result->bytes_freed = bytes;
+
+    return ok;
+}
+
+/* A small, bounded pass that keeps the history in check without a noticeable pause. */
+void
+retention_maintain(const hostman_config_t *config)
+{
+    if (!config)
+    {
+        return;
+    }
+
+    retention_result_t result;
+    retention_enforce(
+      config, RETENTION_MAINTAIN_BATCHES, RETENTION_MAINTAIN_VACUUM_PAGES, &result);
+    if (result.incomplete)
+    {
+        log_debug("More uploads are past the retention limits; continuing on the next pass");
+    }
+}